@@ -25,7 +25,9 @@ CONFIG(debug, debug|release) {
 DEFINES += QT_NO_CAST_TO_ASCII \
     QT_NO_CAST_FROM_ASCII
 HEADERS += src/qsql_ibpp.h \
-    src/qsqlcachedresult_p.h
+    src/qsqlcachedresult_p.h \
+    src/qfbrowblock.h \
+    src/qfbbulkinsert.h
 SOURCES += src/main.cpp \
     src/qsql_ibpp.cpp
 include(./ibpp2531/ibpp.pri) # +=   IBPP
@@ -0,0 +1,34 @@
+# QtTest benchmarks of the driver, built as a standalone application:
+#
+#   qmake && make && ./tst_bench_qfbdriver -xml -o results.xml
+#
+# The driver source is compiled into the benchmark so the file-local
+# helpers can be measured directly; the database benchmarks run against
+# the server named by QFB_BENCH_DATABASE, see README.txt. With
+#
+#   qmake CONFIG+=fakeibpp
+#
+# they run against the in-memory IBPP of ../tests/fakeibpp instead.
+CONFIG += qtestlib \
+    console
+CONFIG -= app_bundle
+QT += core \
+    sql
+QT -= gui
+TEMPLATE = app
+TARGET = tst_bench_qfbdriver
+
+DEFINES += QT_NO_CAST_TO_ASCII \
+    QT_NO_CAST_FROM_ASCII
+INCLUDEPATH += ../src
+HEADERS += ../src/qsql_ibpp.h \
+    ../src/qsqlcachedresult_p.h \
+    ../src/qfbrowblock.h \
+    ../src/qfbbulkinsert.h
+SOURCES += tst_bench_qfbdriver.cpp
+fakeibpp {
+    DEFINES += QFB_FAKE_IBPP
+    include(../tests/fakeibpp/fakeibpp.pri) # +=   fake IBPP
+} else {
+    include(../ibpp2531/ibpp.pri) # +=   IBPP
+}
@@ -0,0 +1,791 @@
+/*
+* This file is part of QtFirebirdIBPPSQLDriver - Qt SQL driver for Firebird with IBPP library
+* Copyright (C) 2006-2010 Alex Wencel
+*
+* Contact e-mail: Alex Wencel <alex.wencel@gmail.com>
+* Program URL   : http://code.google.com/p/qtfirebirdibppsqldriver
+*
+* GNU Lesser General Public License Usage
+* This file may be used under the terms of the GNU Lesser
+* General Public License version 2.1 as published by the Free Software
+* Foundation and appearing in the file LICENSE.LGPL included in the
+* packaging of this file.  Please review the following information to
+* ensure the GNU Lesser General Public License version 2.1 requirements
+* will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+*
+* GNU General Public License Usage
+* Alternatively, this file may be used under the terms of the GNU
+* General Public License version 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in the
+* packaging of this file.  Please review the following information to
+* ensure the GNU General Public License version 3.0 requirements will be
+* met: http://www.gnu.org/copyleft/gpl.html.
+*
+*/
+
+#include <QtTest/QtTest>
+#include <QtSql/QSqlDatabase>
+#include <QtSql/QSqlQuery>
+#include <QtSql/QSqlError>
+#include <QtSql/QSqlRecord>
+
+// The driver is compiled into the benchmark, so the private classes and
+// static helpers of qsql_ibpp.cpp can be measured on their own
+#include "../src/qsql_ibpp.cpp"
+#include "qfbrowblock.h"
+#ifdef QFB_FAKE_IBPP
+#include "fakeibpp.h"
+#endif
+
+// Database benchmarks run against a database created in initTestCase()
+// and dropped in cleanupTestCase():
+//
+//  QFB_BENCH_DATABASE - path of the database to create, must not exist
+//  QFB_BENCH_HOST     - server, empty (default) for a local connection
+//  QFB_BENCH_USER     - SYSDBA by default
+//  QFB_BENCH_PASSWORD - masterkey by default
+//
+// Without QFB_BENCH_DATABASE they are skipped. Built with CONFIG+=fakeibpp
+// they run against the in-memory IBPP of tests/fakeibpp instead, which
+// leaves the driver's own cost without server or network noise. Pass -xml
+// or -lightxml for machine readable results.
+
+static const char connectionName[] = "qfbbench";
+static const int fetchRows = 10000;
+
+#define QFB_REQUIRE_DATABASE() \
+    do { \
+        if (!db.isOpen()) \
+            QSKIP("QFB_BENCH_DATABASE is not set", SkipAll); \
+    } while (0)
+
+#ifdef QFB_FAKE_IBPP
+#define QFB_REQUIRE_SERVER() \
+    QSKIP("the fake IBPP has no system tables", SkipAll)
+#else
+#define QFB_REQUIRE_SERVER() \
+    QFB_REQUIRE_DATABASE()
+#endif
+
+#define QFB_VERIFY_QUERY(q, statement) \
+    QVERIFY2(statement, (q).lastError().text().toLocal8Bit().constData())
+
+class tst_QFBDriverBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void placeholders_data();
+    void placeholders();
+    void scaledParse_data();
+    void scaledParse();
+    void scaledFormat();
+    void stringDecoding_data();
+    void stringDecoding();
+    void dateRange();
+    void timeRange();
+    void dates_data();
+    void dates();
+
+    void bind_data();
+    void bind();
+    void bindPlan_data();
+    void bindPlan();
+    void fetch_data();
+    void fetch();
+    void rowBlock_data();
+    void rowBlock();
+    void blobWrite_data();
+    void blobWrite();
+    void blobRead_data();
+    void blobRead();
+    void transactions_data();
+    void transactions();
+    void decode_data();
+    void decode();
+    void record();
+    void tables();
+
+private:
+    IBPP::Database ibppDatabase() const;
+    bool exec(const QString &sql);
+    bool recreateTable(const QString &table, const QString &columns);
+    bool fillTable(const QString &table, const QVariant &value, int rows);
+
+    QString path;
+    QString host;
+    QString user;
+    QString password;
+    QSqlDatabase db;
+};
+
+//-----------------------------------------------------------------------//
+static QString qEnv(const char *name, const char *defaultValue)
+{
+    const QByteArray value = qgetenv(name);
+    return value.isEmpty() ? QString::fromLatin1(defaultValue) : QString::fromLocal8Bit(value.constData());
+}
+//-----------------------------------------------------------------------//
+// One row per column type, shared by the bind and fetch benchmarks
+static void qAddTypeRows()
+{
+    QTest::addColumn<QString>("type");
+    QTest::addColumn<QVariant>("value");
+
+    const QDate date(2010, 6, 15);
+    const QTime time(12, 34, 56, 789);
+    QTest::newRow("smallint") << QString::fromLatin1("SMALLINT") << QVariant(1234);
+    QTest::newRow("integer") << QString::fromLatin1("INTEGER") << QVariant(123456789);
+    QTest::newRow("bigint") << QString::fromLatin1("BIGINT") << QVariant(Q_INT64_C(1234567890123));
+    QTest::newRow("double") << QString::fromLatin1("DOUBLE PRECISION") << QVariant(3.14159);
+    QTest::newRow("numeric") << QString::fromLatin1("NUMERIC(18,4)")
+                             << QVariant(QString::fromLatin1("12345678.9012"));
+    QTest::newRow("varchar") << QString::fromLatin1("VARCHAR(100)")
+                             << QVariant(QString(64, QLatin1Char('x')));
+    QTest::newRow("date") << QString::fromLatin1("DATE") << QVariant(date);
+    QTest::newRow("time") << QString::fromLatin1("TIME") << QVariant(time);
+    QTest::newRow("timestamp") << QString::fromLatin1("TIMESTAMP") << QVariant(QDateTime(date, time));
+    QTest::newRow("blob") << QString::fromLatin1("BLOB SUB_TYPE 0")
+                          << QVariant(QByteArray(1024, 'b'));
+}
+//-----------------------------------------------------------------------//
+static void qAddBlobSizeRows()
+{
+    QTest::addColumn<int>("size");
+    QTest::newRow("1K") << 1024;
+    QTest::newRow("64K") << 64 * 1024;
+    QTest::newRow("1M") << 1024 * 1024;
+}
+//-----------------------------------------------------------------------//
+IBPP::Database tst_QFBDriverBenchmark::ibppDatabase() const
+{
+    return IBPP::DatabaseFactory(host.toStdString(), path.toStdString(),
+                                 user.toStdString(), password.toStdString(),
+                                 "", "UTF8", "DEFAULT CHARACTER SET UTF8");
+}
+//-----------------------------------------------------------------------//
+bool tst_QFBDriverBenchmark::exec(const QString &sql)
+{
+    QSqlQuery q(db);
+    if (q.exec(sql))
+        return true;
+    qWarning("tst_QFBDriverBenchmark: %s", q.lastError().text().toLocal8Bit().constData());
+    return false;
+}
+//-----------------------------------------------------------------------//
+bool tst_QFBDriverBenchmark::recreateTable(const QString &table, const QString &columns)
+{
+    QSqlQuery q(db);
+    q.exec(QLatin1String("DROP TABLE ") + table);
+    return exec(QLatin1String("CREATE TABLE ") + table + QLatin1String(" (") + columns + QLatin1Char(')'));
+}
+//-----------------------------------------------------------------------//
+// rows copies of value in the V column of table, in one transaction
+bool tst_QFBDriverBenchmark::fillTable(const QString &table, const QVariant &value, int rows)
+{
+    QVariantList values;
+    for (int i = 0; i < rows; ++i)
+        values.append(value);
+
+    QSqlQuery q(db);
+    if (!q.prepare(QLatin1String("INSERT INTO ") + table + QLatin1String(" (V) VALUES (?)")))
+        return false;
+    q.addBindValue(values);
+    if (!db.transaction())
+        return false;
+    if (!q.execBatch())
+    {
+        db.rollback();
+        return false;
+    }
+    return db.commit();
+}
+//-----------------------------------------------------------------------//
+void tst_QFBDriverBenchmark::initTestCase()
+{
+#ifdef QFB_FAKE_IBPP
+    path = qEnv("QFB_BENCH_DATABASE", "fake.fdb");
+#else
+    path = qEnv("QFB_BENCH_DATABASE", "");
+#endif
+    if (path.isEmpty())
+        return;
+    host = qEnv("QFB_BENCH_HOST", "");
+    user = qEnv("QFB_BENCH_USER", "SYSDBA");
+    password = qEnv("QFB_BENCH_PASSWORD", "masterkey");
+
+    try
+    {
+        IBPP::Database created = ibppDatabase();
+        created->Create(3);
+        created->Disconnect();
+    }
+    catch (IBPP::Exception &e)
+    {
+        path.clear();
+        QFAIL(e.what());
+    }
+
+    db = QSqlDatabase::addDatabase(new QFBDriver(), QLatin1String(connectionName));
+    db.setDatabaseName(path);
+    db.setHostName(host);
+    db.setUserName(user);
+    db.setPassword(password);
+    db.setConnectOptions(QLatin1String("CHARSET=UTF8;STMT_CACHE_SIZE=32"));
+    QVERIFY2(db.open(), db.lastError().text().toLocal8Bit().constData());
+}
+//-----------------------------------------------------------------------//
+void tst_QFBDriverBenchmark::cleanupTestCase()
+{
+    if (path.isEmpty())
+        return;
+
+    db.close();
+    db = QSqlDatabase();
+    QSqlDatabase::removeDatabase(QLatin1String(connectionName));
+    try
+    {
+        IBPP::Database dropped = ibppDatabase();
+        dropped->Connect();
+        dropped->Drop();
+    }
+    catch (IBPP::Exception &e)
+    {
+        qWarning("tst_QFBDriverBenchmark: %s", e.what());
+    }
+}
+//-----------------------------------------------------------------------//
+void tst_QFBDriverBenchmark::placeholders_data()
+{
+    QTest::addColumn<QString>("sql");
+    QTest::newRow("positional")
+        << QString::fromLatin1("SELECT A, B, C FROM T WHERE A = ? AND B > ? AND C LIKE 'x:y%'");
+    QTest::newRow("named")
+        << QString::fromLatin1("UPDATE T SET A = :a, B = :b /* :c */ WHERE ID = :id AND C = ':d'");
+    QTest::newRow("execute block")
+        << QString::fromLatin1("EXECUTE BLOCK (X INTEGER = :x) RETURNS (Y INTEGER) AS "
+                               "BEGIN Y = :X + 1; SUSPEND; END");
+}
+//-----------------------------------------------------------------------//
+void tst_QFBDriverBenchmark::placeholders()
+{
+    QFETCH(QString, sql);
+    const std::string s = sql.toStdString();
+    std::string rewritten;
+
+    QBENCHMARK
+    {
+        rewritten.clear();
+        qParsePlaceholders(s, rewritten);
+    }
+}
+//-----------------------------------------------------------------------//
+void tst_QFBDriverBenchmark::scaledParse_data()
+{
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<int>("scale");
+    QTest::newRow("integer") << QString::fromLatin1("1234567") << 4;
+    QTest::newRow("fraction") << QString::fromLatin1("-12345.6789") << 4;
+    QTest::newRow("rounded") << QString::fromLatin1("3.14159265358979") << 4;
+}
+//-----------------------------------------------------------------------//
+void tst_QFBDriverBenchmark::scaledParse()
+{
+    QFETCH(QString, text);
+    QFETCH(int, scale);
+    qint64 raw = 0;
+    QVERIFY(qParseScaled(text, scale, &raw));
+
+    QBENCHMARK
+    {
+        qParseScaled(text, scale, &raw);
+    }
+}
+//-----------------------------------------------------------------------//
+void tst_QFBDriverBenchmark::scaledFormat()
+{
+    const qint64 raw = Q_INT64_C(-123456789012345);
+    QCOMPARE(qScaledToString(raw, 4), QString::fromLatin1("-12345678901.2345"));
+
+    QBENCHMARK
+    {
+        qScaledToString(raw, 4);
+    }
+}
+//-----------------------------------------------------------------------//
+void tst_QFBDriverBenchmark::stringDecoding_data()
+{
+    QTest::addColumn<int>("decoding");
+    QTest::addColumn<QByteArray>("bytes");
+
+    const QByteArray ascii(60, 'a');
+    QByteArray padded = ascii;
+    padded.append(QByteArray(40, ' '));
+    QTest::newRow("utf8 ascii") << int(Utf8Strings) << ascii;
+    QTest::newRow("utf8 multibyte") << int(Utf8Strings)
+                                    << QString(60, QChar(ushort(0x00e4))).toUtf8();
+    QTest::newRow("latin1") << int(Latin1Strings) << ascii;
+    QTest::newRow("ascii") << int(AsciiStrings) << ascii;
+    QTest::newRow("char padded") << int(Utf8Strings) << padded;
+}
+//-----------------------------------------------------------------------//
+void tst_QFBDriverBenchmark::stringDecoding()
+{
+    QFETCH(int, decoding);
+    QFETCH(QByteArray, bytes);
+    const QTextCodec *codec = QTextCodec::codecForName("UTF-8");
+
+    QBENCHMARK
+    {
+        fromIBPPStr(bytes.constData(), bytes.size(), decoding, codec);
+    }
+}
+//-----------------------------------------------------------------------//
+// Every IBPP date keeps its year, month and day in QDate and converts back
+// to the same day. Qt 4 has no 5 to 14 October 1582, those stay invalid.
+void tst_QFBDriverBenchmark::dateRange()
+{
+    for (int day = IBPP::MinDate; day <= IBPP::MaxDate; ++day)
+    {
+        IBPP::Date id(day);
+        const QDate date = fromIBPPDate(id);
+        int y, m, d;
+        id.GetDate(y, m, d);
+
+        if (y == 1582 && m == 10 && d > 4 && d < 15)
+        {
+            if (date.isValid())
+                QFAIL(QString::fromLatin1("1582-10-%1 is valid").arg(d).toLocal8Bit().constData());
+            continue;
+        }
+        if (date.year() != y || date.month() != m || date.day() != d)
+            QFAIL(QString::fromLatin1("IBPP day %1 (%2-%3-%4) became %5").arg(day).arg(y).arg(m).arg(d)
+                  .arg(date.toString(QLatin1String("yyyy-MM-dd"))).toLocal8Bit().constData());
+        if (toIBPPDate(date).GetDate() != day)
+            QFAIL(QString::fromLatin1("IBPP day %1 came back as %2")
+                  .arg(day).arg(toIBPPDate(date).GetDate()).toLocal8Bit().constData());
+
+        if (day % 997 == 0)
+        {
+            IBPP::Timestamp ts = toIBPPTimeStamp(QDateTime(date, QTime(23, 59, 59, 999)));
+            QCOMPARE(ts.GetDate(), day);
+            QCOMPARE(fromIBPPTimeStamp(ts), QDateTime(date, QTime(23, 59, 59, 999)));
+        }
+    }
+}
+//-----------------------------------------------------------------------//
+// Every second of the day with a few milliseconds, both ways
+void tst_QFBDriverBenchmark::timeRange()
+{
+    static const int msecs[] = { 0, 1, 500, 999 };
+    for (int second = 0; second < 86400; ++second)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            const int ms = second * 1000 + msecs[i];
+            const QTime time = QTime(0, 0).addMSecs(ms);
+            IBPP::Time it = toIBPPTime(time);
+            if (it.GetTime() != ms * 10 || fromIBPPTime(it) != time)
+                QFAIL(QString::fromLatin1("%1 converted to %2 ticks")
+                      .arg(time.toString(QLatin1String("hh:mm:ss.zzz"))).arg(it.GetTime())
+                      .toLocal8Bit().constData());
+        }
+    }
+}
+//-----------------------------------------------------------------------//
+void tst_QFBDriverBenchmark::dates_data()
+{
+    QTest::addColumn<bool>("components");
+    QTest::addColumn<bool>("toIBPP");
+    QTest::newRow("day count, from IBPP") << false << false;
+    QTest::newRow("components, from IBPP") << true << false;
+    QTest::newRow("day count, to IBPP") << false << true;
+    QTest::newRow("components, to IBPP") << true << true;
+}
+//-----------------------------------------------------------------------//
+// 10000 timestamps of 1990 to 2017 per iteration, by the day and tick
+// counts the driver uses against the year, month, day, hour, minute,
+// second path it used before
+void tst_QFBDriverBenchmark::dates()
+{
+    QFETCH(bool, components);
+    QFETCH(bool, toIBPP);
+
+    QVector<IBPP::Timestamp> stamps;
+    QVector<QDateTime> dateTimes;
+    const QDateTime start(QDate(1990, 1, 1), QTime(0, 0));
+    for (int i = 0; i < 10000; ++i)
+    {
+        dateTimes.append(start.addSecs(i * 86399 + i % 1000));
+        stamps.append(toIBPPTimeStamp(dateTimes.last()));
+    }
+
+    QBENCHMARK
+    {
+        for (int i = 0; i < stamps.count(); ++i)
+        {
+            if (!toIBPP && !components)
+            {
+                fromIBPPTimeStamp(stamps[i]);
+            }
+            else if (!toIBPP)
+            {
+                int y, mo, d, h, mi, sec, t;
+                stamps[i].GetDate(y, mo, d);
+                stamps[i].GetTime(h, mi, sec, t);
+                QDateTime(QDate(y, mo, d), QTime(h, mi, sec, t / 10));
+            }
+            else if (!components)
+            {
+                toIBPPTimeStamp(dateTimes.at(i));
+            }
+            else
+            {
+                const QDate date = dateTimes.at(i).date();
+                const QTime time = dateTimes.at(i).time();
+                IBPP::Timestamp(date.year(), date.month(), date.day(),
+                                time.hour(), time.minute(), time.second(), time.msec() * 10);
+            }
+        }
+    }
+}
+//-----------------------------------------------------------------------//
+void tst_QFBDriverBenchmark::bind_data()
+{
+    qAddTypeRows();
+}
+//-----------------------------------------------------------------------//
+// exec() of a prepared INSERT, parameter binding plus one round trip
+void tst_QFBDriverBenchmark::bind()
+{
+    QFETCH(QString, type);
+    QFETCH(QVariant, value);
+    QFB_REQUIRE_DATABASE();
+    QVERIFY(recreateTable(QLatin1String("BENCH_BIND"), QLatin1String("V ") + type));
+
+    QSqlQuery q(db);
+    QFB_VERIFY_QUERY(q, q.prepare(QLatin1String("INSERT INTO BENCH_BIND (V) VALUES (?)")));
+    QVERIFY(db.transaction());
+    QBENCHMARK
+    {
+        q.bindValue(0, value);
+        QFB_VERIFY_QUERY(q, q.exec());
+    }
+    QVERIFY(db.commit());
+}
+//-----------------------------------------------------------------------//
+void tst_QFBDriverBenchmark::bindPlan_data()
+{
+    QTest::addColumn<bool>("cachedPlan");
+    QTest::addColumn<bool>("execute");
+    QTest::newRow("plan per exec, bind") << false << false;
+    QTest::newRow("cached plan, bind") << true << false;
+    QTest::newRow("plan per exec, bind and execute") << false << true;
+    QTest::newRow("cached plan, bind and execute") << true << true;
+}
+//-----------------------------------------------------------------------//
+// One exec() of a six parameter INSERT with the binder plan kept from
+// prepare(), against describing the parameters again on every exec() the
+// way the driver used to. The rows without execute leave out the round
+// trip, so the binding cost itself shows.
+void tst_QFBDriverBenchmark::bindPlan()
+{
+    QFETCH(bool, cachedPlan);
+    QFETCH(bool, execute);
+    QFB_REQUIRE_DATABASE();
+    QVERIFY(recreateTable(QLatin1String("BENCH_PLAN"),
+                          QLatin1String("ID INTEGER, N BIGINT, M NUMERIC(18,4), "
+                                        "S VARCHAR(40), D DATE, T TIMESTAMP")));
+
+    const QFBDriver *driver = static_cast<const QFBDriver *>(db.driver());
+    QTextCodec *codec = QTextCodec::codecForName("UTF-8");
+    QFBResult result(driver, codec);
+    QFBResultPrivate rp(&result, driver, codec);
+    QVERIFY(rp.prepare("INSERT INTO BENCH_PLAN (ID, N, M, S, D, T) VALUES (?, ?, ?, ?, ?, ?)"));
+    QVERIFY(rp.transaction());
+    rp.describeParameters();
+
+    const QDate date(2010, 6, 15);
+    QVector<QVariant> values;
+    values << QVariant(42) << QVariant(Q_INT64_C(1234567890123))
+           << QVariant(QString::fromLatin1("12345.6789")) << QVariant(QString::fromLatin1("row 42"))
+           << QVariant(date) << QVariant(QDateTime(date, QTime(12, 34, 56)));
+    try
+    {
+        QBENCHMARK
+        {
+            if (!cachedPlan)
+            {
+                rp.plan.paramsDescribed = false;
+                rp.describeParameters();
+            }
+            QVERIFY(rp.bind(values));
+            if (execute)
+                rp.iSt->Execute();
+        }
+    }
+    catch (IBPP::Exception &e)
+    {
+        QFAIL(e.what());
+    }
+    QVERIFY(rp.commit());
+}
+//-----------------------------------------------------------------------//
+void tst_QFBDriverBenchmark::fetch_data()
+{
+    qAddTypeRows();
+}
+//-----------------------------------------------------------------------//
+// gotoNext() decoding, fetchRows rows of one column per iteration
+void tst_QFBDriverBenchmark::fetch()
+{
+    QFETCH(QString, type);
+    QFETCH(QVariant, value);
+    QFB_REQUIRE_DATABASE();
+    QVERIFY(recreateTable(QLatin1String("BENCH_FETCH"), QLatin1String("V ") + type));
+    QVERIFY(fillTable(QLatin1String("BENCH_FETCH"), value, fetchRows));
+
+    QSqlQuery q(db);
+    q.setForwardOnly(true);
+    QBENCHMARK
+    {
+        QFB_VERIFY_QUERY(q, q.exec(QLatin1String("SELECT V FROM BENCH_FETCH")));
+        int rows = 0;
+        while (q.next())
+        {
+            q.value(0);
+            ++rows;
+        }
+        QCOMPARE(rows, fetchRows);
+    }
+}
+//-----------------------------------------------------------------------//
+void tst_QFBDriverBenchmark::rowBlock_data()
+{
+    QTest::addColumn<bool>("block");
+    QTest::newRow("next") << false;
+    QTest::newRow("row block") << true;
+}
+//-----------------------------------------------------------------------//
+// QSqlQuery::next() against qFBFetchRowBlock() over the same mixed rows
+void tst_QFBDriverBenchmark::rowBlock()
+{
+    QFETCH(bool, block);
+    QFB_REQUIRE_DATABASE();
+
+    if (!db.tables().contains(QLatin1String("BENCH_ROWS")))
+    {
+        QVERIFY(recreateTable(QLatin1String("BENCH_ROWS"),
+                              QLatin1String("ID INTEGER, N BIGINT, D DOUBLE PRECISION, "
+                                            "M NUMERIC(18,4), S VARCHAR(40), T TIMESTAMP")));
+        QVariantList ids, ns, ds, ms, ss, ts;
+        const QDateTime start(QDate(2010, 1, 1), QTime(0, 0));
+        for (int i = 0; i < fetchRows; ++i)
+        {
+            ids.append(i);
+            ns.append(Q_INT64_C(1000000000000) + i);
+            ds.append(i / 7.0);
+            ms.append(QString::number(i) + QLatin1String(".1234"));
+            ss.append(QString::fromLatin1("row %1").arg(i));
+            ts.append(start.addSecs(i));
+        }
+        QSqlQuery insert(db);
+        QFB_VERIFY_QUERY(insert, insert.prepare(QLatin1String(
+            "INSERT INTO BENCH_ROWS (ID, N, D, M, S, T) VALUES (?, ?, ?, ?, ?, ?)")));
+        insert.addBindValue(ids);
+        insert.addBindValue(ns);
+        insert.addBindValue(ds);
+        insert.addBindValue(ms);
+        insert.addBindValue(ss);
+        insert.addBindValue(ts);
+        QVERIFY(db.transaction());
+        QFB_VERIFY_QUERY(insert, insert.execBatch());
+        QVERIFY(db.commit());
+    }
+
+    QSqlQuery q(db);
+    q.setForwardOnly(true);
+    QBENCHMARK
+    {
+        QFB_VERIFY_QUERY(q, q.exec(QLatin1String("SELECT ID, N, D, M, S, T FROM BENCH_ROWS")));
+        int rows = 0;
+        if (block)
+        {
+            QFBRowBlock buffer;
+            int n;
+            while ((n = qFBFetchRowBlock(q, buffer, 1000)) > 0)
+                rows += n;
+            QVERIFY(n == 0);
+        }
+        else
+        {
+            while (q.next())
+            {
+                for (int c = 0; c < 6; ++c)
+                    q.value(c);
+                ++rows;
+            }
+        }
+        QCOMPARE(rows, fetchRows);
+    }
+}
+//-----------------------------------------------------------------------//
+void tst_QFBDriverBenchmark::blobWrite_data()
+{
+    qAddBlobSizeRows();
+}
+//-----------------------------------------------------------------------//
+void tst_QFBDriverBenchmark::blobWrite()
+{
+    QFETCH(int, size);
+    QFB_REQUIRE_DATABASE();
+    QVERIFY(recreateTable(QLatin1String("BENCH_BLOB"), QLatin1String("V BLOB SUB_TYPE 0")));
+
+    const QVariant value(QByteArray(size, 'b'));
+    QSqlQuery q(db);
+    QFB_VERIFY_QUERY(q, q.prepare(QLatin1String("INSERT INTO BENCH_BLOB (V) VALUES (?)")));
+    QVERIFY(db.transaction());
+    QBENCHMARK
+    {
+        q.bindValue(0, value);
+        QFB_VERIFY_QUERY(q, q.exec());
+    }
+    QVERIFY(db.commit());
+}
+//-----------------------------------------------------------------------//
+void tst_QFBDriverBenchmark::blobRead_data()
+{
+    qAddBlobSizeRows();
+}
+//-----------------------------------------------------------------------//
+void tst_QFBDriverBenchmark::blobRead()
+{
+    QFETCH(int, size);
+    QFB_REQUIRE_DATABASE();
+    QVERIFY(recreateTable(QLatin1String("BENCH_BLOB"), QLatin1String("V BLOB SUB_TYPE 0")));
+    QVERIFY(fillTable(QLatin1String("BENCH_BLOB"), QByteArray(size, 'b'), 1));
+
+    QSqlQuery q(db);
+    q.setForwardOnly(true);
+    QBENCHMARK
+    {
+        QFB_VERIFY_QUERY(q, q.exec(QLatin1String("SELECT V FROM BENCH_BLOB")));
+        QVERIFY(q.next());
+        QCOMPARE(q.value(0).toByteArray().size(), size);
+    }
+}
+//-----------------------------------------------------------------------//
+void tst_QFBDriverBenchmark::transactions_data()
+{
+    QTest::addColumn<bool>("explicitTransaction");
+    QTest::newRow("autocommit") << false;
+    QTest::newRow("explicit") << true;
+}
+//-----------------------------------------------------------------------//
+// 100 single row INSERTs, each committed on its own or all in one transaction
+void tst_QFBDriverBenchmark::transactions()
+{
+    QFETCH(bool, explicitTransaction);
+    QFB_REQUIRE_DATABASE();
+    QVERIFY(recreateTable(QLatin1String("BENCH_TR"), QLatin1String("V INTEGER")));
+
+    QSqlQuery q(db);
+    QFB_VERIFY_QUERY(q, q.prepare(QLatin1String("INSERT INTO BENCH_TR (V) VALUES (?)")));
+    QBENCHMARK
+    {
+        if (explicitTransaction)
+            QVERIFY(db.transaction());
+        for (int i = 0; i < 100; ++i)
+        {
+            q.bindValue(0, i);
+            QFB_VERIFY_QUERY(q, q.exec());
+        }
+        if (explicitTransaction)
+            QVERIFY(db.commit());
+    }
+}
+//-----------------------------------------------------------------------//
+void tst_QFBDriverBenchmark::decode_data()
+{
+    QTest::addColumn<int>("type");
+    QTest::addColumn<int>("width");
+    QTest::addColumn<int>("scale");
+    QTest::addColumn<double>("nullRatio");
+
+    QTest::newRow("integer") << int(IBPP::sdInteger) << 0 << 0 << 0.0;
+    QTest::newRow("integer, half null") << int(IBPP::sdInteger) << 0 << 0 << 0.5;
+    QTest::newRow("bigint") << int(IBPP::sdLargeint) << 0 << 0 << 0.0;
+    QTest::newRow("numeric(18,4)") << int(IBPP::sdLargeint) << 0 << 4 << 0.0;
+    QTest::newRow("double") << int(IBPP::sdDouble) << 0 << 0 << 0.0;
+    QTest::newRow("varchar(40)") << int(IBPP::sdString) << 40 << 0 << 0.0;
+    QTest::newRow("varchar(40), half null") << int(IBPP::sdString) << 40 << 0 << 0.5;
+    QTest::newRow("date") << int(IBPP::sdDate) << 0 << 0 << 0.0;
+    QTest::newRow("timestamp") << int(IBPP::sdTimestamp) << 0 << 0 << 0.0;
+}
+//-----------------------------------------------------------------------//
+// One million cells fetched and decoded per iteration, from a synthetic
+// table of the fake IBPP with four columns of one type
+void tst_QFBDriverBenchmark::decode()
+{
+#ifdef QFB_FAKE_IBPP
+    QFETCH(int, type);
+    QFETCH(int, width);
+    QFETCH(int, scale);
+    QFETCH(double, nullRatio);
+    QFB_REQUIRE_DATABASE();
+
+    const int columns = 4;
+    const int rows = 1000000 / columns;
+    std::vector<FakeIBPP::Column> defs;
+    for (int c = 0; c < columns; ++c)
+        defs.push_back(FakeIBPP::Column(std::string(1, char('A' + c)), IBPP::SDT(type),
+                                        width, scale, nullRatio));
+    FakeIBPP::AddTable("BENCH_DECODE", defs, rows);
+
+    QSqlQuery q(db);
+    q.setForwardOnly(true);
+    QBENCHMARK
+    {
+        QFB_VERIFY_QUERY(q, q.exec(QLatin1String("SELECT A, B, C, D FROM BENCH_DECODE")));
+        int n = 0;
+        while (q.next())
+        {
+            for (int c = 0; c < columns; ++c)
+                q.value(c);
+            ++n;
+        }
+        QCOMPARE(n, rows);
+    }
+#else
+    QSKIP("needs a build with CONFIG+=fakeibpp", SkipAll);
+#endif
+}
+//-----------------------------------------------------------------------//
+void tst_QFBDriverBenchmark::record()
+{
+    QFB_REQUIRE_SERVER();
+    QVERIFY(recreateTable(QLatin1String("BENCH_RECORD"),
+                          QLatin1String("ID INTEGER NOT NULL PRIMARY KEY, A VARCHAR(20), "
+                                        "B NUMERIC(18,4), C TIMESTAMP, D BLOB SUB_TYPE 1")));
+
+    QBENCHMARK
+    {
+        QCOMPARE(db.record(QLatin1String("BENCH_RECORD")).count(), 5);
+    }
+}
+//-----------------------------------------------------------------------//
+void tst_QFBDriverBenchmark::tables()
+{
+    QFB_REQUIRE_SERVER();
+
+    QBENCHMARK
+    {
+        db.tables(QSql::AllTables);
+    }
+}
+//-----------------------------------------------------------------------//
+QTEST_MAIN(tst_QFBDriverBenchmark)
+#include "tst_bench_qfbdriver.moc"
@@ -1,7 +1,9 @@
 DEPENDPATH += $$PWD
 INCLUDEPATH += $$PWD
 HEADERS		+= $$PWD/src/qsql_ibpp.h \
-		$$PWD/src/qsqlcachedresult_p.h
+		$$PWD/src/qsqlcachedresult_p.h \
+		$$PWD/src/qfbrowblock.h \
+		$$PWD/src/qfbbulkinsert.h
 SOURCES		+= $$PWD/src/qsql_ibpp.cpp
 DEFINES +=   QT_NO_CAST_TO_ASCII \
   QT_NO_CAST_FROM_ASCII
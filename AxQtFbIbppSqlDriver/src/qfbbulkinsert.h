@@ -0,0 +1,96 @@
+/*
+* This file is part of QtFirebirdIBPPSQLDriver - Qt SQL driver for Firebird with IBPP library
+* Copyright (C) 2006-2010 Alex Wencel
+*
+* Contact e-mail: Alex Wencel <alex.wencel@gmail.com>
+* Program URL   : http://code.google.com/p/qtfirebirdibppsqldriver
+*
+* GNU Lesser General Public License Usage
+* This file may be used under the terms of the GNU Lesser
+* General Public License version 2.1 as published by the Free Software
+* Foundation and appearing in the file LICENSE.LGPL included in the
+* packaging of this file.  Please review the following information to
+* ensure the GNU Lesser General Public License version 2.1 requirements
+* will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+*
+* GNU General Public License Usage
+* Alternatively, this file may be used under the terms of the GNU
+* General Public License version 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in the
+* packaging of this file.  Please review the following information to
+* ensure the GNU General Public License version 3.0 requirements will be
+* met: http://www.gnu.org/copyleft/gpl.html.
+*
+*/
+
+#ifndef QFBBULKINSERT_H
+#define QFBBULKINSERT_H
+
+#include <QtCore/qlist.h>
+#include <QtCore/qobject.h>
+#include <QtCore/qstringlist.h>
+#include <QtCore/qvariant.h>
+#include <QtSql/qsqldatabase.h>
+#include <QtSql/qsqldriver.h>
+
+QT_BEGIN_HEADER
+
+// Rows for qFBBulkInsert(). next() sets values to the next row, one value
+// per column in column order, and returns false after the last row.
+class QFBRowSource
+{
+public:
+    virtual ~QFBRowSource() {}
+    virtual bool next(QVariantList &values) = 0;
+};
+
+// Rows kept in a list
+class QFBRowListSource : public QFBRowSource
+{
+public:
+    explicit QFBRowListSource(const QList<QVariantList> &rows) : rows(rows), pos(0) {}
+
+    bool next(QVariantList &values)
+    {
+        if (pos >= rows.count())
+            return false;
+        values = rows.at(pos++);
+        return true;
+    }
+
+private:
+    const QList<QVariantList> rows;
+    int pos;
+};
+
+// Inserts the rows of source into columns of table. Many rows go to the
+// server at once in a parameterized EXECUTE BLOCK, which needs Firebird
+// 2.5. Outside of a transaction the rows are committed every commitRows
+// rows; inside of one they are left to it.
+//
+// Returns the number of rows inserted ("rows"), EXECUTE BLOCK executions
+// ("statements"), rows per statement ("rowsPerStatement"), commits
+// ("commits"), the duration ("seconds") and "rowsPerSecond". On an error
+// "error" holds the message, see also QSqlDriver::lastError(); outside of
+// a transaction the current chunk is rolled back and "rows" counts the
+// rows committed before.
+inline QVariantMap qFBBulkInsert(const QSqlDatabase &db, const QString &table,
+                                 const QStringList &columns, QFBRowSource &source,
+                                 int commitRows = 10000)
+{
+    QVariantMap stat;
+    if (!db.driver())
+        return stat;
+
+    QMetaObject::invokeMethod(db.driver(), "bulkInsert",
+                              Qt::DirectConnection,
+                              Q_RETURN_ARG(QVariantMap, stat),
+                              Q_ARG(QString, table),
+                              Q_ARG(QStringList, columns),
+                              Q_ARG(QFBRowSource *, &source),
+                              Q_ARG(int, commitRows));
+    return stat;
+}
+
+QT_END_HEADER
+#endif // QFBBULKINSERT_H
@@ -0,0 +1,110 @@
+/*
+* This file is part of QtFirebirdIBPPSQLDriver - Qt SQL driver for Firebird with IBPP library
+* Copyright (C) 2006-2010 Alex Wencel
+*
+* Contact e-mail: Alex Wencel <alex.wencel@gmail.com>
+* Program URL   : http://code.google.com/p/qtfirebirdibppsqldriver
+*
+* GNU Lesser General Public License Usage
+* This file may be used under the terms of the GNU Lesser
+* General Public License version 2.1 as published by the Free Software
+* Foundation and appearing in the file LICENSE.LGPL included in the
+* packaging of this file.  Please review the following information to
+* ensure the GNU Lesser General Public License version 2.1 requirements
+* will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+*
+* GNU General Public License Usage
+* Alternatively, this file may be used under the terms of the GNU
+* General Public License version 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in the
+* packaging of this file.  Please review the following information to
+* ensure the GNU General Public License version 3.0 requirements will be
+* met: http://www.gnu.org/copyleft/gpl.html.
+*
+*/
+
+#ifndef QFBROWBLOCK_H
+#define QFBROWBLOCK_H
+
+#include <QtCore/qbitarray.h>
+#include <QtCore/qbytearray.h>
+#include <QtCore/qstring.h>
+#include <QtCore/qvector.h>
+#include <QtCore/qobject.h>
+#include <QtSql/qsqldriver.h>
+#include <QtSql/qsqlquery.h>
+#include <QtSql/qsqlresult.h>
+
+QT_BEGIN_HEADER
+
+// Rows of an active select in typed column buffers, filled by
+// qFBFetchRowBlock() without creating a QVariant per value.
+//
+//  Int32    - int32s        SMALLINT, INTEGER
+//  Int64    - int64s        BIGINT
+//  Double   - doubles       FLOAT, DOUBLE PRECISION, NUMERIC, DECIMAL
+//  Date     - int32s        julian day, see QDate::fromJulianDay()
+//  Time     - int32s        milliseconds since midnight
+//  DateTime - int64s        milliseconds since 1970-01-01 00:00, no time zone
+//  String   - offsets/bytes value r is bytes[offsets[r] .. offsets[r + 1]),
+//                           in the connection character set, CHAR padding removed
+//
+// BLOB and ARRAY columns are Unsupported and are left empty.
+// A set bit in nulls marks a NULL; the buffer holds 0 or an empty string then.
+class QFBRowBlock
+{
+public:
+    enum ColumnKind
+    {
+        Unsupported,
+        Int32,
+        Int64,
+        Double,
+        Date,
+        Time,
+        DateTime,
+        String
+    };
+
+    struct Column
+    {
+        Column() : kind(Unsupported), scale(0) {}
+
+        QString name;
+        ColumnKind kind;
+        int scale;
+
+        QVector<qint32> int32s;
+        QVector<qint64> int64s;
+        QVector<double> doubles;
+        QVector<int> offsets;
+        QByteArray bytes;
+        QBitArray nulls;
+    };
+
+    QFBRowBlock() : rowCount(0) {}
+
+    int rowCount;
+    QVector<Column> columns;
+};
+
+// Fetches up to maxRows rows of the active select of query into block and
+// returns the number of rows fetched, 0 after the last row or -1 on error.
+// Rows fetched this way are not seen by QSqlQuery::next().
+inline int qFBFetchRowBlock(const QSqlQuery &query, QFBRowBlock &block, int maxRows)
+{
+    int rows = -1;
+    if (!query.driver() || !query.result())
+        return rows;
+
+    QMetaObject::invokeMethod(const_cast<QSqlDriver *>(query.driver()), "fetchRowBlock",
+                              Qt::DirectConnection,
+                              Q_RETURN_ARG(int, rows),
+                              Q_ARG(const QSqlResult *, query.result()),
+                              Q_ARG(QFBRowBlock *, &block),
+                              Q_ARG(int, maxRows));
+    return rows;
+}
+
+QT_END_HEADER
+#endif // QFBROWBLOCK_H
@@ -33,12 +33,34 @@
 #include <qsqlquery.h>
 #include <qstringlist.h>
 #include <qlist.h>
+#include <qlinkedlist.h>
+#include <qhash.h>
 #include <qvector.h>
+#include <qiodevice.h>
+#include <qfile.h>
+#include <qdatastream.h>
+#include <qmutex.h>
+#include <qwaitcondition.h>
+#include <qcryptographichash.h>
+#include <qthread.h>
+#include <qfutureinterface.h>
+#include <qcoreevent.h>
+#include <qatomic.h>
+#if QT_VERSION >= 0x040700
+#include <qelapsedtimer.h>
+#endif
+
+#include <string.h>
+#include <ctype.h>
 
 
 #include "ibpp.h"
+#include "_ibpp.h"  // DatabaseImpl::GetHandle() for fb_cancel_operation()
 #include "qsql_ibpp.h"
 
+Q_DECLARE_METATYPE(IBPP::Blob)
+Q_DECLARE_METATYPE(QIODevice*)
+
 #define blr_text		(unsigned char)14
 #define blr_text2		(unsigned char)15	/* added in 3.2 JPN */
 #define blr_short		(unsigned char)7
@@ -129,318 +151,3636 @@ static std::string toIBPPStr(const QString &s, const QTextCodec *textCodec)
     return std::string(ba.constData(), ba.size());
 }
 //-----------------------------------------------------------------------//
-static QString fromIBPPStr(std::string &s, const QTextCodec *textCodec)
+// How string columns of a connection are decoded, chosen from CHARSET
+enum QFBStringDecoding
+{
+    CodecStrings,   // textCodec only
+    Utf8Strings,    // UTF8, UNICODE_FSS
+    Latin1Strings,  // ASCII
+    AsciiStrings    // NONE, textCodec for anything beyond 7 bits
+};
+//-----------------------------------------------------------------------//
+static inline bool qIsAsciiSpace(char c)
+{
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+//-----------------------------------------------------------------------//
+// CHAR columns come padded with spaces up to the declared length,
+// so the padding is skipped a machine word at a time
+static int qPaddedLength(const char *data, int len)
+{
+    const quint64 spaces = Q_UINT64_C(0x2020202020202020);
+    while (len >= 8)
+    {
+        quint64 w;
+        memcpy(&w, data + len - 8, 8);
+        if (w != spaces)
+            break;
+        len -= 8;
+    }
+    while (len > 0 && data[len - 1] == ' ')
+        --len;
+    return len;
+}
+//-----------------------------------------------------------------------//
+static bool qIsAscii(const char *data, int len)
+{
+    const quint64 highBits = Q_UINT64_C(0x8080808080808080);
+    int i = 0;
+    for (; i + 8 <= len; i += 8)
+    {
+        quint64 w;
+        memcpy(&w, data + i, 8);
+        if (w & highBits)
+            return false;
+    }
+    for (; i < len; ++i)
+        if (uchar(data[i]) & 0x80)
+            return false;
+    return true;
+}
+//-----------------------------------------------------------------------//
+static QString fromIBPPStr(const char *data, int len, int decoding, const QTextCodec *textCodec)
 {
     if (!textCodec)
-        return QString::fromStdString(s);
+        return QString::fromAscii(data, len);
+
+    len = qPaddedLength(data, len);
+    while (len > 0 && qIsAsciiSpace(data[len - 1]))
+        --len;
+    while (len > 0 && qIsAsciiSpace(*data))
+    {
+        ++data;
+        --len;
+    }
+
+    QString s;
+    if (decoding != CodecStrings && qIsAscii(data, len))
+        return QString::fromLatin1(data, len);
+    else if (decoding == Utf8Strings)
+        s = QString::fromUtf8(data, len);
+    else if (decoding == Latin1Strings)
+        s = QString::fromLatin1(data, len);
+    else
+        s = textCodec->toUnicode(data, len);
+
+    // the codecs know whitespace beyond ASCII, e.g. NO-BREAK SPACE
+    if (!s.isEmpty() && (s.at(0).isSpace() || s.at(s.size() - 1).isSpace()))
+        return s.trimmed();
+    return s;
+}
+//-----------------------------------------------------------------------//
+// IBPP::Date counts days from 31 December 1899 (day 0), IBPP::Time ten
+// thousandths of a second from midnight, so both convert with integer
+// math. Qt 4's QDate counts Julian calendar days before 15 October 1582
+// while Firebird's calendar is proleptic Gregorian; dates that old keep
+// their year, month and day through the component path.
+static const int ibppDayOffset = 2415020;       // Julian day of IBPP's day 0
+static const int firstGregorianDay = 2299161;   // 15 October 1582
+//-----------------------------------------------------------------------//
+static int qJulianDay(const IBPP::Date &id)
+{
+    const int jd = id.GetDate() + ibppDayOffset;
+    if (jd >= firstGregorianDay)
+        return jd;
 
-    return textCodec->toUnicode(s.data(), s.size()).trimmed();
+    int y,m,d;
+    id.GetDate(y,m,d);
+    return QDate(y,m,d).toJulianDay();
+}
+//-----------------------------------------------------------------------//
+static void qSetIBPPDate(IBPP::Date &id, const QDate &t)
+{
+    const int jd = t.toJulianDay();
+    if (jd >= firstGregorianDay)
+        id.SetDate(jd - ibppDayOffset);
+    else
+        id.SetDate(t.year(), t.month(), t.day());
+}
+//-----------------------------------------------------------------------//
+static inline int qMSecsOfDay(const IBPP::Time &it)
+{
+    return it.GetTime() / 10;
 }
 //-----------------------------------------------------------------------//
 static IBPP::Timestamp toIBPPTimeStamp(const QDateTime &dt)
 {
     IBPP::Timestamp ts;
     if (dt.isValid())
-        ts = IBPP::Timestamp(dt.date().year(), dt.date().month(), dt.date().day(),
-                             dt.time().hour(), dt.time().minute(), dt.time().second(), dt.time().msec());
+    {
+        qSetIBPPDate(ts, dt.date());
+        ts.SetTime(QTime(0, 0).msecsTo(dt.time()) * 10);
+    }
     return ts;
 }
 //-----------------------------------------------------------------------//
 static QDateTime fromIBPPTimeStamp(IBPP::Timestamp &dt)
 {
-    int y,m,d,h,min,s,ms;
-    dt.GetDate(y,m,d);
-    dt.GetTime(h,min,s,ms);
-    return QDateTime(QDate(y,m,d), QTime(h,min,s,ms));
+    return QDateTime(QDate::fromJulianDay(qJulianDay(dt)), QTime(0, 0).addMSecs(qMSecsOfDay(dt)));
 }
 //-----------------------------------------------------------------------//
 static IBPP::Time toIBPPTime(const QTime &t)
 {
     IBPP::Time it;
     if (t.isValid())
-        it.SetTime(t.hour(), t.minute(), t.second(), t.msec());
+        it.SetTime(QTime(0, 0).msecsTo(t) * 10);
     return it;
 }
 //-----------------------------------------------------------------------//
 static QTime fromIBPPTime(IBPP::Time & it)
 {
-    int h,min,s,ms;
-    it.GetTime(h,min,s,ms);
-    return QTime(h,min,s,ms);
+    return QTime(0, 0).addMSecs(qMSecsOfDay(it));
 }
 //-----------------------------------------------------------------------//
 static IBPP::Date toIBPPDate(const QDate &t)
 {
     IBPP::Date id;
     if (t.isValid())
-        id.SetDate(t.year(), t.month(), t.day());
+        qSetIBPPDate(id, t);
     return id;
 }
 //-----------------------------------------------------------------------//
 static QDate fromIBPPDate(IBPP::Date &id)
 {
-    int y,m,d;
-    id.GetDate(y,m,d);
-    return QDate(y,m,d);
+    return QDate::fromJulianDay(qJulianDay(id));
 }
 //-----------------------------------------------------------------------//
-class QFBDriverPrivate
+// NUMERIC and DECIMAL columns are integers scaled by 10^-scale, IBPP hands
+// them over unscaled through the 64 bit integer getter and setter.
+static const int maxScale = 18;
+
+static const qint64 powersOf10[maxScale + 1] =
 {
-public:
-    QFBDriverPrivate(QFBDriver *dd)
-        : d(dd)
-        , textCodec(0)
-    {
-        iDb.clear();
-        iTr.clear();
+    Q_INT64_C(1), Q_INT64_C(10), Q_INT64_C(100), Q_INT64_C(1000), Q_INT64_C(10000),
+    Q_INT64_C(100000), Q_INT64_C(1000000), Q_INT64_C(10000000), Q_INT64_C(100000000),
+    Q_INT64_C(1000000000), Q_INT64_C(10000000000), Q_INT64_C(100000000000),
+    Q_INT64_C(1000000000000), Q_INT64_C(10000000000000), Q_INT64_C(100000000000000),
+    Q_INT64_C(1000000000000000), Q_INT64_C(10000000000000000),
+    Q_INT64_C(100000000000000000), Q_INT64_C(1000000000000000000)
+};
 
-        tam = IBPP::amWrite;
-        til = IBPP::ilConcurrency;
-        tlr = IBPP::lrWait;
-        tff = IBPP::TFF(0);
-    }
+static const double doublePowersOf10[maxScale + 1] =
+{
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+    1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18
+};
 
-    void setError(const std::string &err, IBPP::Exception &e, QSqlError::ErrorType type);
-    void checkTransactionArguments();
+static const char digitPairs[] =
+    "00010203040506070809101112131415161718192021222324"
+    "25262728293031323334353637383940414243444546474849"
+    "50515253545556575859606162636465666768697071727374"
+    "75767778798081828384858687888990919293949596979899";
+//-----------------------------------------------------------------------//
+// Exact decimal text of raw * 10^-scale, two digits per division
+static QString qScaledToString(qint64 raw, int scale)
+{
+    char buf[32];
+    char *const end = buf + sizeof(buf);
+    char *p = end;
 
-public:
-    IBPP::Database iDb;
-    IBPP::Transaction iTr;
-    QList<IBPP::Transaction> iL;
+    quint64 u = raw < 0 ? quint64(0) - quint64(raw) : quint64(raw);
+    while (u >= 100)
+    {
+        const int r = int(u % 100) * 2;
+        u /= 100;
+        *--p = digitPairs[r + 1];
+        *--p = digitPairs[r];
+    }
+    if (u >= 10)
+    {
+        *--p = digitPairs[u * 2 + 1];
+        *--p = digitPairs[u * 2];
+    }
+    else
+        *--p = char('0' + u);
 
-    IBPP::TAM tam;
-    IBPP::TIL til;
-    IBPP::TLR tlr;
-    IBPP::TFF tff;
+    // at least one digit before the point
+    while (end - p <= scale)
+        *--p = '0';
+    if (scale > 0)
+    {
+        char *const point = end - scale;
+        memmove(p - 1, p, point - p);
+        --p;
+        point[-1] = '.';
+    }
+    if (raw < 0)
+        *--p = '-';
 
-    QFBDriver *d;
-    QTextCodec *textCodec;
-};
+    return QString::fromLatin1(p, int(end - p));
+}
 //-----------------------------------------------------------------------//
-void QFBDriverPrivate::setError(const std::string &err, IBPP::Exception &e, QSqlError::ErrorType type)
+static QVariant qScaledValue(qint64 raw, int scale, QSql::NumericalPrecisionPolicy policy)
 {
-//	qWarning(err.data());
-    d->setLastError(QSqlError(QString::fromLatin1(err.data()),
-                              QString::fromLatin1(e.ErrorMessage()), type));
+    switch (policy)
+    {
+    case QSql::LowPrecisionInt32:
+        return int(raw / powersOf10[scale]);
+    case QSql::LowPrecisionInt64:
+        return qlonglong(raw / powersOf10[scale]);
+    case QSql::HighPrecision:
+        return qScaledToString(raw, scale);
+    default:
+        return double(raw) / doublePowersOf10[scale];
+    }
 }
 //-----------------------------------------------------------------------//
-void QFBDriverPrivate::checkTransactionArguments()
+// Parses a plain decimal like "-12.345" into an integer scaled by
+// 10^scale, rounding half away from zero. Returns false for anything else,
+// e.g. an exponent, or on overflow.
+static bool qParseScaled(const QString &s, int scale, qint64 *out)
 {
-    if (!d->property("Transaction").isValid())
+    const QChar *p = s.constData();
+    const QChar *end = p + s.length();
+    while (p < end && p->isSpace())
+        ++p;
+    while (end > p && end[-1].isSpace())
+        --end;
+
+    bool negative = false;
+    if (p < end && (p->unicode() == '-' || p->unicode() == '+'))
     {
-        tam = IBPP::amWrite;
-        til = IBPP::ilConcurrency;
-        tlr = IBPP::lrWait;
-        tff = IBPP::TFF(0);
-        return;
+        negative = p->unicode() == '-';
+        ++p;
     }
 
-    QString args = d->property("Transaction").toString();
-    const QStringList opts(args.split(QLatin1Char(','), QString::SkipEmptyParts));
-    for (int i = 0; i < opts.count(); ++i)
+    const quint64 limit = quint64(Q_INT64_C(0x7fffffffffffffff)) + (negative ? 1 : 0);
+    quint64 value = 0;
+    int digits = 0;
+    int fraction = -1;      // digits after the point taken so far
+    int roundDigit = -1;
+    for (; p < end; ++p)
     {
-        const QString tmp(opts.at(i));
-        int idx;
-        if ((idx = tmp.indexOf(QLatin1Char('='))) == -1)
+        const ushort c = p->unicode();
+        if (c == '.' && fraction < 0)
         {
-            qWarning("QFBDriver::checkTransactionArguments: Illegal option value '%s'",
-                     tmp.toLocal8Bit().constData());
+            fraction = 0;
             continue;
         }
+        if (c < '0' || c > '9')
+            return false;
+        ++digits;
 
-        const QString opt(tmp.left(idx).simplified());
-        const QString val(tmp.mid(idx + 1).simplified());
-
-        if (opt == QLatin1String("TAM"))
+        if (fraction == scale)
         {
-            if (val == QLatin1String("amWrite"))
-                tam = IBPP::amWrite;
-            else
-                if (val == QLatin1String("amRead"))
-                    tam = IBPP::amRead;
-                else
-                    qWarning("QFBDriver::checkTransactionArguments: Unknown IBPP::TAM value '%s'",
-                             tmp.toLocal8Bit().constData());
+            if (roundDigit < 0)
+                roundDigit = c - '0';
             continue;
         }
-        else
-            if (opt == QLatin1String("TIL"))
-            {
-                if (val == QLatin1String("ilConcurrency"))
-                    til = IBPP::ilConcurrency;
-                else
-                    if (val == QLatin1String("ilReadDirty"))
-                        til = IBPP::ilReadDirty;
-                    else
-                        if (val == QLatin1String("ilReadCommitted"))
-                            til = IBPP::ilReadCommitted;
-                        else
-                            if (val == QLatin1String("ilConsistency"))
-                                til = IBPP::ilConsistency;
-                            else
-                                qWarning("QFBDriver::checkTransactionArguments: Unknown IBPP::TIL value '%s'",
-                                         tmp.toLocal8Bit().constData());
-                continue;
-            }
-            else
-                if (opt == QLatin1String("TLR"))
-                {
-                    if (val == QLatin1String("lrWait"))
-                        tlr = IBPP::lrWait;
-                    else
-                        if (val == QLatin1String("lrNoWait"))
-                            tlr = IBPP::lrNoWait;
-                        else
-                            qWarning("QFBDriver::checkTransactionArguments: Unknown IBPP::TLR value '%s'",
-                                     tmp.toLocal8Bit().constData());
-                    continue;
-                }
-                else
-                    if (opt == QLatin1String("TFF"))
-                    {
-                        if (val == QLatin1String("0"))
-                            tff = IBPP::TFF(0);
-                        else
-                            if (val == QLatin1String("tfIgnoreLimbo"))
-                                tff = IBPP::tfIgnoreLimbo;
-                            else
-                                if (val == QLatin1String("tfAutoCommit"))
-                                    tff = IBPP::tfAutoCommit;
-                                else
-                                    if (val == QLatin1String("tfNoAutoUndo"))
-                                        tff = IBPP::tfNoAutoUndo;
-                                    else
-                                        qWarning("QFBDriver::checkTransactionArguments: Unknown IBPP::TLR value '%s'",
-                                                 tmp.toLocal8Bit().constData());
-                        continue;
-                    }
-                    else
-                        qWarning("QFBDriver::checkTransactionArguments: Unknown transaction attribute '%s'",
-                                 tmp.toLocal8Bit().constData());
-    }
-//    qWarning("IBPP::Transaction arguments(TAM=%d, TIL=%d, TLR=%d, TFF=%d)", tam, til, tlr, tff);
-    d->setProperty("Transaction",QVariant());
-
-}
-//-----------------------------------------------------------------------//
-class QFBResultPrivate
-{
-public:
-    QFBResultPrivate(QFBResult *rr, const QFBDriver *dd, QTextCodec *tc);
-    ~QFBResultPrivate()
-    {
-        cleanup();
+        if (fraction >= 0)
+            ++fraction;
+        if (value > (limit - (c - '0')) / 10)
+            return false;
+        value = value * 10 + (c - '0');
     }
+    if (!digits)
+        return false;
 
-    void cleanup();
-
-    bool transaction();
-    bool commit();
-
-    bool isSelect();
-
-    void setError(const std::string &err, IBPP::Exception &e, QSqlError::ErrorType type);
-
-public:
-    QFBResult *r;
-    const QFBDriver *d;
-
-    bool localTransaction;
-
-    int queryType;
-
-    IBPP::Database iDb;
-    IBPP::Transaction iTr;
-    IBPP::Statement iSt;
-
-    QTextCodec *textCodec;
-};
-//-----------------------------------------------------------------------//
-QFBResultPrivate::QFBResultPrivate(QFBResult *rr, const QFBDriver *dd, QTextCodec *tc):
-        r(rr), d(dd), queryType(-1), textCodec(tc)
-{
-    localTransaction = true;
-    iDb = dd->dp->iDb;
-
-    try
+    for (int f = qMax(fraction, 0); f < scale; ++f)
     {
-        iTr = IBPP::TransactionFactory(iDb);
-        iSt = IBPP::StatementFactory(iDb,iTr);
+        if (value > limit / 10)
+            return false;
+        value *= 10;
     }
-    catch (IBPP::Exception& e)
+    if (roundDigit >= 5)
     {
-        setError("Unable create local transaction and statement", e, QSqlError::StatementError);
+        if (value >= limit)
+            return false;
+        ++value;
     }
+
+    *out = negative ? qint64(quint64(0) - value) : qint64(value);
+    return true;
 }
 //-----------------------------------------------------------------------//
-void QFBResultPrivate::cleanup()
+// isc_get_segment() and isc_put_segment() take the length as an unsigned short
+static const int maxBlobSegment = 64 * 1024 - 1;
+//-----------------------------------------------------------------------//
+static QByteArray fromIBPPBlob(IBPP::Blob &blob)
 {
-    commit();
+    blob->Open();
 
-    //if (!localTransaction)
-    //iTr = 0;
+    int size = 0, largest = 0, segments = 0;
+    blob->Info(&size, &largest, &segments);
 
-    try
-    {
-        iSt->Close();
-    }
-    catch (IBPP::Exception& e)
-    {
-        setError("Unable close statement", e, QSqlError::StatementError);
-    }
+    QByteArray ba;
+    ba.resize(size);
 
-    queryType = -1;
+    int offset = 0, read = 0;
+    while (offset < size && (read = blob->Read(ba.data() + offset, qMin(size - offset, maxBlobSegment))) > 0)
+        offset += read;
+    ba.resize(offset);
 
-    r->cleanup();
+    blob->Close();
+    return ba;
 }
 //-----------------------------------------------------------------------//
-void QFBResultPrivate::setError(const std::string &err, IBPP::Exception &e, QSqlError::ErrorType type)
+template <typename T>
+static void qAppendArrayValues(QVariantList &list, const void *buffer, int count)
 {
-//	qWarning(err.data());
-    qWarning(e.ErrorMessage());
-    r->setLastError(QSqlError(QString::fromLatin1(err.data()),
-                              QString::fromLatin1(e.ErrorMessage()), type));
+    const T *values = static_cast<const T *>(buffer);
+    for (int k = 0; k < count; ++k)
+        list.append(QVariant(values[k]));
 }
 //-----------------------------------------------------------------------//
-bool QFBResultPrivate::isSelect()
+// Firebird stores the elements of an array row by row, a slice of several
+// dimensions becomes nested lists with one level per dimension
+static QVariantList qNestArray(const QVariantList &flat, const QVector<int> &extents, int dim, int &pos)
 {
-    bool iss = false;
-    try
+    QVariantList list;
+    list.reserve(extents.at(dim));
+    for (int k = 0; k < extents.at(dim); ++k)
     {
-        iss = (iSt->Type() == IBPP::stSelect);
+        if (dim == extents.count() - 1)
+            list.append(flat.at(pos++));
+        else
+            list.append(QVariant(qNestArray(flat, extents, dim + 1, pos)));
     }
-    catch (IBPP::Exception& e)
+    return list;
+}
+//-----------------------------------------------------------------------//
+static void qFlattenArray(const QVariant &val, QVariantList &flat)
+{
+    if (val.type() != QVariant::List && val.type() != QVariant::StringList)
     {
-        setError("Unable get type of statement", e, QSqlError::StatementError);
+        flat.append(val);
+        return;
     }
-    return iss;
+
+    const QVariantList list = val.toList();
+    for (int k = 0; k < list.count(); ++k)
+        qFlattenArray(list.at(k), flat);
+}
+//-----------------------------------------------------------------------//
+// Decoder entry of one result column, filled once per prepared statement
+struct QFBColumn
+{
+    IBPP::SDT type;
+    int scale;
+    int size;
+    QVariant::Type qtype;
+    QVariant nullValue;
+    std::string table;      // relation and field of an ARRAY column
+    std::string name;
+};
+//-----------------------------------------------------------------------//
+typedef bool (*QFBParamSetter)(QFBResultPrivate *rp, int i, const QVariant &val);
+
+// Binder entry of one statement parameter, filled once per prepared statement
+struct QFBParameter
+{
+    IBPP::SDT type;
+    int scale;
+    QFBParamSetter set;
+    std::string table;      // column an ARRAY parameter is written to
+    std::string column;
+};
+//-----------------------------------------------------------------------//
+// Described array of one column or parameter, isc_array_lookup_bounds()
+// queries the catalog so it is done once per transaction object
+struct QFBArraySlot
+{
+    QFBArraySlot() : tr(0), type(IBPP::sdArray), size(0), scale(0), lowerBound(0), elements(0) {}
+
+    IBPP::ITransaction *tr;
+    IBPP::Array array;
+    IBPP::SDT type;         // of the elements
+    int size;
+    int scale;
+    QVector<int> extents;   // elements per dimension
+    int lowerBound;         // of the first dimension
+    int elements;
+};
+//-----------------------------------------------------------------------//
+struct QFBStatementStatistics;
+
+// Metadata of a prepared statement which does not change between executions
+struct QFBStatementPlan
+{
+    QFBStatementPlan()
+        : ddl(false)
+        , described(false)
+        , paramsDescribed(false)
+        , valueCount(-1)
+        , stats(0)
+    {
+    }
+
+    bool ddl;
+
+    bool described;
+    QVector<QFBColumn> columns;
+    QSqlRecord record;
+
+    bool paramsDescribed;
+    QVector<QFBParameter> params;
+
+    // placeholder names in marker order, empty for a positional statement
+    QStringList paramNames;
+    // index of each marker's value in QSqlResult::boundValues(), computed
+    // for valueCount values
+    QVector<int> valueIndex;
+    int valueCount;
+
+    QFBStatementStatistics *stats;  // STATISTICS=ON
+};
+//-----------------------------------------------------------------------//
+struct QFBCachedStatement
+{
+    QByteArray key;
+    IBPP::Transaction iTr;
+    IBPP::Statement iSt;
+    QFBStatementPlan plan;
+};
+//-----------------------------------------------------------------------//
+// LRU list of prepared statements which are not in use by any result.
+// A result takes a statement out of the cache on prepare and puts it back
+// on cleanup, so a statement is never shared by two results.
+class QFBStatementCache
+{
+public:
+    QFBStatementCache()
+        : maxSize(0), hits(0), misses(0), evictions(0)
+    {
+    }
+
+    bool take(const QByteArray &key, QFBCachedStatement &entry);
+    void put(const QFBCachedStatement &entry);
+    void purge(const IBPP::ITransaction *tr);
+    void clear();
+    void setMaxSize(int size);
+
+    int count() const { return lru.count(); }
+
+public:
+    int maxSize;
+    int hits;
+    int misses;
+    int evictions;
+
+private:
+    void evict(QLinkedList<QFBCachedStatement>::iterator it);
+
+    QLinkedList<QFBCachedStatement> lru; // least recently used first
+    QMultiHash<QByteArray, QLinkedList<QFBCachedStatement>::iterator> index;
+};
+//-----------------------------------------------------------------------//
+bool QFBStatementCache::take(const QByteArray &key, QFBCachedStatement &entry)
+{
+    if (maxSize <= 0)
+        return false;
+
+    QMultiHash<QByteArray, QLinkedList<QFBCachedStatement>::iterator>::iterator it = index.find(key);
+    if (it == index.end())
+    {
+        ++misses;
+        return false;
+    }
+
+    entry = *it.value();
+    lru.erase(it.value());
+    index.erase(it);
+    ++hits;
+    return true;
+}
+//-----------------------------------------------------------------------//
+void QFBStatementCache::put(const QFBCachedStatement &entry)
+{
+    index.insert(entry.key, lru.insert(lru.end(), entry));
+    while (lru.count() > maxSize)
+    {
+        evict(lru.begin());
+        ++evictions;
+    }
+}
+//-----------------------------------------------------------------------//
+void QFBStatementCache::purge(const IBPP::ITransaction *tr)
+{
+    QLinkedList<QFBCachedStatement>::iterator it = lru.begin();
+    while (it != lru.end())
+    {
+        QLinkedList<QFBCachedStatement>::iterator cur = it++;
+        if ((*cur).iTr.intf() == tr)
+            evict(cur);
+    }
+}
+//-----------------------------------------------------------------------//
+void QFBStatementCache::clear()
+{
+    while (!lru.isEmpty())
+        evict(lru.begin());
+}
+//-----------------------------------------------------------------------//
+void QFBStatementCache::setMaxSize(int size)
+{
+    maxSize = qMax(0, size);
+    while (lru.count() > maxSize)
+        evict(lru.begin());
+}
+//-----------------------------------------------------------------------//
+void QFBStatementCache::evict(QLinkedList<QFBCachedStatement>::iterator it)
+{
+    index.remove((*it).key, it);
+    try
+    {
+        (*it).iSt->Close();
+    }
+    catch (IBPP::Exception& e)
+    {
+        Q_UNUSED(e);
+    }
+    lru.erase(it);
+}
+//-----------------------------------------------------------------------//
+// Cheap look at the first keyword, the statement type reported by the
+// server after Prepare() has the final say.
+static bool qLooksLikeSelect(const std::string &sql)
+{
+    std::string::size_type i = 0;
+    const std::string::size_type n = sql.size();
+    while (i < n)
+    {
+        if (qIsAsciiSpace(sql[i]))
+            ++i;
+        else if (sql.compare(i, 2, "--") == 0)
+            i = sql.find('\n', i);
+        else if (sql.compare(i, 2, "/*") == 0)
+        {
+            i = sql.find("*/", i);
+            if (i != std::string::npos)
+                i += 2;
+        }
+        else
+            break;
+        if (i == std::string::npos)
+            return false;
+    }
+
+    static const char *const keywords[] = { "SELECT", "WITH" };
+    for (int k = 0; k < 2; ++k)
+    {
+        const std::string::size_type len = strlen(keywords[k]);
+        if (n - i <= len)
+            continue;
+        bool match = true;
+        for (std::string::size_type j = 0; match && j < len; ++j)
+            match = toupper(uchar(sql[i + j])) == keywords[k][j];
+        if (match && !isalnum(uchar(sql[i + len])) && sql[i + len] != '_')
+            return true;
+    }
+    return false;
+}
+//-----------------------------------------------------------------------//
+// Letters, digits and '_' as QSqlResult takes them for a placeholder name;
+// bytes of a multibyte character count as letters
+static inline bool qIsNameChar(char c)
+{
+    return isalnum(uchar(c)) || c == '_' || uchar(c) >= 0x80;
+}
+//-----------------------------------------------------------------------//
+static bool qIsKeyword(const std::string &sql, std::string::size_type i,
+                       std::string::size_type len, const char *keyword)
+{
+    if (len != strlen(keyword))
+        return false;
+    for (std::string::size_type j = 0; j < len; ++j)
+        if (toupper(uchar(sql[i + j])) != keyword[j])
+            return false;
+    return true;
+}
+//-----------------------------------------------------------------------//
+// Rewrites the :name placeholders of sql to '?' in one pass and returns
+// the names in marker order, an empty name for a '?'. Literals, quoted
+// identifiers and comments are skipped, and so is the body of an EXECUTE
+// BLOCK after its AS, where :name is a PSQL variable. Returns no names and
+// leaves rewritten empty if sql has no named placeholder.
+static QList<QByteArray> qParsePlaceholders(const std::string &sql, std::string &rewritten)
+{
+    typedef std::string::size_type size_type;
+
+    QList<QByteArray> names;
+    bool named = false;
+    bool block = false;
+    int words = 0;
+    int depth = 0;
+    size_type copied = 0;
+    size_type i = 0;
+    const size_type n = sql.size();
+    while (i < n)
+    {
+        const char c = sql[i];
+        if (c == '\'' || c == '"')
+        {
+            // a doubled quote just starts the next literal
+            const size_type end = sql.find(c, i + 1);
+            i = end == std::string::npos ? n : end + 1;
+        }
+        else if (sql.compare(i, 2, "--") == 0)
+        {
+            const size_type end = sql.find('\n', i);
+            i = end == std::string::npos ? n : end + 1;
+        }
+        else if (sql.compare(i, 2, "/*") == 0)
+        {
+            const size_type end = sql.find("*/", i + 2);
+            i = end == std::string::npos ? n : end + 2;
+        }
+        else if (c == ':' && i + 1 < n && qIsNameChar(sql[i + 1]) && !isdigit(uchar(sql[i + 1])))
+        {
+            size_type end = i + 2;
+            while (end < n && qIsNameChar(sql[end]))
+                ++end;
+            names.append(QByteArray(sql.data() + i + 1, int(end - i - 1)));
+            rewritten.append(sql, copied, i - copied);
+            rewritten += '?';
+            copied = i = end;
+            named = true;
+        }
+        else if (c == '?')
+        {
+            names.append(QByteArray());
+            ++i;
+        }
+        else if (qIsNameChar(c) && !isdigit(uchar(c)))
+        {
+            size_type end = i + 1;
+            while (end < n && (qIsNameChar(sql[end]) || sql[end] == '$'))
+                ++end;
+            if (words == 0)
+                block = qIsKeyword(sql, i, end - i, "EXECUTE");
+            else if (words == 1)
+                block = block && qIsKeyword(sql, i, end - i, "BLOCK");
+            else if (block && depth == 0 && qIsKeyword(sql, i, end - i, "AS"))
+                break;
+            ++words;
+            i = end;
+        }
+        else
+        {
+            if (c == '(')
+                ++depth;
+            else if (c == ')')
+                --depth;
+            else if (isdigit(uchar(c)))
+            {
+                // a number, 1E3 is no identifier
+                while (i + 1 < n && qIsNameChar(sql[i + 1]))
+                    ++i;
+            }
+            ++i;
+        }
+    }
+
+    if (!named)
+    {
+        rewritten.clear();
+        return QList<QByteArray>();
+    }
+    rewritten.append(sql, copied, std::string::npos);
+    return names;
+}
+//-----------------------------------------------------------------------//
+// Statement text the statistics are kept under: comments dropped, white
+// space collapsed, string and number literals replaced by '?'
+static QByteArray qNormalizedSql(const std::string &sql)
+{
+    typedef std::string::size_type size_type;
+
+    QByteArray out;
+    out.reserve(int(sql.size()));
+    bool space = false;
+    size_type i = 0;
+    const size_type n = sql.size();
+    while (i < n)
+    {
+        const char c = sql[i];
+        size_type end = i + 1;
+        if (c == '\'')
+        {
+            // 'it''s' is one literal
+            do
+            {
+                end = sql.find(c, end);
+                end = end == std::string::npos ? n : end + 1;
+            } while (end < n && sql[end] == c && ++end < n);
+        }
+        else if (c == '"')
+        {
+            end = sql.find(c, i + 1);
+            end = end == std::string::npos ? n : end + 1;
+        }
+        else if (sql.compare(i, 2, "--") == 0)
+        {
+            end = sql.find('\n', i);
+            end = end == std::string::npos ? n : end + 1;
+            space = true;
+            i = end;
+            continue;
+        }
+        else if (sql.compare(i, 2, "/*") == 0)
+        {
+            end = sql.find("*/", i + 2);
+            end = end == std::string::npos ? n : end + 2;
+            space = true;
+            i = end;
+            continue;
+        }
+        else if (qIsAsciiSpace(c))
+        {
+            space = true;
+            ++i;
+            continue;
+        }
+        else if (qIsNameChar(c))
+        {
+            while (end < n && (qIsNameChar(sql[end]) || sql[end] == '$' || (isdigit(uchar(c)) && sql[end] == '.')))
+                ++end;
+        }
+
+        if (space && !out.isEmpty())
+            out += ' ';
+        space = false;
+        if (c == '\'' || isdigit(uchar(c)))
+            out += '?';
+        else
+            out.append(sql.data() + i, int(end - i));
+        i = end;
+    }
+    return out;
+}
+//-----------------------------------------------------------------------//
+// Tokens of sql for qParameterTargets(): names upper-cased unless quoted,
+// a quoted name with a leading '"', a parameter marker (? or :name) as
+// "?", any literal as "'" and other characters one by one. Comments and
+// white space are dropped.
+static QList<QByteArray> qSqlTokens(const std::string &sql)
+{
+    typedef std::string::size_type size_type;
+
+    QList<QByteArray> tokens;
+    size_type i = 0;
+    const size_type n = sql.size();
+    while (i < n)
+    {
+        const char c = sql[i];
+        size_type end = i + 1;
+        if (c == '\'')
+        {
+            do
+            {
+                end = sql.find(c, end);
+                end = end == std::string::npos ? n : end + 1;
+            } while (end < n && sql[end] == c && ++end < n);
+            tokens.append(QByteArray("'"));
+        }
+        else if (c == '"')
+        {
+            // "a""b" is the name a"b
+            QByteArray name("\"");
+            for (; end < n; ++end)
+            {
+                if (sql[end] == '"' && (end + 1 >= n || sql[end + 1] != '"'))
+                    break;
+                if (sql[end] == '"')
+                    ++end;
+                name += sql[end];
+            }
+            tokens.append(name);
+            end = end < n ? end + 1 : n;
+        }
+        else if (sql.compare(i, 2, "--") == 0)
+        {
+            end = sql.find('\n', i);
+            end = end == std::string::npos ? n : end + 1;
+        }
+        else if (sql.compare(i, 2, "/*") == 0)
+        {
+            end = sql.find("*/", i + 2);
+            end = end == std::string::npos ? n : end + 2;
+        }
+        else if (qIsAsciiSpace(c))
+            ;
+        else if (c == '?' || (c == ':' && end < n && qIsNameChar(sql[end]) && !isdigit(uchar(sql[end]))))
+        {
+            while (c == ':' && end < n && qIsNameChar(sql[end]))
+                ++end;
+            tokens.append(QByteArray("?"));
+        }
+        else if (qIsNameChar(c))
+        {
+            while (end < n && (qIsNameChar(sql[end]) || sql[end] == '$'))
+                ++end;
+            if (isdigit(uchar(c)))
+                tokens.append(QByteArray("'"));
+            else
+                tokens.append(QByteArray(sql.data() + i, int(end - i)).toUpper());
+        }
+        else
+            tokens.append(QByteArray(1, c));
+        i = end;
+    }
+    return tokens;
+}
+//-----------------------------------------------------------------------//
+static std::string qSqlName(const QByteArray &token)
+{
+    const int quoted = token.startsWith("\"") ? 1 : 0;
+    return std::string(token.constData() + quoted, token.size() - quoted);
+}
+//-----------------------------------------------------------------------//
+// Column each parameter marker of sql is assigned to when the marker makes
+// up a whole value in the VALUES list of an INSERT (or UPDATE OR INSERT)
+// with a column list, or in the SET list of an UPDATE; an empty name for
+// the other markers. IBPP writes an array slice to a named column only.
+static QVector<std::string> qParameterTargets(const std::string &sql, std::string &table)
+{
+    const QList<QByteArray> tokens = qSqlTokens(sql);
+    const int n = tokens.count();
+
+    QVector<int> marker(n);
+    int markers = 0;
+    for (int t = 0; t < n; ++t)
+    {
+        marker[t] = markers;
+        if (tokens.at(t) == "?")
+            ++markers;
+    }
+
+    QVector<std::string> columns(markers);
+    table.clear();
+    if (n < 4)
+        return columns;
+
+    if (tokens.at(0) == "INSERT" || (tokens.at(0) == "UPDATE" && tokens.at(1) == "OR"))
+    {
+        int t = tokens.indexOf(QByteArray("INTO")) + 1;
+        if (t <= 0 || t + 2 >= n || tokens.at(t + 1) != "(")
+            return columns;
+        table = qSqlName(tokens.at(t));
+
+        // column list, a name qualified by the table counts by its last part
+        QList<QByteArray> names;
+        for (t += 2; t < n && tokens.at(t) != ")"; ++t)
+        {
+            if (tokens.at(t) != "," && tokens.at(t) != "." && (t + 1 >= n || tokens.at(t + 1) != "."))
+                names.append(tokens.at(t));
+        }
+        if (t + 2 >= n || tokens.at(t + 1) != "VALUES" || tokens.at(t + 2) != "(")
+            return columns;
+
+        int item = 0, start = t + 3, depth = 0;
+        for (t = start; t < n; ++t)
+        {
+            const QByteArray &token = tokens.at(t);
+            if (token == "(")
+                ++depth;
+            else if (token == ")" && depth > 0)
+                --depth;
+            else if (token == ")" || (token == "," && depth == 0))
+            {
+                if (t == start + 1 && tokens.at(start) == "?" && item < names.count())
+                    columns[marker[start]] = qSqlName(names.at(item));
+                if (token == ")")
+                    break;
+                ++item;
+                start = t + 1;
+            }
+        }
+    }
+    else if (tokens.at(0) == "UPDATE")
+    {
+        table = qSqlName(tokens.at(1));
+        int t = tokens.indexOf(QByteArray("SET")) + 1;
+        while (t > 0 && t < n)
+        {
+            int eq = t;
+            while (eq < n && tokens.at(eq) != "=")
+                ++eq;
+            if (eq == t || eq + 1 >= n)
+                break;
+
+            int end = eq + 1, depth = 0;
+            for (; end < n; ++end)
+            {
+                const QByteArray &token = tokens.at(end);
+                if (token == "(")
+                    ++depth;
+                else if (token == ")")
+                    --depth;
+                else if (depth == 0 && (token == "," || token == "WHERE" || token == "PLAN" ||
+                                        token == "ORDER" || token == "ROWS" || token == "RETURNING"))
+                    break;
+            }
+
+            if (end == eq + 2 && tokens.at(eq + 1) == "?")
+                columns[marker[eq + 1]] = qSqlName(tokens.at(eq - 1));
+            if (end >= n || tokens.at(end) != ",")
+                break;
+            t = end + 1;
+        }
+    }
+    return columns;
+}
+//-----------------------------------------------------------------------//
+struct QFBAttachParams
+{
+    std::string host;
+    std::string db;
+    std::string user;
+    std::string password;
+    std::string role;
+    std::string charSet;
+};
+//-----------------------------------------------------------------------//
+struct QFBPoolSettings
+{
+    QFBPoolSettings()
+        : minSize(0), maxSize(10), idleTimeout(300), waitTimeout(30000) {}
+
+    int minSize;
+    int maxSize;
+    int idleTimeout;    // seconds
+    int waitTimeout;    // milliseconds
+    std::string validationQuery;
+};
+//-----------------------------------------------------------------------//
+// Process wide pool of database attachments shared by all QFBDriver
+// instances opened with POOL=ON. Attachments are keyed by the connect
+// parameters; an attachment is leased to one driver between open() and
+// close(), so IBPP objects are never used by two threads at once. IBPP
+// reference counts are not atomic, so references to an attachment are
+// only copied or dropped by the pool with the mutex held.
+class QFBConnectionPool
+{
+public:
+    ~QFBConnectionPool();
+
+    static QByteArray key(const QFBAttachParams &params);
+
+    IBPP::Database acquire(const QByteArray &key, const QFBAttachParams &params,
+                           const QFBPoolSettings &settings, int *waited);
+    void release(const QByteArray &key, IBPP::Database &db, bool shared);
+    QVariantMap statistics(const QByteArray &key);
+
+private:
+    struct Idle
+    {
+        IBPP::Database iDb;
+        QDateTime since;
+    };
+
+    struct Pool
+    {
+        Pool() : leased(0), created(0), leases(0), waits(0), waitTime(0),
+                 maxWaitTime(0), timeouts(0), validationFailures(0) {}
+
+        QFBPoolSettings settings;
+        QList<Idle> idle;   // oldest first
+        int leased;         // leased or being connected
+
+        int created;
+        int leases;
+        int waits;
+        qint64 waitTime;
+        int maxWaitTime;
+        int timeouts;
+        int validationFailures;
+    };
+
+    static IBPP::Database connect(const QFBAttachParams &params);
+    static bool validate(IBPP::Database &db, const std::string &query);
+    static void disconnect(QList<IBPP::Database> &dbs);
+    void expire(Pool *pool, QList<IBPP::Database> &expired);
+
+    QMutex mutex;
+    QWaitCondition released;
+    QHash<QByteArray, Pool *> pools;
+};
+//-----------------------------------------------------------------------//
+Q_GLOBAL_STATIC(QFBConnectionPool, connectionPool)
+//-----------------------------------------------------------------------//
+QFBConnectionPool::~QFBConnectionPool()
+{
+    QList<IBPP::Database> dbs;
+    QHash<QByteArray, Pool *>::const_iterator it = pools.constBegin();
+    for (; it != pools.constEnd(); ++it)
+    {
+        for (int i = 0; i < it.value()->idle.count(); ++i)
+            dbs.append(it.value()->idle.at(i).iDb);
+        delete it.value();
+    }
+    pools.clear();
+    disconnect(dbs);
+}
+//-----------------------------------------------------------------------//
+QByteArray QFBConnectionPool::key(const QFBAttachParams &params)
+{
+    // the password only takes part as a hash, attachments opened with
+    // another password are never handed out
+    QByteArray k;
+    k.append(params.host.c_str()).append('\0');
+    k.append(params.db.c_str()).append('\0');
+    k.append(params.user.c_str()).append('\0');
+    k.append(params.role.c_str()).append('\0');
+    k.append(params.charSet.c_str()).append('\0');
+    k.append(QCryptographicHash::hash(QByteArray(params.password.c_str()),
+                                      QCryptographicHash::Sha1));
+    return k;
+}
+//-----------------------------------------------------------------------//
+IBPP::Database QFBConnectionPool::connect(const QFBAttachParams &params)
+{
+    IBPP::Database db = IBPP::DatabaseFactory(params.host, params.db, params.user,
+                                              params.password, params.role,
+                                              params.charSet, "");
+    db->Connect();
+    return db;
+}
+//-----------------------------------------------------------------------//
+bool QFBConnectionPool::validate(IBPP::Database &db, const std::string &query)
+{
+    try
+    {
+        if (!db->Connected())
+            return false;
+        if (query.empty())
+            return true;
+
+        IBPP::Transaction tr = IBPP::TransactionFactory(db, IBPP::amRead, IBPP::ilReadCommitted);
+        tr->Start();
+        IBPP::Statement st = IBPP::StatementFactory(db, tr);
+        st->Execute(query);
+        st->Close();
+        tr->Commit();
+    }
+    catch (IBPP::Exception& e)
+    {
+        Q_UNUSED(e);
+        return false;
+    }
+    return true;
+}
+//-----------------------------------------------------------------------//
+void QFBConnectionPool::disconnect(QList<IBPP::Database> &dbs)
+{
+    for (int i = 0; i < dbs.count(); ++i)
+    {
+        try
+        {
+            dbs[i]->Disconnect();
+        }
+        catch (IBPP::Exception& e)
+        {
+            Q_UNUSED(e);
+        }
+    }
+    dbs.clear();
+}
+//-----------------------------------------------------------------------//
+// Moves attachments idle for longer than the idle timeout to expired,
+// as long as the pool stays at its minimum size. Called with the mutex held.
+void QFBConnectionPool::expire(Pool *pool, QList<IBPP::Database> &expired)
+{
+    if (pool->settings.idleTimeout <= 0)
+        return;
+
+    const QDateTime now = QDateTime::currentDateTime();
+    while (!pool->idle.isEmpty() &&
+           pool->leased + pool->idle.count() > pool->settings.minSize &&
+           pool->idle.first().since.secsTo(now) >= pool->settings.idleTimeout)
+        expired.append(pool->idle.takeFirst().iDb);
+}
+//-----------------------------------------------------------------------//
+// Returns a connected attachment, or a null one when no attachment got
+// free within the wait timeout. Connect errors are thrown to the caller.
+IBPP::Database QFBConnectionPool::acquire(const QByteArray &key, const QFBAttachParams &params,
+                                          const QFBPoolSettings &settings, int *waited)
+{
+    QTime timer;
+    timer.start();
+
+    QList<IBPP::Database> expired;
+    IBPP::Database db;
+
+    QMutexLocker locker(&mutex);
+    Pool *pool = pools.value(key);
+    if (!pool)
+    {
+        pool = new Pool;
+        pools.insert(key, pool);
+    }
+    pool->settings = settings;
+    expire(pool, expired);
+
+    bool waiting = false;
+    forever
+    {
+        if (!pool->idle.isEmpty())
+        {
+            // most recently used first, it is the least likely to be stale
+            db = pool->idle.takeLast().iDb;
+            ++pool->leased;
+
+            locker.unlock();
+            const bool ok = validate(db, settings.validationQuery);
+            locker.relock();
+            if (ok)
+                break;
+
+            ++pool->validationFailures;
+            --pool->leased;
+            expired.append(db);
+            db.clear();
+            continue;
+        }
+
+        if (pool->leased < settings.maxSize)
+        {
+            ++pool->leased;
+            locker.unlock();
+            try
+            {
+                db = connect(params);
+            }
+            catch (IBPP::Exception& e)
+            {
+                Q_UNUSED(e);
+                locker.relock();
+                --pool->leased;
+                released.wakeAll();
+                locker.unlock();
+                disconnect(expired);
+                throw;
+            }
+            locker.relock();
+            ++pool->created;
+            break;
+        }
+
+        const int remaining = settings.waitTimeout - timer.elapsed();
+        if (remaining <= 0)
+        {
+            ++pool->timeouts;
+            break;
+        }
+
+        if (!waiting)
+        {
+            ++pool->waits;
+            waiting = true;
+        }
+        released.wait(&mutex, remaining);
+    }
+
+    const int elapsed = timer.elapsed();
+    if (waiting)
+    {
+        pool->waitTime += elapsed;
+        pool->maxWaitTime = qMax(pool->maxWaitTime, elapsed);
+    }
+    if (waited)
+        *waited = waiting ? elapsed : 0;
+
+    if (db == 0)
+    {
+        locker.unlock();
+        disconnect(expired);
+        return db;
+    }
+    ++pool->leases;
+
+    // keep the minimum number of attachments warm
+    while (pool->leased + pool->idle.count() < settings.minSize)
+    {
+        ++pool->leased;
+        locker.unlock();
+        Idle idle;
+        try
+        {
+            idle.iDb = connect(params);
+        }
+        catch (IBPP::Exception& e)
+        {
+            Q_UNUSED(e);
+        }
+        locker.relock();
+        --pool->leased;
+        if (idle.iDb == 0)
+            break;
+
+        idle.since = QDateTime::currentDateTime();
+        pool->idle.append(idle);
+        ++pool->created;
+        released.wakeAll();
+    }
+
+    locker.unlock();
+    disconnect(expired);
+    return db;
+}
+//-----------------------------------------------------------------------//
+// Takes the caller's reference to db. An attachment other objects still
+// refer to (shared) is disconnected instead of being put back.
+void QFBConnectionPool::release(const QByteArray &key, IBPP::Database &db, bool shared)
+{
+    bool reusable = !shared;
+    try
+    {
+        // rolls back started transactions and detaches IBPP objects
+        db->Inactivate();
+        reusable = reusable && db->Connected();
+    }
+    catch (IBPP::Exception& e)
+    {
+        Q_UNUSED(e);
+        reusable = false;
+    }
+
+    QList<IBPP::Database> expired;
+    {
+        QMutexLocker locker(&mutex);
+        Pool *pool = pools.value(key);
+        if (!pool)
+        {
+            expired.append(db);
+            db.clear();
+        }
+        else
+        {
+            --pool->leased;
+            if (reusable && pool->leased + pool->idle.count() < pool->settings.maxSize)
+            {
+                Idle idle;
+                idle.iDb = db;
+                idle.since = QDateTime::currentDateTime();
+                pool->idle.append(idle);
+            }
+            else
+            {
+                expired.append(db);
+            }
+            db.clear();
+            expire(pool, expired);
+            released.wakeAll();
+        }
+    }
+    disconnect(expired);
+}
+//-----------------------------------------------------------------------//
+QVariantMap QFBConnectionPool::statistics(const QByteArray &key)
+{
+    QVariantMap stat;
+
+    QMutexLocker locker(&mutex);
+    const Pool *pool = pools.value(key);
+    if (!pool)
+        return stat;
+
+    stat[QLatin1String("idle")] = pool->idle.count();
+    stat[QLatin1String("leased")] = pool->leased;
+    stat[QLatin1String("min")] = pool->settings.minSize;
+    stat[QLatin1String("max")] = pool->settings.maxSize;
+    stat[QLatin1String("created")] = pool->created;
+    stat[QLatin1String("leases")] = pool->leases;
+    stat[QLatin1String("waits")] = pool->waits;
+    stat[QLatin1String("waitTime")] = pool->waitTime;
+    stat[QLatin1String("maxWaitTime")] = pool->maxWaitTime;
+    stat[QLatin1String("timeouts")] = pool->timeouts;
+    stat[QLatin1String("validationFailures")] = pool->validationFailures;
+    return stat;
+}
+//-----------------------------------------------------------------------//
+// IBPP statement and transaction objects of a closed result, kept for the
+// next result preparing in the same kind of transaction. Close() has freed
+// the server statement handle; only the client objects are reused.
+struct QFBSpareHandles
+{
+    QByteArray trKey;
+    IBPP::Transaction iTr;
+    IBPP::Statement iSt;
+};
+//-----------------------------------------------------------------------//
+// Arguments of the last QFBDriver::open(), the async worker opens its own
+// connection with them
+struct QFBOpenParams
+{
+    QFBOpenParams() : port(-1) {}
+
+    QString db;
+    QString user;
+    QString password;
+    QString host;
+    int port;
+    QString connOpts;
+};
+//-----------------------------------------------------------------------//
+static const int fbCancelledCode = 335544794;   // isc_cancelled
+//-----------------------------------------------------------------------//
+// Monotonic milliseconds for deadlines, wall clock changes do not move them.
+// Before Qt 4.7 there is only the wall clock.
+static qint64 qCurrentMSecs()
+{
+#if QT_VERSION >= 0x040700
+    QElapsedTimer timer;
+    timer.start();
+    return timer.msecsSinceReference();
+#else
+    const QDateTime now = QDateTime::currentDateTime().toUTC();
+    return qint64(now.date().toJulianDay()) * Q_INT64_C(86400000) + QTime(0, 0).msecsTo(now.time());
+#endif
+}
+//-----------------------------------------------------------------------//
+// Collects the events IBPP::IEvents::Dispatch() reports, several posts of
+// one event between two dispatches become one notification.
+class QFBEventHandler : public IBPP::EventInterface
+{
+public:
+    void ibppEventHandler(IBPP::Events, const std::string &name, int count)
+    {
+        const QByteArray n(name.data(), int(name.size()));
+        if (count > 0 && !fired.contains(n))
+            fired.append(n);
+    }
+
+    QList<QByteArray> fired;
+};
+//-----------------------------------------------------------------------//
+// Catalog entry of one table or view, see QFBDriverPrivate::loadMetadata()
+struct QFBRelationInfo
+{
+    QFBRelationInfo() : system(false), view(false) {}
+
+    QString name;
+    bool system;
+    bool view;
+    QSqlRecord record;
+    QSqlIndex primaryIndex;
+};
+//-----------------------------------------------------------------------//
+// Phases timed by STATISTICS=ON, the first four also per statement
+enum QFBStatisticsPhase
+{
+    PreparePhase,
+    ExecutePhase,
+    FetchPhase,
+    ConvertPhase,
+    BlobReadPhase,
+    BlobWritePhase,
+    StartPhase,
+    CommitPhase,
+    RollbackPhase,
+    PhaseCount
+};
+
+static const char *const phaseNames[PhaseCount] =
+{
+    "prepare", "execute", "fetch", "convert", "blobRead", "blobWrite",
+    "start", "commit", "rollback"
+};
+
+// upper bounds of the histogram buckets in microseconds, the last is open
+static const int histogramBounds[] = { 100, 1000, 10000, 100000, 1000000 };
+static const int histogramBuckets = 6;
+//-----------------------------------------------------------------------//
+// Count, total time and latency histogram of one phase. Only the driver's
+// thread adds, any thread may read, so plain atomic loads and stores do.
+struct QFBPhaseStatistics
+{
+    void add(qint64 usecs);
+    void reset();
+    QVariantMap toMap() const;
+
+    QAtomicInt count;
+    QAtomicInt seconds;     // total time is seconds + usecs
+    QAtomicInt usecs;
+    QAtomicInt buckets[histogramBuckets];
+};
+//-----------------------------------------------------------------------//
+void QFBPhaseStatistics::add(qint64 elapsed)
+{
+    count.fetchAndAddRelaxed(1);
+
+    int b = 0;
+    while (b < histogramBuckets - 1 && elapsed >= histogramBounds[b])
+        ++b;
+    buckets[b].fetchAndAddRelaxed(1);
+
+    const qint64 total = usecs + elapsed;
+    if (total >= 1000000)
+    {
+        seconds.fetchAndAddRelaxed(int(total / 1000000));
+        usecs = int(total % 1000000);
+    }
+    else
+        usecs = int(total);
+}
+//-----------------------------------------------------------------------//
+void QFBPhaseStatistics::reset()
+{
+    count = 0;
+    seconds = 0;
+    usecs = 0;
+    for (int b = 0; b < histogramBuckets; ++b)
+        buckets[b] = 0;
+}
+//-----------------------------------------------------------------------//
+QVariantMap QFBPhaseStatistics::toMap() const
+{
+    QVariantList histogram;
+    for (int b = 0; b < histogramBuckets; ++b)
+        histogram << int(buckets[b]);
+
+    QVariantMap m;
+    m.insert(QLatin1String("count"), int(count));
+    m.insert(QLatin1String("usecs"), qlonglong(seconds) * 1000000 + int(usecs));
+    m.insert(QLatin1String("histogram"), histogram);
+    return m;
+}
+//-----------------------------------------------------------------------//
+struct QFBStatementStatistics
+{
+    QAtomicInt executions;
+    QAtomicInt rows;
+    QFBPhaseStatistics phases[ConvertPhase + 1];
+};
+//-----------------------------------------------------------------------//
+// Counters of one connection. Statement entries live as long as the
+// driver, prepared statements keep a pointer to theirs in the plan.
+class QFBStatistics
+{
+public:
+    QFBStatistics() : enabled(false), other(0) {}
+    ~QFBStatistics();
+
+    QFBStatementStatistics *statement(const QString &sql);
+    void add(int phase, qint64 usecs, QFBStatementStatistics *st);
+    void reset();
+    QVariantMap toMap() const;
+
+    bool enabled;
+
+private:
+    QFBPhaseStatistics phases[PhaseCount];
+
+    mutable QMutex mutex;
+    QHash<QString, QFBStatementStatistics *> statements;
+    QFBStatementStatistics *other;
+};
+//-----------------------------------------------------------------------//
+static const int maxStatementStatistics = 512;
+//-----------------------------------------------------------------------//
+QFBStatistics::~QFBStatistics()
+{
+    qDeleteAll(statements);
+    delete other;
+}
+//-----------------------------------------------------------------------//
+// Statements beyond maxStatementStatistics are counted together
+QFBStatementStatistics *QFBStatistics::statement(const QString &sql)
+{
+    QMutexLocker locker(&mutex);
+    QFBStatementStatistics *st = statements.value(sql);
+    if (st)
+        return st;
+
+    if (statements.count() < maxStatementStatistics)
+    {
+        st = new QFBStatementStatistics;
+        statements.insert(sql, st);
+        return st;
+    }
+
+    if (!other)
+        other = new QFBStatementStatistics;
+    return other;
+}
+//-----------------------------------------------------------------------//
+void QFBStatistics::add(int phase, qint64 usecs, QFBStatementStatistics *st)
+{
+    phases[phase].add(usecs);
+    if (st && phase <= ConvertPhase)
+        st->phases[phase].add(usecs);
+}
+//-----------------------------------------------------------------------//
+// Zeroes the counters, the statement entries stay in use
+void QFBStatistics::reset()
+{
+    for (int p = 0; p < PhaseCount; ++p)
+        phases[p].reset();
+
+    QMutexLocker locker(&mutex);
+    QList<QFBStatementStatistics *> all = statements.values();
+    if (other)
+        all.append(other);
+    for (int i = 0; i < all.count(); ++i)
+    {
+        all.at(i)->executions = 0;
+        all.at(i)->rows = 0;
+        for (int p = 0; p <= ConvertPhase; ++p)
+            all.at(i)->phases[p].reset();
+    }
+}
+//-----------------------------------------------------------------------//
+static QVariantMap qStatementMap(const QFBStatementStatistics *st)
+{
+    QVariantMap m;
+    m.insert(QLatin1String("executions"), int(st->executions));
+    m.insert(QLatin1String("rows"), int(st->rows));
+    for (int p = 0; p <= ConvertPhase; ++p)
+        m.insert(QLatin1String(phaseNames[p]), st->phases[p].toMap());
+    return m;
+}
+//-----------------------------------------------------------------------//
+QVariantMap QFBStatistics::toMap() const
+{
+    QVariantMap m;
+    m.insert(QLatin1String("enabled"), enabled);
+    for (int p = 0; p < PhaseCount; ++p)
+        m.insert(QLatin1String(phaseNames[p]), phases[p].toMap());
+
+    QVariantList bounds;
+    for (int b = 0; b < histogramBuckets - 1; ++b)
+        bounds << histogramBounds[b];
+    m.insert(QLatin1String("histogramBounds"), bounds);
+
+    QVariantMap sql;
+    QMutexLocker locker(&mutex);
+    QHash<QString, QFBStatementStatistics *>::const_iterator it = statements.constBegin();
+    for (; it != statements.constEnd(); ++it)
+        sql.insert(it.key(), qStatementMap(it.value()));
+    if (other)
+        sql.insert(QLatin1String("<other>"), qStatementMap(other));
+    m.insert(QLatin1String("statements"), sql);
+    return m;
+}
+//-----------------------------------------------------------------------//
+// Microsecond clock of the statistics
+class QFBStopwatch
+{
+public:
+    void start() { timer.start(); }
+#if QT_VERSION >= 0x040800
+    qint64 usecs() const { return timer.nsecsElapsed() / 1000; }
+
+private:
+    QElapsedTimer timer;
+#else
+    qint64 usecs() const { return qint64(timer.elapsed()) * 1000; }
+
+private:
+    QTime timer;
+#endif
+};
+//-----------------------------------------------------------------------//
+// Times its scope into the statistics of a connection with STATISTICS=ON
+class QFBStatisticsTimer
+{
+public:
+    QFBStatisticsTimer(QFBStatistics &stats, int phase, QFBStatementStatistics *st = 0)
+        : stats(stats.enabled ? &stats : 0), phase(phase), st(st)
+    {
+        if (this->stats)
+            watch.start();
+    }
+
+    ~QFBStatisticsTimer()
+    {
+        if (stats)
+            stats->add(phase, watch.usecs(), st);
+    }
+
+private:
+    QFBStatistics *stats;
+    int phase;
+    QFBStatementStatistics *st;
+    QFBStopwatch watch;
+};
+//-----------------------------------------------------------------------//
+// Adds the time of its scope to *total, if total is set
+class QFBScopeTimer
+{
+public:
+    explicit QFBScopeTimer(qint64 *total)
+        : total(total)
+    {
+        if (total)
+            watch.start();
+    }
+
+    ~QFBScopeTimer()
+    {
+        if (total)
+            *total += watch.usecs();
+    }
+
+private:
+    qint64 *total;
+    QFBStopwatch watch;
+};
+//-----------------------------------------------------------------------//
+class QFBAsyncWorker;
+//-----------------------------------------------------------------------//
+class QFBDriverPrivate
+{
+public:
+    QFBDriverPrivate(QFBDriver *dd)
+        : d(dd)
+        , textCodec(0)
+        , stringDecoding(CodecStrings)
+        , lazyBlobs(false)
+        , poolWaitTime(0)
+        , dbUsers(0)
+        , sharedReads(false)
+        , readRefresh(60)
+        , readCursors(0)
+        , readGeneration(0)
+        , asyncWorker(0)
+        , statementTimeout(0)
+        , cancelHandle(0)
+        , callsInFlight(0)
+        , cancelling(0)
+        , eventTimer(0)
+        , eventInterval(100)
+        , metadataCache(false)
+        , metadataTtl(0)
+        , metadataLoaded(false)
+        , metadataDirty(false)
+        , slowQueryMs(0)
+    {
+        iDb.clear();
+        iTr.clear();
+
+        tam = IBPP::amWrite;
+        til = IBPP::ilConcurrency;
+        tlr = IBPP::lrWait;
+        tff = IBPP::TFF(0);
+    }
+
+    void setError(const std::string &err, IBPP::Exception &e, QSqlError::ErrorType type);
+    void checkTransactionArguments();
+    void startReadTransaction();
+    void readLazyBlobs(IBPP::ITransaction *tr);
+    QByteArray transactionKey(const IBPP::ITransaction *tr) const;
+    QByteArray statementKey(const std::string &sql, const IBPP::ITransaction *tr) const;
+    void updateCancelHandle();
+    void setCallInFlight(bool running);
+    bool cancelOperation();
+    int takeStatementTimeout();
+    bool loadMetadata();
+    void invalidateMetadata();
+    QString schemaVersion();
+    bool readSnapshot(const QString &version);
+    void writeSnapshot(const QString &version);
+    bool takeSpareHandles(const QByteArray &trKey, IBPP::Transaction &tr, IBPP::Statement &st);
+    void putSpareHandles(const QByteArray &trKey, const IBPP::Transaction &tr, const IBPP::Statement &st);
+
+public:
+    IBPP::Database iDb;
+    IBPP::Transaction iTr;
+    QList<IBPP::Transaction> iL;
+
+    QFBStatementCache stmtCache;
+    QList<QFBSpareHandles> spareHandles;
+
+    IBPP::TAM tam;
+    IBPP::TIL til;
+    IBPP::TLR tlr;
+    IBPP::TFF tff;
+
+    QFBDriver *d;
+    QTextCodec *textCodec;
+    int stringDecoding;
+    bool lazyBlobs;
+    QList<QFBResultPrivate*> lazyResults;   // results holding unread BLOB ids
+
+    QByteArray poolKey;     // empty unless iDb is leased from the pool
+    int poolWaitTime;
+    int dbUsers;            // results holding a reference to iDb
+
+    // READ_TRANSACTION=SHARED, autocommit selects run in readTr
+    bool sharedReads;
+    int readRefresh;        // seconds, 0 never
+    IBPP::Transaction readTr;
+    QDateTime readStarted;
+    int readCursors;        // results with an open cursor in readTr
+    int readGeneration;     // starts of readTr
+
+    QFBOpenParams openParams;
+    QFBAsyncWorker *asyncWorker;
+
+    int statementTimeout;   // milliseconds, 0 none
+
+    // copy of the attachment handle for cancel() from any thread
+    QMutex cancelMutex;
+    isc_db_handle cancelHandle;
+    QAtomicInt callsInFlight;   // blocking IBPP calls cancel() may interrupt
+    QAtomicInt cancelling;      // cancelOperation() holds cancelMutex
+
+    IBPP::Events iEv;
+    QMap<QByteArray, QString> eventNames;   // as sent to the server
+    QFBEventHandler eventHandler;
+    int eventTimer;
+    int eventInterval;      // milliseconds between dispatches
+
+    // METADATA_CACHE=ON, relations by name in catalog order
+    bool metadataCache;
+    int metadataTtl;        // seconds, 0 until invalidated
+    bool metadataLoaded;
+    bool metadataDirty;     // DDL in a transaction not yet ended
+    QDateTime metadataLoadedAt;
+    QStringList relationNames;
+    QHash<QString, QFBRelationInfo> relations;
+
+    // SCHEMA_SNAPSHOT file of the metadata cache, valid for snapshotKey
+    QString snapshotPath;
+    QString snapshotKey;
+
+    QFBStatistics stats;
+
+    int slowQueryMs;        // SLOW_QUERY_MS, 0 off
+    QString slowQueryLog;   // empty: qWarning()
+};
+//-----------------------------------------------------------------------//
+void QFBDriverPrivate::setError(const std::string &err, IBPP::Exception &e, QSqlError::ErrorType type)
+{
+//	qWarning(err.data());
+    d->setLastError(QSqlError(QString::fromLatin1(err.data()),
+                              QString::fromLatin1(e.ErrorMessage()), type));
+}
+//-----------------------------------------------------------------------//
+// An open cursor keeps the shared read transaction from its refresh for at
+// most this many times readRefresh
+static const int readRefreshLimit = 10;
+//-----------------------------------------------------------------------//
+// Starts the shared read only transaction, or commits and restarts it once
+// it is older than readRefresh and no result has a cursor open in it, so it
+// does not hold back garbage collection for good. A query left unfinished
+// on a row in the middle would hold it forever, so past readRefreshLimit
+// the open cursors are given up.
+void QFBDriverPrivate::startReadTransaction()
+{
+    if (readTr == 0)
+        readTr = IBPP::TransactionFactory(iDb, IBPP::amRead, IBPP::ilReadCommitted);
+
+    const QDateTime now = QDateTime::currentDateTime();
+    if (readTr->Started())
+    {
+        const int age = readStarted.secsTo(now);
+        if (readRefresh <= 0 || age < readRefresh)
+            return;
+        if (readCursors > 0 && age < readRefresh * readRefreshLimit)
+            return;
+        readLazyBlobs(readTr.intf());
+        QFBStatisticsTimer timer(stats, CommitPhase);
+        readTr->Commit();
+    }
+
+    QFBStatisticsTimer timer(stats, StartPhase);
+    readTr->Start();
+    readStarted = now;
+    readCursors = 0;
+    ++readGeneration;
+}
+//-----------------------------------------------------------------------//
+void QFBDriverPrivate::checkTransactionArguments()
+{
+    if (!d->property("Transaction").isValid())
+    {
+        tam = IBPP::amWrite;
+        til = IBPP::ilConcurrency;
+        tlr = IBPP::lrWait;
+        tff = IBPP::TFF(0);
+        return;
+    }
+
+    QString args = d->property("Transaction").toString();
+    const QStringList opts(args.split(QLatin1Char(','), QString::SkipEmptyParts));
+    for (int i = 0; i < opts.count(); ++i)
+    {
+        const QString tmp(opts.at(i));
+        int idx;
+        if ((idx = tmp.indexOf(QLatin1Char('='))) == -1)
+        {
+            qWarning("QFBDriver::checkTransactionArguments: Illegal option value '%s'",
+                     tmp.toLocal8Bit().constData());
+            continue;
+        }
+
+        const QString opt(tmp.left(idx).simplified());
+        const QString val(tmp.mid(idx + 1).simplified());
+
+        if (opt == QLatin1String("TAM"))
+        {
+            if (val == QLatin1String("amWrite"))
+                tam = IBPP::amWrite;
+            else
+                if (val == QLatin1String("amRead"))
+                    tam = IBPP::amRead;
+                else
+                    qWarning("QFBDriver::checkTransactionArguments: Unknown IBPP::TAM value '%s'",
+                             tmp.toLocal8Bit().constData());
+            continue;
+        }
+        else
+            if (opt == QLatin1String("TIL"))
+            {
+                if (val == QLatin1String("ilConcurrency"))
+                    til = IBPP::ilConcurrency;
+                else
+                    if (val == QLatin1String("ilReadDirty"))
+                        til = IBPP::ilReadDirty;
+                    else
+                        if (val == QLatin1String("ilReadCommitted"))
+                            til = IBPP::ilReadCommitted;
+                        else
+                            if (val == QLatin1String("ilConsistency"))
+                                til = IBPP::ilConsistency;
+                            else
+                                qWarning("QFBDriver::checkTransactionArguments: Unknown IBPP::TIL value '%s'",
+                                         tmp.toLocal8Bit().constData());
+                continue;
+            }
+            else
+                if (opt == QLatin1String("TLR"))
+                {
+                    if (val == QLatin1String("lrWait"))
+                        tlr = IBPP::lrWait;
+                    else
+                        if (val == QLatin1String("lrNoWait"))
+                            tlr = IBPP::lrNoWait;
+                        else
+                            qWarning("QFBDriver::checkTransactionArguments: Unknown IBPP::TLR value '%s'",
+                                     tmp.toLocal8Bit().constData());
+                    continue;
+                }
+                else
+                    if (opt == QLatin1String("TFF"))
+                    {
+                        if (val == QLatin1String("0"))
+                            tff = IBPP::TFF(0);
+                        else
+                            if (val == QLatin1String("tfIgnoreLimbo"))
+                                tff = IBPP::tfIgnoreLimbo;
+                            else
+                                if (val == QLatin1String("tfAutoCommit"))
+                                    tff = IBPP::tfAutoCommit;
+                                else
+                                    if (val == QLatin1String("tfNoAutoUndo"))
+                                        tff = IBPP::tfNoAutoUndo;
+                                    else
+                                        qWarning("QFBDriver::checkTransactionArguments: Unknown IBPP::TLR value '%s'",
+                                                 tmp.toLocal8Bit().constData());
+                        continue;
+                    }
+                    else
+                        qWarning("QFBDriver::checkTransactionArguments: Unknown transaction attribute '%s'",
+                                 tmp.toLocal8Bit().constData());
+    }
+//    qWarning("IBPP::Transaction arguments(TAM=%d, TIL=%d, TLR=%d, TFF=%d)", tam, til, tlr, tff);
+    d->setProperty("Transaction",QVariant());
+
+}
+//-----------------------------------------------------------------------//
+// Statements prepared in a local transaction keep that transaction, so they
+// are keyed by the transaction arguments; statements prepared in a driver
+// transaction are keyed by that transaction.
+QByteArray QFBDriverPrivate::transactionKey(const IBPP::ITransaction *tr) const
+{
+    if (tr)
+        return QByteArray::number(quintptr(tr));
+
+    return 'L' + QByteArray::number(tam) + ',' + QByteArray::number(til) +
+           ',' + QByteArray::number(tlr) + ',' + QByteArray::number(int(tff));
+}
+//-----------------------------------------------------------------------//
+QByteArray QFBDriverPrivate::statementKey(const std::string &sql, const IBPP::ITransaction *tr) const
+{
+    QByteArray key(sql.data(), int(sql.size()));
+    key += '\0';
+    key += transactionKey(tr);
+    return key;
+}
+//-----------------------------------------------------------------------//
+void QFBDriverPrivate::updateCancelHandle()
+{
+    QMutexLocker locker(&cancelMutex);
+    if (iDb != 0)
+        cancelHandle = static_cast<ibpp_internals::DatabaseImpl *>(iDb.intf())->GetHandle();
+    else
+        cancelHandle = 0;
+}
+//-----------------------------------------------------------------------//
+// Runs around every fetched row, so it takes no lock. Both sides change
+// their own counter before they read the other one: either cancelOperation()
+// sees the call has ended, or the call sees the cancel and waits on
+// cancelMutex until it has been sent.
+void QFBDriverPrivate::setCallInFlight(bool running)
+{
+    if (running)
+    {
+        callsInFlight.ref();
+        return;
+    }
+
+    callsInFlight.deref();
+    if (cancelling)
+    {
+        // a cancel of this call is on its way, it must not hit the next one
+        QMutexLocker locker(&cancelMutex);
+    }
+}
+//-----------------------------------------------------------------------//
+// Asks the server to cancel the request running on the attachment, the
+// blocked IBPP call then fails with isc_cancelled. Needs a Firebird 2.5
+// client library. Between calls there is nothing to cancel, and a cancel
+// sent then would hit whatever the connection runs next.
+bool QFBDriverPrivate::cancelOperation()
+{
+#ifdef fb_cancel_raise
+    QMutexLocker locker(&cancelMutex);
+    cancelling.fetchAndStoreOrdered(1);
+    bool sent = false;
+    if (cancelHandle && callsInFlight > 0)
+    {
+        ISC_STATUS_ARRAY status;
+        fb_cancel_operation(status, &cancelHandle, fb_cancel_raise);
+        sent = !(status[0] == 1 && status[1] != 0);
+    }
+    cancelling.fetchAndStoreOrdered(0);
+    return sent;
+#else
+    return false;
+#endif
+}
+//-----------------------------------------------------------------------//
+// The "StatementTimeout" property applies to the next statement only
+int QFBDriverPrivate::takeStatementTimeout()
+{
+    const QVariant v = d->property("StatementTimeout");
+    if (!v.isValid())
+        return statementTimeout;
+
+    d->setProperty("StatementTimeout", QVariant());
+    bool ok;
+    const int ms = v.toInt(&ok);
+    if (!ok || ms < 0)
+    {
+        qWarning("QFBDriver: Illegal StatementTimeout value '%s'",
+                 v.toString().toLocal8Bit().constData());
+        return statementTimeout;
+    }
+    return ms;
+}
+//-----------------------------------------------------------------------//
+// Columns: field name, type, length, scale, precision, null flag
+static QSqlField qRelationField(const QSqlQuery &q, int first)
+{
+    int type = q.value(first + 1).toInt();
+    QSqlField f(q.value(first).toString().simplified(), qIBaseTypeName(type));
+    f.setLength(q.value(first + 2).toInt()); // bytes, not characters
+    f.setPrecision(qAbs(q.value(first + 3).toInt()));
+    f.setRequired(q.value(first + 5).toInt() > 0 ? true : false);
+    f.setSqlType(type);
+    return f;
+}
+//-----------------------------------------------------------------------//
+// Reads all relations, their fields and primary keys with three catalog
+// queries. Returns the cache if it is loaded and not older than the TTL.
+bool QFBDriverPrivate::loadMetadata()
+{
+    if (metadataLoaded &&
+        (metadataTtl <= 0 || metadataLoadedAt.secsTo(QDateTime::currentDateTime()) < metadataTtl))
+        return true;
+
+    invalidateMetadata();
+
+    // the version is taken before the catalog is read, a concurrent change
+    // makes the snapshot look stale rather than current
+    QString version;
+    if (!snapshotPath.isEmpty())
+    {
+        version = schemaVersion();
+        if (!version.isEmpty() && readSnapshot(version))
+        {
+            metadataLoaded = true;
+            metadataLoadedAt = QDateTime::currentDateTime();
+            return true;
+        }
+    }
+
+    QSqlQuery q(d->createResult());
+    q.setForwardOnly(true);
+    if (!q.exec(QLatin1String("SELECT RDB$RELATION_NAME, RDB$SYSTEM_FLAG, "
+                              "CASE WHEN RDB$VIEW_BLR IS NULL THEN 0 ELSE 1 END "
+                              "FROM RDB$RELATIONS")))
+        return false;
+    while (q.next())
+    {
+        QFBRelationInfo info;
+        info.name = q.value(0).toString().simplified();
+        info.system = q.value(1).toInt() != 0;
+        info.view = q.value(2).toInt() != 0;
+        info.primaryIndex = QSqlIndex(info.name);
+        relationNames.append(info.name);
+        relations.insert(info.name, info);
+    }
+
+    if (!q.exec(QLatin1String("SELECT a.RDB$RELATION_NAME, a.RDB$FIELD_NAME, b.RDB$FIELD_TYPE, "
+                              "b.RDB$FIELD_LENGTH, b.RDB$FIELD_SCALE, b.RDB$FIELD_PRECISION, a.RDB$NULL_FLAG "
+                              "FROM RDB$RELATION_FIELDS a, RDB$FIELDS b "
+                              "WHERE b.RDB$FIELD_NAME = a.RDB$FIELD_SOURCE "
+                              "ORDER BY a.RDB$RELATION_NAME, a.RDB$FIELD_POSITION")))
+    {
+        invalidateMetadata();
+        return false;
+    }
+    while (q.next())
+    {
+        QHash<QString, QFBRelationInfo>::iterator it = relations.find(q.value(0).toString().simplified());
+        if (it != relations.end())
+            it.value().record.append(qRelationField(q, 1));
+    }
+
+    if (!q.exec(QLatin1String("SELECT a.RDB$RELATION_NAME, a.RDB$INDEX_NAME, b.RDB$FIELD_NAME, d.RDB$FIELD_TYPE, "
+                              "e.RDB$INDEX_TYPE "
+                              "FROM RDB$RELATION_CONSTRAINTS a, RDB$INDEX_SEGMENTS b, RDB$RELATION_FIELDS c, RDB$FIELDS d, "
+                              "RDB$INDICES e "
+                              "WHERE a.RDB$CONSTRAINT_TYPE = 'PRIMARY KEY' "
+                              "AND a.RDB$INDEX_NAME = b.RDB$INDEX_NAME "
+                              "AND e.RDB$INDEX_NAME = a.RDB$INDEX_NAME "
+                              "AND c.RDB$RELATION_NAME = a.RDB$RELATION_NAME "
+                              "AND c.RDB$FIELD_NAME = b.RDB$FIELD_NAME "
+                              "AND d.RDB$FIELD_NAME = c.RDB$FIELD_SOURCE "
+                              "ORDER BY a.RDB$RELATION_NAME, b.RDB$FIELD_POSITION")))
+    {
+        invalidateMetadata();
+        return false;
+    }
+    while (q.next())
+    {
+        QHash<QString, QFBRelationInfo>::iterator it = relations.find(q.value(0).toString().simplified());
+        if (it == relations.end())
+            continue;
+        QSqlField field(q.value(2).toString().simplified(), qIBaseTypeName(q.value(3).toInt()));
+        it.value().primaryIndex.append(field, q.value(4).toInt() == 1);  // RDB$INDEX_TYPE 1: descending
+        it.value().primaryIndex.setName(q.value(1).toString());
+    }
+
+    metadataLoaded = true;
+    metadataLoadedAt = QDateTime::currentDateTime();
+    if (!version.isEmpty())
+        writeSnapshot(version);
+    return true;
+}
+//-----------------------------------------------------------------------//
+// One row probe of the catalog. Counts and maxima catch created and
+// dropped tables, views, columns and constraints; DDL that keeps them, a
+// column renamed, a domain made NOT NULL or a primary key moved to other
+// columns, changes one of the checksums over the fields the metadata cache
+// holds. HASH() and LIST() need Firebird 2.1.
+QString QFBDriverPrivate::schemaVersion()
+{
+    QSqlQuery q(d->createResult());
+    q.setForwardOnly(true);
+    if (!q.exec(QLatin1String("SELECT (SELECT COUNT(*) FROM RDB$RELATIONS), "
+                              "(SELECT MAX(RDB$RELATION_ID) FROM RDB$RELATIONS), "
+                              "(SELECT COUNT(*) FROM RDB$RELATION_FIELDS), "
+                              "(SELECT COUNT(*) FROM RDB$RELATION_CONSTRAINTS), "
+                              "(SELECT COUNT(*) FROM RDB$FORMATS), "
+                              "(SELECT MAX(RDB$FORMAT) FROM RDB$FORMATS), "
+                              "(SELECT HASH(LIST(f.F, ',')) FROM "
+                              "(SELECT TRIM(a.RDB$RELATION_NAME) || '.' || TRIM(a.RDB$FIELD_NAME) || ':' || "
+                              "TRIM(a.RDB$FIELD_SOURCE) || ':' || a.RDB$FIELD_POSITION || ':' || "
+                              "COALESCE(a.RDB$NULL_FLAG, 0) || ':' || COALESCE(b.RDB$NULL_FLAG, 0) || ':' || "
+                              "b.RDB$FIELD_TYPE || ':' || COALESCE(b.RDB$FIELD_LENGTH, 0) || ':' || "
+                              "COALESCE(b.RDB$FIELD_SCALE, 0) || ':' || COALESCE(b.RDB$FIELD_PRECISION, 0) AS F "
+                              "FROM RDB$RELATION_FIELDS a, RDB$FIELDS b "
+                              "WHERE b.RDB$FIELD_NAME = a.RDB$FIELD_SOURCE "
+                              "ORDER BY a.RDB$RELATION_NAME, a.RDB$FIELD_NAME) f), "
+                              "(SELECT HASH(LIST(k.F, ',')) FROM "
+                              "(SELECT TRIM(a.RDB$RELATION_NAME) || '.' || TRIM(a.RDB$INDEX_NAME) || ':' || "
+                              "TRIM(b.RDB$FIELD_NAME) || ':' || b.RDB$FIELD_POSITION AS F "
+                              "FROM RDB$RELATION_CONSTRAINTS a, RDB$INDEX_SEGMENTS b "
+                              "WHERE a.RDB$CONSTRAINT_TYPE = 'PRIMARY KEY' "
+                              "AND b.RDB$INDEX_NAME = a.RDB$INDEX_NAME "
+                              "ORDER BY a.RDB$RELATION_NAME, b.RDB$FIELD_POSITION) k) "
+                              "FROM RDB$DATABASE")) || !q.next())
+        return QString();
+
+    QStringList values;
+    for (int i = 0; i < 8; ++i)
+        values << q.value(i).toString();
+    return values.join(QLatin1String(","));
+}
+//-----------------------------------------------------------------------//
+static const quint32 snapshotMagic = 0x51464253;    // "QFBS"
+static const qint32 snapshotFormat = 2;
+//-----------------------------------------------------------------------//
+static void qWriteField(QDataStream &out, const QSqlField &f)
+{
+    out << f.name() << qint32(f.type()) << qint32(f.length()) << qint32(f.precision())
+        << qint32(f.requiredStatus()) << qint32(f.typeID());
+}
+//-----------------------------------------------------------------------//
+static QSqlField qReadField(QDataStream &in)
+{
+    QString name;
+    qint32 type, length, precision, required, sqlType;
+    in >> name >> type >> length >> precision >> required >> sqlType;
+
+    QSqlField f(name, QVariant::Type(type));
+    f.setLength(length);
+    f.setPrecision(precision);
+    f.setRequiredStatus(QSqlField::RequiredStatus(required));
+    f.setSqlType(sqlType);
+    return f;
+}
+//-----------------------------------------------------------------------//
+// Fills the metadata cache from the snapshot file if it was written for
+// this database and schema version
+bool QFBDriverPrivate::readSnapshot(const QString &version)
+{
+    QFile file(snapshotPath);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_4_5);
+
+    quint32 magic;
+    qint32 format;
+    in >> magic >> format;
+    if (in.status() != QDataStream::Ok || magic != snapshotMagic || format != snapshotFormat)
+        return false;
+
+    QString key, fileVersion;
+    qint32 count;
+    in >> key >> fileVersion >> count;
+    if (in.status() != QDataStream::Ok || key != snapshotKey || fileVersion != version)
+        return false;
+
+    for (qint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i)
+    {
+        QFBRelationInfo info;
+        qint32 fields, segments;
+        QString indexName;
+        in >> info.name >> info.system >> info.view >> fields;
+        for (qint32 j = 0; j < fields && in.status() == QDataStream::Ok; ++j)
+            info.record.append(qReadField(in));
+
+        in >> indexName >> segments;
+        info.primaryIndex = QSqlIndex(info.name, indexName);
+        for (qint32 j = 0; j < segments && in.status() == QDataStream::Ok; ++j)
+        {
+            const QSqlField field = qReadField(in);
+            bool descending = false;
+            in >> descending;
+            info.primaryIndex.append(field, descending);
+        }
+
+        relationNames.append(info.name);
+        relations.insert(info.name, info);
+    }
+
+    if (in.status() != QDataStream::Ok)
+    {
+        qWarning("QFBDriver: Corrupt schema snapshot '%s'", snapshotPath.toLocal8Bit().constData());
+        invalidateMetadata();
+        return false;
+    }
+    return true;
+}
+//-----------------------------------------------------------------------//
+// Replaces the snapshot file, through a temporary file so that a reader
+// never sees it half written
+void QFBDriverPrivate::writeSnapshot(const QString &version)
+{
+    const QString tmpPath = snapshotPath + QLatin1String(".tmp");
+    QFile file(tmpPath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        qWarning("QFBDriver: Unable to write schema snapshot '%s'", tmpPath.toLocal8Bit().constData());
+        return;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_4_5);
+    out << snapshotMagic << snapshotFormat << snapshotKey << version << qint32(relationNames.count());
+
+    for (int i = 0; i < relationNames.count(); ++i)
+    {
+        const QFBRelationInfo &info = relations[relationNames.at(i)];
+        out << info.name << info.system << info.view << qint32(info.record.count());
+        for (int j = 0; j < info.record.count(); ++j)
+            qWriteField(out, info.record.field(j));
+
+        out << info.primaryIndex.name() << qint32(info.primaryIndex.count());
+        for (int j = 0; j < info.primaryIndex.count(); ++j)
+        {
+            qWriteField(out, info.primaryIndex.field(j));
+            out << info.primaryIndex.isDescending(j);
+        }
+    }
+
+    file.close();
+    QFile::remove(snapshotPath);
+    if (!QFile::rename(tmpPath, snapshotPath))
+    {
+        qWarning("QFBDriver: Unable to write schema snapshot '%s'", snapshotPath.toLocal8Bit().constData());
+        QFile::remove(tmpPath);
+    }
+}
+//-----------------------------------------------------------------------//
+void QFBDriverPrivate::invalidateMetadata()
+{
+    metadataLoaded = false;
+    relationNames.clear();
+    relations.clear();
+}
+//-----------------------------------------------------------------------//
+// Thread cancelling the statements which run past their deadline, shared
+// by all connections and started with the first statement timeout.
+class QFBWatchdog : public QThread
+{
+public:
+    QFBWatchdog() : stopping(false), lastId(0) {}
+    ~QFBWatchdog();
+
+    int arm(QFBDriverPrivate *dp, qint64 deadline, bool *expired);
+    void disarm(int id);
+
+protected:
+    void run();
+
+private:
+    struct Entry
+    {
+        QFBDriverPrivate *dp;
+        qint64 deadline;
+        bool *expired;
+    };
+
+    QMutex mutex;
+    QWaitCondition changed;
+    QHash<int, Entry> entries;
+    bool stopping;
+    int lastId;
+};
+//-----------------------------------------------------------------------//
+Q_GLOBAL_STATIC(QFBWatchdog, watchdog)
+//-----------------------------------------------------------------------//
+QFBWatchdog::~QFBWatchdog()
+{
+    {
+        QMutexLocker locker(&mutex);
+        stopping = true;
+        changed.wakeAll();
+    }
+    wait();
+}
+//-----------------------------------------------------------------------//
+int QFBWatchdog::arm(QFBDriverPrivate *dp, qint64 deadline, bool *expired)
+{
+    QMutexLocker locker(&mutex);
+    if (!isRunning())
+        start();
+
+    Entry entry;
+    entry.dp = dp;
+    entry.deadline = deadline;
+    entry.expired = expired;
+
+    if (++lastId <= 0)
+        lastId = 1;
+    entries.insert(lastId, entry);
+    changed.wakeAll();
+    return lastId;
+}
+//-----------------------------------------------------------------------//
+// Once disarm() returned, the entry's statement is not cancelled any more
+void QFBWatchdog::disarm(int id)
+{
+    QMutexLocker locker(&mutex);
+    entries.remove(id);
+}
+//-----------------------------------------------------------------------//
+void QFBWatchdog::run()
+{
+    QMutexLocker locker(&mutex);
+    while (!stopping)
+    {
+        const qint64 now = qCurrentMSecs();
+        qint64 next = -1;
+
+        QHash<int, Entry>::iterator it = entries.begin();
+        while (it != entries.end())
+        {
+            if (it.value().deadline <= now)
+            {
+                *it.value().expired = true;
+                it.value().dp->cancelOperation();
+                it = entries.erase(it);
+                continue;
+            }
+            if (next < 0 || it.value().deadline < next)
+                next = it.value().deadline;
+            ++it;
+        }
+
+        if (next < 0)
+            changed.wait(&mutex);
+        else
+            changed.wait(&mutex, ulong(next - now));
+    }
+}
+//-----------------------------------------------------------------------//
+// Thread appending the slow query entries of all connections to their log
+// files, so a statement never waits for the disk
+class QFBLogWriter : public QThread
+{
+public:
+    QFBLogWriter() : stopping(false), dropped(0) {}
+    ~QFBLogWriter();
+
+    void write(const QString &path, const QByteArray &text);
+
+protected:
+    void run();
+
+private:
+    struct Entry
+    {
+        QString path;
+        QByteArray text;
+    };
+
+    QMutex mutex;
+    QWaitCondition queued;
+    QList<Entry> queue;
+    bool stopping;
+    int dropped;
+};
+//-----------------------------------------------------------------------//
+Q_GLOBAL_STATIC(QFBLogWriter, logWriter)
+//-----------------------------------------------------------------------//
+static const int maxQueuedLogEntries = 1024;
+//-----------------------------------------------------------------------//
+// Writes what is still queued
+QFBLogWriter::~QFBLogWriter()
+{
+    {
+        QMutexLocker locker(&mutex);
+        stopping = true;
+        queued.wakeAll();
+    }
+    wait();
+}
+//-----------------------------------------------------------------------//
+void QFBLogWriter::write(const QString &path, const QByteArray &text)
+{
+    QMutexLocker locker(&mutex);
+    if (!isRunning())
+        start(QThread::LowPriority);
+
+    if (queue.count() >= maxQueuedLogEntries)
+    {
+        ++dropped;
+        return;
+    }
+
+    Entry entry;
+    entry.path = path;
+    entry.text = text;
+    queue.append(entry);
+    queued.wakeOne();
+}
+//-----------------------------------------------------------------------//
+void QFBLogWriter::run()
+{
+    QMutexLocker locker(&mutex);
+    forever
+    {
+        while (queue.isEmpty() && !stopping)
+            queued.wait(&mutex);
+        if (queue.isEmpty())
+            break;
+
+        const QList<Entry> entries = queue;
+        queue.clear();
+        const int lost = dropped;
+        dropped = 0;
+
+        locker.unlock();
+        for (int i = 0; i < entries.count(); ++i)
+        {
+            QFile file(entries.at(i).path);
+            if (!file.open(QIODevice::WriteOnly | QIODevice::Append))
+            {
+                qWarning("QFBDriver: Unable to open slow query log '%s'",
+                         entries.at(i).path.toLocal8Bit().constData());
+                continue;
+            }
+            if (lost && i == 0)
+                file.write("-- " + QByteArray::number(lost) + " slow query entries dropped\n\n");
+            file.write(entries.at(i).text);
+        }
+        locker.relock();
+    }
+}
+//-----------------------------------------------------------------------//
+static const int maxSpareHandles = 16;
+//-----------------------------------------------------------------------//
+bool QFBDriverPrivate::takeSpareHandles(const QByteArray &trKey, IBPP::Transaction &tr, IBPP::Statement &st)
+{
+    for (int i = spareHandles.count() - 1; i >= 0; --i)
+    {
+        if (spareHandles.at(i).trKey == trKey)
+        {
+            const QFBSpareHandles spare = spareHandles.takeAt(i);
+            tr = spare.iTr;
+            st = spare.iSt;
+            return true;
+        }
+    }
+    return false;
+}
+//-----------------------------------------------------------------------//
+void QFBDriverPrivate::putSpareHandles(const QByteArray &trKey, const IBPP::Transaction &tr, const IBPP::Statement &st)
+{
+    if (spareHandles.count() >= maxSpareHandles)
+        spareHandles.removeFirst();
+
+    QFBSpareHandles spare;
+    spare.trKey = trKey;
+    spare.iTr = tr;
+    spare.iSt = st;
+    spareHandles.append(spare);
+}
+//-----------------------------------------------------------------------//
+class QFBResultPrivate
+{
+public:
+    QFBResultPrivate(QFBResult *rr, const QFBDriver *dd, QTextCodec *tc);
+    ~QFBResultPrivate()
+    {
+        cleanup();
+        if (iDb != 0 && iDb.intf() == d->dp->iDb.intf())
+            --d->dp->dbUsers;
+    }
+
+    void cleanup();
+
+    bool prepare(const std::string &query, bool allowSharedRead = true);
+    void release();
+    void openReadCursor();
+    void closeReadCursor();
+    bool checkReadCursor();
+    void holdLazyBlobs();
+    void readLazyBlobs();
+    void dropLazyBlobs();
+    void describeColumns();
+    void describeParameters();
+    QFBArraySlot &arraySlot(int key, const std::string &table, const std::string &column);
+    QVariant fetchArray(int i, const QFBColumn &col);
+    bool writeArray(int i, const QVariant &val);
+    int fetchBlock(QFBRowBlock &block, int maxRows);
+    bool bind(const QVector<QVariant> &values);
+    bool transaction();
+    bool commit();
+    bool rollback();
+
+    bool isSelect();
+
+    void startTimeout();
+    int armTimeout();
+    void disarmTimeout(int id);
+    void schemaChanging();
+    void schemaChanged();
+    void startSlowQuery(const QVector<QVariant> &values);
+    void finishSlowQuery();
+
+    void setError(const std::string &err, IBPP::Exception &e, QSqlError::ErrorType type);
+
+public:
+    QFBResult *r;
+    const QFBDriver *d;
+
+    qint64 deadline;    // of the running statement, 0 none
+    bool timedOut;
+
+    bool localTransaction;
+    bool sharedRead;    // runs in the driver's shared read transaction
+    bool readCursor;
+    int readGeneration; // of the shared read transaction the cursor is in
+
+    int queryType;
+    int batchRowsAffected;
+
+    IBPP::Database iDb;
+    IBPP::Transaction iTr;
+    IBPP::Statement iSt;
+
+    std::string sql;
+    QByteArray trKey;
+    QByteArray cacheKey;
+    QFBStatementPlan plan;
+    QByteArray strBuf;
+    QByteArray arrayBuf;
+    QHash<int, QFBArraySlot> arrays;    // column i, parameter -i
+
+    QTextCodec *textCodec;
+    int stringDecoding;
+    bool lazyBlobs;
+    bool unreadBlobs;   // the cache may hold BLOB ids, listed in lazyResults
+    QFBStatistics *stats;
+
+    // driver time of the running statement in microseconds, SLOW_QUERY_MS
+    int slowQueryMs;
+    bool slowTiming;
+    qint64 slowPrepare;
+    qint64 slowExecute;
+    qint64 slowFetch;
+    int slowRows;
+    QVector<QVariant> slowValues;
+};
+//-----------------------------------------------------------------------//
+QFBResultPrivate::QFBResultPrivate(QFBResult *rr, const QFBDriver *dd, QTextCodec *tc):
+        r(rr), d(dd), queryType(-1), batchRowsAffected(-1), textCodec(tc)
+{
+    localTransaction = true;
+    deadline = 0;
+    timedOut = false;
+    sharedRead = false;
+    readCursor = false;
+    readGeneration = 0;
+    iDb = dd->dp->iDb;
+    if (iDb != 0)
+        ++dd->dp->dbUsers;
+    stringDecoding = dd->dp->stringDecoding;
+    lazyBlobs = dd->dp->lazyBlobs;
+    unreadBlobs = false;
+    stats = &dd->dp->stats;
+    slowQueryMs = dd->dp->slowQueryMs;
+    slowTiming = false;
+    slowPrepare = slowExecute = slowFetch = 0;
+    slowRows = 0;
+
+    // transaction and statement objects are created or recycled in prepare()
+}
+//-----------------------------------------------------------------------//
+// Arms the statement timeout for the duration of one blocking IBPP call,
+// which cancel() may interrupt meanwhile
+class QFBTimeoutGuard
+{
+public:
+    explicit QFBTimeoutGuard(QFBResultPrivate *result)
+        : rp(result), id(result->armTimeout())
+    {
+    }
+
+    ~QFBTimeoutGuard()
+    {
+        rp->disarmTimeout(id);
+    }
+
+private:
+    QFBResultPrivate *rp;
+    int id;
+};
+//-----------------------------------------------------------------------//
+// Starts the clock of the statement timeout, which covers execution and
+// fetching of the result
+void QFBResultPrivate::startTimeout()
+{
+    const int timeout = d->dp->takeStatementTimeout();
+    deadline = timeout > 0 ? qCurrentMSecs() + timeout : 0;
+    timedOut = false;
+}
+//-----------------------------------------------------------------------//
+int QFBResultPrivate::armTimeout()
+{
+    d->dp->setCallInFlight(true);
+    if (deadline <= 0)
+        return 0;
+    return watchdog()->arm(d->dp, deadline, &timedOut);
+}
+//-----------------------------------------------------------------------//
+// The watchdog drops the entry before the call is marked as finished, so
+// it never cancels past the end of the call
+void QFBResultPrivate::disarmTimeout(int id)
+{
+    if (id)
+        watchdog()->disarm(id);
+    d->dp->setCallInFlight(false);
+}
+//-----------------------------------------------------------------------//
+// Called before a DDL statement runs. A prepared request keeps the relations
+// it uses in use, so the statements kept for reuse are freed first, or DROP
+// and ALTER of a table they refer to fail with "object in use".
+void QFBResultPrivate::schemaChanging()
+{
+    d->dp->stmtCache.clear();
+    d->dp->spareHandles.clear();
+}
+//-----------------------------------------------------------------------//
+// Called after a DDL statement. In the driver's transaction the catalog is
+// dropped once more at commit or rollback.
+void QFBResultPrivate::schemaChanged()
+{
+    d->dp->invalidateMetadata();
+    if (!localTransaction)
+        d->dp->metadataDirty = true;
+}
+//-----------------------------------------------------------------------//
+void QFBResultPrivate::startSlowQuery(const QVector<QVariant> &values)
+{
+    finishSlowQuery();
+    if (!slowQueryMs)
+        return;
+
+    slowTiming = true;
+    slowExecute = slowFetch = 0;
+    slowRows = 0;
+    slowValues = values;
+}
+//-----------------------------------------------------------------------//
+static QIODevice *qBlobDevice(const QVariant &val);
+
+static QString qParameterSummary(const QVector<QVariant> &values)
+{
+    QStringList params;
+    for (int i = 0; i < values.count(); ++i)
+    {
+        const QVariant &val = values.at(i);
+        QString s;
+        if (val.isNull())
+            s = QLatin1String("NULL");
+        else if (qBlobDevice(val))
+            s = QLatin1String("<device>");
+        else if (val.type() == QVariant::ByteArray)
+            s = QString::fromLatin1("<%1 bytes>").arg(val.toByteArray().size());
+        else if (val.type() == QVariant::List)
+            s = QString::fromLatin1("<list of %1>").arg(val.toList().count());
+        else if (val.type() == QVariant::String)
+        {
+            s = val.toString();
+            if (s.length() > 64)
+                s = s.left(64) + QLatin1String("...");
+            s = QLatin1Char('\'') + s + QLatin1Char('\'');
+        }
+        else
+            s = val.toString();
+        params << QString::number(i + 1) + QLatin1String(": ") + s;
+    }
+    return params.join(QLatin1String(", "));
+}
+//-----------------------------------------------------------------------//
+// Ends the timing of an execution, at the end of the result set or when
+// the result is dropped, and logs the statement if it was slow
+void QFBResultPrivate::finishSlowQuery()
+{
+    if (!slowTiming)
+        return;
+    slowTiming = false;
+
+    const qint64 total = slowPrepare + slowExecute + slowFetch;
+    const qint64 prepared = slowPrepare;
+    slowPrepare = 0;    // executing again needs no prepare
+    const QVector<QVariant> values = slowValues;
+    slowValues.clear();
+    if (total < qint64(slowQueryMs) * 1000)
+        return;
+
+    std::string queryPlan;
+    try
+    {
+        if (iSt.intf() != 0)
+            iSt->Plan(queryPlan);
+    }
+    catch (IBPP::Exception& e)
+    {
+        Q_UNUSED(e);
+        queryPlan.clear();
+    }
+
+    QString text = QDateTime::currentDateTime().toString(QLatin1String("yyyy-MM-dd hh:mm:ss.zzz"));
+    text += QString::fromLatin1(" slow query %1 ms (prepare %2 ms, execute %3 ms, fetch %4 ms, %5 rows)\n")
+            .arg(total / 1000).arg(prepared / 1000).arg(slowExecute / 1000).arg(slowFetch / 1000).arg(slowRows);
+    text += QLatin1String("SQL: ") + fromIBPPStr(sql.data(), int(sql.size()), stringDecoding, textCodec) + QLatin1Char('\n');
+    if (!values.isEmpty())
+        text += QLatin1String("Parameters: ") + qParameterSummary(values) + QLatin1Char('\n');
+    if (!queryPlan.empty())
+        text += QLatin1String("Plan: ") +
+                fromIBPPStr(queryPlan.data(), int(queryPlan.size()), stringDecoding, textCodec) + QLatin1Char('\n');
+
+    if (d->dp->slowQueryLog.isEmpty())
+        qWarning("QFBDriver: %s", text.toLocal8Bit().constData());
+    else
+        logWriter()->write(d->dp->slowQueryLog, text.toUtf8() + '\n');
+}
+//-----------------------------------------------------------------------//
+void QFBResultPrivate::cleanup()
+{
+    commit();
+    closeReadCursor();
+    finishSlowQuery();
+    release();
+
+    queryType = -1;
+
+    dropLazyBlobs();
+    r->cleanup();
+}
+//-----------------------------------------------------------------------//
+bool QFBResultPrivate::prepare(const std::string &query, bool allowSharedRead)
+{
+    QFBDriverPrivate *dp = d->dp;
+
+    sql = query;
+    localTransaction = !(dp->iTr != 0 && dp->iTr->Started());
+    sharedRead = allowSharedRead && localTransaction && dp->sharedReads &&
+                 !d->property("Transaction").isValid() && qLooksLikeSelect(sql);
+    if (sharedRead)
+    {
+        try
+        {
+            dp->startReadTransaction();
+        }
+        catch (IBPP::Exception& e)
+        {
+            setError("Unable start transaction", e, QSqlError::TransactionError);
+            return false;
+        }
+    }
+    else if (localTransaction)
+        dp->checkTransactionArguments();
+
+    const IBPP::ITransaction *keyTr = 0;
+    if (sharedRead)
+        keyTr = dp->readTr.intf();
+    else if (!localTransaction)
+        keyTr = dp->iTr.intf();
+    trKey = dp->transactionKey(keyTr);
+    cacheKey = dp->statementKey(sql, keyTr);
+
+    QFBCachedStatement entry;
+    if (dp->stmtCache.take(cacheKey, entry))
+    {
+        iTr = entry.iTr;
+        iSt = entry.iSt;
+        plan = entry.plan;
+    }
+    else
+    {
+        iTr.clear();
+        iSt.clear();
+        plan = QFBStatementPlan();
+    }
+
+    IBPP::Statement spare;
+    try
+    {
+        if (iTr.intf() == 0 && !(localTransaction && dp->takeSpareHandles(trKey, iTr, spare)))
+        {
+            if (sharedRead)
+                iTr = dp->readTr;
+            else if (localTransaction)
+                iTr = IBPP::TransactionFactory(iDb, dp->tam, dp->til, dp->tlr, dp->tff);
+            else
+                iTr = dp->iTr;
+        }
+        if (!iTr->Started())
+        {
+            QFBStatisticsTimer timer(dp->stats, StartPhase);
+            iTr->Start();
+        }
+    }
+    catch (IBPP::Exception& e)
+    {
+        iSt.clear();
+        cacheKey.clear();
+        setError("Unable start transaction", e, QSqlError::TransactionError);
+        return false;
+    }
+
+    if (iSt.intf() != 0)
+        return true;
+
+    // parsed only here, a cached statement keeps its names in the plan
+    std::string rewritten;
+    const QList<QByteArray> names = qParsePlaceholders(sql, rewritten);
+    for (int i = 0; i < names.count(); ++i)
+        plan.paramNames.append(fromIBPPStr(names.at(i).constData(), names.at(i).size(),
+                                           stringDecoding, textCodec));
+
+    if (dp->stats.enabled)
+    {
+        const QByteArray normalized = qNormalizedSql(sql);
+        plan.stats = dp->stats.statement(fromIBPPStr(normalized.constData(), normalized.size(),
+                                                     stringDecoding, textCodec));
+    }
+
+    try
+    {
+        if (spare.intf() != 0)
+            iSt = spare;
+        else
+            iSt = IBPP::StatementFactory(iDb, iTr);
+        QFBStatisticsTimer timer(dp->stats, PreparePhase, plan.stats);
+        iSt->Prepare(names.isEmpty() ? sql : rewritten);
+        plan.ddl = iSt->Type() == IBPP::stDDL;
+    }
+    catch (IBPP::Exception& e)
+    {
+        cacheKey.clear();
+        setError("Unable prepare statement", e , QSqlError::StatementError);
+        return false;
+    }
+
+    if (sharedRead && !isSelect())
+    {
+        // not a plain select after all, it needs a transaction of its own
+        cacheKey.clear();
+        release();
+        return prepare(query, false);
+    }
+
+    return true;
+}
+//-----------------------------------------------------------------------//
+// Hands the prepared statement back to the driver's cache, or closes it if
+// it cannot be reused. A closed statement of a finished local transaction
+// or of the shared read transaction is kept as a spare with its transaction.
+void QFBResultPrivate::release()
+{
+    if (iSt.intf() == 0)
+        return;
+
+    bool reusable = !cacheKey.isEmpty() && d->dp->stmtCache.maxSize > 0;
+    if (reusable)
+    {
+        if (sharedRead)
+            reusable = d->dp->readTr.intf() == iTr.intf();
+        else if (localTransaction)
+            reusable = !iTr->Started();
+        else
+            reusable = d->dp->iTr.intf() == iTr.intf() && iTr->Started();
+    }
+
+    if (reusable)
+    {
+        QFBCachedStatement entry;
+        entry.key = cacheKey;
+        entry.iTr = iTr;
+        entry.iSt = iSt;
+        entry.plan = plan;
+        d->dp->stmtCache.put(entry);
+    }
+    else
+    {
+        bool closed = true;
+        try
+        {
+            iSt->Close();
+        }
+        catch (IBPP::Exception& e)
+        {
+            closed = false;
+            setError("Unable close statement", e, QSqlError::StatementError);
+        }
+
+        if (closed && localTransaction && iTr.intf() != 0)
+        {
+            if (sharedRead ? d->dp->readTr.intf() == iTr.intf() : !iTr->Started())
+                d->dp->putSpareHandles(trKey, iTr, iSt);
+        }
+    }
+
+    iSt.clear();
+    iTr.clear();
+    trKey.clear();
+    cacheKey.clear();
+    plan = QFBStatementPlan();
+    arrays.clear();
+}
+//-----------------------------------------------------------------------//
+// The shared read transaction is not refreshed while a cursor is open in it
+void QFBResultPrivate::openReadCursor()
+{
+    if (sharedRead && !readCursor)
+    {
+        readCursor = true;
+        readGeneration = d->dp->readGeneration;
+        ++d->dp->readCursors;
+    }
+}
+//-----------------------------------------------------------------------//
+void QFBResultPrivate::closeReadCursor()
+{
+    if (readCursor)
+    {
+        readCursor = false;
+        if (readGeneration == d->dp->readGeneration && d->dp->readCursors > 0)
+            --d->dp->readCursors;
+    }
+}
+//-----------------------------------------------------------------------//
+// Fails a fetch from a cursor whose shared read transaction was restarted
+// past readRefreshLimit
+bool QFBResultPrivate::checkReadCursor()
+{
+    if (!readCursor || readGeneration == d->dp->readGeneration)
+        return true;
+
+    closeReadCursor();
+    r->setLastError(QSqlError(QLatin1String("Could not fetch next item"),
+                              QLatin1String("The shared read transaction was restarted"),
+                              QSqlError::StatementError));
+    return false;
+}
+//-----------------------------------------------------------------------//
+// A BLOB id is only valid in the transaction it was fetched in, so cached
+// rows that may outlive it are listed with the driver
+void QFBResultPrivate::holdLazyBlobs()
+{
+    if (!unreadBlobs)
+    {
+        unreadBlobs = true;
+        d->dp->lazyResults.append(this);
+    }
+}
+//-----------------------------------------------------------------------//
+void QFBResultPrivate::readLazyBlobs()
+{
+    if (unreadBlobs)
+    {
+        r->readLazyBlobs();
+        dropLazyBlobs();
+    }
+}
+//-----------------------------------------------------------------------//
+void QFBResultPrivate::dropLazyBlobs()
+{
+    if (unreadBlobs)
+    {
+        unreadBlobs = false;
+        d->dp->lazyResults.removeOne(this);
+    }
+}
+//-----------------------------------------------------------------------//
+// Reads the BLOBs still unread in the cached rows of the results fetched
+// in tr, 0 for any transaction, before tr ends
+void QFBDriverPrivate::readLazyBlobs(IBPP::ITransaction *tr)
+{
+    const QList<QFBResultPrivate*> results = lazyResults;
+    for (int i = 0; i < results.count(); ++i)
+        if (tr == 0 || results.at(i)->iTr.intf() == tr)
+            results.at(i)->readLazyBlobs();
+}
+//-----------------------------------------------------------------------//
+// Builds the column decoder and the record once, the layout of the result
+// set does not change between executions of a prepared statement.
+void QFBResultPrivate::describeColumns()
+{
+    if (plan.described)
+        return;
+
+    plan.columns.clear();
+    plan.record.clear();
+
+    int cols = 0;
+    try
+    {
+        cols = iSt->Columns();
+        plan.columns.reserve(cols);
+        for (int i = 1; i <= cols; ++i)
+        {
+            QFBColumn col;
+            col.type = iSt->ColumnType(i);
+            col.scale = qMin(qAbs(iSt->ColumnScale(i)), maxScale);
+            col.size = iSt->ColumnSize(i);
+            col.qtype = qIBPPTypeName(col.type);
+            col.nullValue.convert(col.qtype);
+            if (col.type == IBPP::sdArray)
+            {
+                col.table = iSt->ColumnTable(i);
+                col.name = iSt->ColumnName(i);
+            }
+            plan.columns.append(col);
+
+            QSqlField f(QString::fromLatin1(iSt->ColumnAlias(i)).simplified(), col.qtype);
+            f.setLength(col.size);
+            f.setPrecision(col.scale);
+            f.setSqlType(col.type);
+            plan.record.append(f);
+        }
+    }
+    catch (IBPP::Exception& e)
+    {
+        Q_UNUSED(e);
+        plan.columns.clear();
+        plan.record.clear();
+    }
+
+    plan.described = true;
+}
+//-----------------------------------------------------------------------//
+void QFBResultPrivate::setError(const std::string &err, IBPP::Exception &e, QSqlError::ErrorType type)
+{
+//	qWarning(err.data());
+    qWarning(e.ErrorMessage());
+
+    IBPP::SQLException *se = dynamic_cast<IBPP::SQLException *>(&e);
+    if (se && se->EngineCode() == fbCancelledCode)
+    {
+        r->setLastError(QSqlError(QLatin1String(timedOut ? "Statement timeout expired" : "Statement canceled"),
+                                  QString::fromLatin1(e.ErrorMessage()), type, fbCancelledCode));
+        return;
+    }
+
+    r->setLastError(QSqlError(QString::fromLatin1(err.data()),
+                              QString::fromLatin1(e.ErrorMessage()), type));
+}
+//-----------------------------------------------------------------------//
+bool QFBResultPrivate::isSelect()
+{
+    bool iss = false;
+    try
+    {
+        iss = (iSt->Type() == IBPP::stSelect);
+    }
+    catch (IBPP::Exception& e)
+    {
+        setError("Unable get type of statement", e, QSqlError::StatementError);
+    }
+    return iss;
+}
+//-----------------------------------------------------------------------//
+static bool qSetLargeint(QFBResultPrivate *rp, int i, const QVariant &val)
+{
+    rp->iSt->Set(i, val.toLongLong());
+    return true;
+}
+//-----------------------------------------------------------------------//
+static bool qSetInteger(QFBResultPrivate *rp, int i, const QVariant &val)
+{
+    rp->iSt->Set(i, val.toInt());
+    return true;
+}
+//-----------------------------------------------------------------------//
+static bool qSetSmallint(QFBResultPrivate *rp, int i, const QVariant &val)
+{
+    rp->iSt->Set(i, (short)val.toInt());
+    return true;
+}
+//-----------------------------------------------------------------------//
+// Decimal strings and integers are bound exactly, other values through
+// double as before
+static bool qSetScaled(QFBResultPrivate *rp, int i, const QVariant &val)
+{
+    const int scale = qMin(qAbs(rp->plan.params.at(i - 1).scale), maxScale);
+    qint64 scaled;
+    switch (val.type())
+    {
+    case QVariant::String:
+        if (qParseScaled(val.toString(), scale, &scaled))
+        {
+            rp->iSt->Set(i, qlonglong(scaled));
+            return true;
+        }
+        break;
+    case QVariant::Int:
+    case QVariant::UInt:
+    case QVariant::LongLong:
+        {
+            const qint64 bound = Q_INT64_C(0x7fffffffffffffff) / powersOf10[scale];
+            const qint64 v = val.toLongLong();
+            if (v <= bound && v >= -bound)
+            {
+                rp->iSt->Set(i, qlonglong(v * powersOf10[scale]));
+                return true;
+            }
+            break;
+        }
+    default:
+        break;
+    }
+
+    rp->iSt->Set(i, val.toDouble());
+    return true;
+}
+//-----------------------------------------------------------------------//
+static bool qSetFloat(QFBResultPrivate *rp, int i, const QVariant &val)
+{
+    rp->iSt->Set(i, (float)val.toDouble());
+    return true;
+}
+//-----------------------------------------------------------------------//
+static bool qSetDouble(QFBResultPrivate *rp, int i, const QVariant &val)
+{
+    rp->iSt->Set(i, val.toDouble());
+    return true;
+}
+//-----------------------------------------------------------------------//
+static bool qSetTimestamp(QFBResultPrivate *rp, int i, const QVariant &val)
+{
+    rp->iSt->Set(i, toIBPPTimeStamp(val.toDateTime()));
+    return true;
+}
+//-----------------------------------------------------------------------//
+static bool qSetTime(QFBResultPrivate *rp, int i, const QVariant &val)
+{
+    rp->iSt->Set(i, toIBPPTime(val.toTime()));
+    return true;
+}
+//-----------------------------------------------------------------------//
+static bool qSetDate(QFBResultPrivate *rp, int i, const QVariant &val)
+{
+    rp->iSt->Set(i, toIBPPDate(val.toDate()));
+    return true;
+}
+//-----------------------------------------------------------------------//
+static bool qSetString(QFBResultPrivate *rp, int i, const QVariant &val)
+{
+    rp->iSt->Set(i, toIBPPStr(val.toString(), rp->textCodec));
+    return true;
+}
+//-----------------------------------------------------------------------//
+// A BLOB parameter may be bound as a QIODevice* (or a QObject* pointing to
+// one), which is then copied to the BLOB segment by segment.
+static QIODevice *qBlobDevice(const QVariant &val)
+{
+    if (val.userType() == qMetaTypeId<QIODevice*>())
+        return val.value<QIODevice*>();
+    if (val.userType() == QMetaType::QObjectStar)
+        return qobject_cast<QIODevice*>(val.value<QObject*>());
+    return 0;
+}
+//-----------------------------------------------------------------------//
+static bool qSetBlob(QFBResultPrivate *rp, int i, const QVariant &val)
+{
+    QFBStatisticsTimer timer(*rp->stats, BlobWritePhase);
+    IBPP::Blob l_Blob = IBPP::BlobFactory(rp->iDb, rp->iTr);
+    l_Blob->Create();
+
+    QIODevice *device = qBlobDevice(val);
+    if (device)
+    {
+        if (!device->isReadable())
+        {
+            qWarning("QFBResult::exec: BLOB parameter %d: device is not open for reading", i);
+            l_Blob->Cancel();
+            return false;
+        }
+
+        QByteArray buffer;
+        buffer.resize(maxBlobSegment);
+        qint64 read;
+        while ((read = device->read(buffer.data(), maxBlobSegment)) > 0)
+            l_Blob->Write(buffer.constData(), int(read));
+
+        if (read < 0)
+        {
+            qWarning("QFBResult::exec: BLOB parameter %d: %s", i,
+                     device->errorString().toLocal8Bit().constData());
+            l_Blob->Cancel();
+            return false;
+        }
+    }
+    else
+    {
+        const QByteArray ba = val.toByteArray();
+        for (int offset = 0; offset < ba.size(); offset += maxBlobSegment)
+            l_Blob->Write(ba.constData() + offset, qMin(ba.size() - offset, maxBlobSegment));
+    }
+
+    l_Blob->Close();
+    rp->iSt->Set(i, l_Blob);
+    return true;
+}
+//-----------------------------------------------------------------------//
+QFBArraySlot &QFBResultPrivate::arraySlot(int key, const std::string &table, const std::string &column)
+{
+    QFBArraySlot &slot = arrays[key];
+    if (slot.tr == iTr.intf() && slot.array.intf() != 0)
+        return slot;
+
+    slot.array = IBPP::ArrayFactory(iDb, iTr);
+    slot.array->Describe(table, column);
+    slot.type = slot.array->ElementType();
+    slot.size = slot.array->ElementSize();
+    slot.scale = slot.array->ElementScale();
+
+    const int dims = slot.array->Dimensions();
+    slot.extents.resize(dims);
+    slot.elements = 1;
+    for (int dim = 0; dim < dims; ++dim)
+    {
+        int low, high;
+        slot.array->Bounds(dim, &low, &high);
+        if (dim == 0)
+            slot.lowerBound = low;
+        slot.extents[dim] = high - low + 1;
+        slot.elements *= slot.extents.at(dim);
+    }
+
+    slot.tr = iTr.intf();
+    return slot;
+}
+//-----------------------------------------------------------------------//
+// Reads the whole slice of an ARRAY column with one isc_array_get_slice()
+// into a buffer of the element type
+QVariant QFBResultPrivate::fetchArray(int i, const QFBColumn &col)
+{
+    QVariantList flat;
+    QFBArraySlot *slot = 0;
+    try
+    {
+        QFBStatisticsTimer timer(*stats, BlobReadPhase);
+        slot = &arraySlot(i, col.table, col.name);
+        iSt->Get(i, slot->array);
+
+        const int count = slot->elements;
+        flat.reserve(count);
+        switch (slot->type)
+        {
+        case IBPP::sdSmallint:
+        case IBPP::sdInteger:
+        case IBPP::sdLargeint:
+            if (slot->scale)
+            {
+                arrayBuf.resize(count * int(sizeof(double)));
+                slot->array->ReadTo(IBPP::adDouble, arrayBuf.data(), count);
+                qAppendArrayValues<double>(flat, arrayBuf.constData(), count);
+            }
+            else if (slot->type == IBPP::sdLargeint)
+            {
+                arrayBuf.resize(count * int(sizeof(qint64)));
+                slot->array->ReadTo(IBPP::adInt64, arrayBuf.data(), count);
+                qAppendArrayValues<qint64>(flat, arrayBuf.constData(), count);
+            }
+            else
+            {
+                arrayBuf.resize(count * int(sizeof(int)));
+                slot->array->ReadTo(IBPP::adInt32, arrayBuf.data(), count);
+                qAppendArrayValues<int>(flat, arrayBuf.constData(), count);
+            }
+            break;
+        case IBPP::sdFloat:
+            arrayBuf.resize(count * int(sizeof(float)));
+            slot->array->ReadTo(IBPP::adFloat, arrayBuf.data(), count);
+            qAppendArrayValues<float>(flat, arrayBuf.constData(), count);
+            break;
+        case IBPP::sdDouble:
+            arrayBuf.resize(count * int(sizeof(double)));
+            slot->array->ReadTo(IBPP::adDouble, arrayBuf.data(), count);
+            qAppendArrayValues<double>(flat, arrayBuf.constData(), count);
+            break;
+        case IBPP::sdString:
+            {
+                // elements of size + 1 bytes, each terminated by a zero
+                const int cell = slot->size + 1;
+                arrayBuf.resize(count * cell);
+                slot->array->ReadTo(IBPP::adString, arrayBuf.data(), count);
+                for (int k = 0; k < count; ++k)
+                {
+                    const char *data = arrayBuf.constData() + k * cell;
+                    flat.append(fromIBPPStr(data, int(qstrnlen(data, slot->size)),
+                                            stringDecoding, textCodec));
+                }
+                break;
+            }
+        case IBPP::sdDate:
+            {
+                QVector<IBPP::Date> dates(count);
+                slot->array->ReadTo(IBPP::adDate, dates.data(), count);
+                for (int k = 0; k < count; ++k)
+                    flat.append(fromIBPPDate(dates[k]));
+                break;
+            }
+        case IBPP::sdTime:
+            {
+                QVector<IBPP::Time> times(count);
+                slot->array->ReadTo(IBPP::adTime, times.data(), count);
+                for (int k = 0; k < count; ++k)
+                    flat.append(fromIBPPTime(times[k]));
+                break;
+            }
+        case IBPP::sdTimestamp:
+            {
+                QVector<IBPP::Timestamp> stamps(count);
+                slot->array->ReadTo(IBPP::adTimestamp, stamps.data(), count);
+                for (int k = 0; k < count; ++k)
+                    flat.append(fromIBPPTimeStamp(stamps[k]));
+                break;
+            }
+        default:
+            qWarning("QFBResult::gotoNext: Unknown array element type %d", int(slot->type));
+            return col.nullValue;
+        }
+    }
+    catch (IBPP::Exception& e)
+    {
+        setError("Unable to read array", e, QSqlError::StatementError);
+        return col.nullValue;
+    }
+
+    if (slot->extents.count() == 1)
+        return flat;
+    int pos = 0;
+    return qNestArray(flat, slot->extents, 0, pos);
+}
+//-----------------------------------------------------------------------//
+// Writes an ARRAY parameter with one isc_array_put_slice(). Nested lists
+// are taken row by row; a one-dimensional array may get fewer elements
+// than declared, they fill it from the lower bound.
+bool QFBResultPrivate::writeArray(int i, const QVariant &val)
+{
+    const QFBParameter &param = plan.params.at(i - 1);
+    if (param.column.empty())
+    {
+        qWarning("QFBResult::exec: ARRAY parameter %d: its column is not known, "
+                 "use it as a whole value of INSERT ... VALUES or UPDATE ... SET", i);
+        return false;
+    }
+
+    QFBArraySlot &slot = arraySlot(-i, param.table, param.column);
+
+    QVariantList flat;
+    qFlattenArray(val, flat);
+    const int count = flat.count();
+    if (slot.extents.count() == 1 && count > 0 && count <= slot.elements)
+        slot.array->SetBounds(0, slot.lowerBound, slot.lowerBound + count - 1);
+    else if (count != slot.elements)
+    {
+        qWarning("QFBResult::exec: ARRAY parameter %d: %d elements given, %d expected",
+                 i, count, slot.elements);
+        return false;
+    }
+
+    bool ok = true;
+    switch (slot.type)
+    {
+    case IBPP::sdSmallint:
+    case IBPP::sdInteger:
+    case IBPP::sdLargeint:
+    case IBPP::sdFloat:
+    case IBPP::sdDouble:
+        if (slot.type == IBPP::sdLargeint && !slot.scale)
+        {
+            arrayBuf.resize(count * int(sizeof(qint64)));
+            qint64 *values = reinterpret_cast<qint64 *>(arrayBuf.data());
+            for (int k = 0; ok && k < count; ++k)
+                values[k] = flat.at(k).isNull() ? 0 : flat.at(k).toLongLong(&ok);
+            if (ok)
+                slot.array->WriteFrom(IBPP::adInt64, values, count);
+        }
+        else if (slot.type != IBPP::sdFloat && slot.type != IBPP::sdDouble && !slot.scale)
+        {
+            arrayBuf.resize(count * int(sizeof(int)));
+            int *values = reinterpret_cast<int *>(arrayBuf.data());
+            for (int k = 0; ok && k < count; ++k)
+                values[k] = flat.at(k).isNull() ? 0 : flat.at(k).toInt(&ok);
+            if (ok)
+                slot.array->WriteFrom(IBPP::adInt32, values, count);
+        }
+        else
+        {
+            arrayBuf.resize(count * int(sizeof(double)));
+            double *values = reinterpret_cast<double *>(arrayBuf.data());
+            for (int k = 0; ok && k < count; ++k)
+                values[k] = flat.at(k).isNull() ? 0 : flat.at(k).toDouble(&ok);
+            if (ok)
+                slot.array->WriteFrom(IBPP::adDouble, values, count);
+        }
+        if (!ok)
+            qWarning("QFBResult::exec: ARRAY parameter %d: element is not a number", i);
+        break;
+    case IBPP::sdString:
+        {
+            const int cell = slot.size + 1;
+            arrayBuf.fill('\0', count * cell);
+            for (int k = 0; k < count; ++k)
+            {
+                const std::string str = toIBPPStr(flat.at(k).toString(), textCodec);
+                memcpy(arrayBuf.data() + k * cell, str.data(), qMin(int(str.size()), slot.size));
+            }
+            slot.array->WriteFrom(IBPP::adString, arrayBuf.constData(), count);
+            break;
+        }
+    case IBPP::sdDate:
+        {
+            QVector<IBPP::Date> dates(count);
+            for (int k = 0; k < count; ++k)
+                dates[k] = toIBPPDate(flat.at(k).toDate());
+            slot.array->WriteFrom(IBPP::adDate, dates.constData(), count);
+            break;
+        }
+    case IBPP::sdTime:
+        {
+            QVector<IBPP::Time> times(count);
+            for (int k = 0; k < count; ++k)
+                times[k] = toIBPPTime(flat.at(k).toTime());
+            slot.array->WriteFrom(IBPP::adTime, times.constData(), count);
+            break;
+        }
+    case IBPP::sdTimestamp:
+        {
+            QVector<IBPP::Timestamp> stamps(count);
+            for (int k = 0; k < count; ++k)
+                stamps[k] = toIBPPTimeStamp(flat.at(k).toDateTime());
+            slot.array->WriteFrom(IBPP::adTimestamp, stamps.constData(), count);
+            break;
+        }
+    default:
+        qWarning("QFBResult::exec: ARRAY parameter %d: unknown element type %d", i, int(slot.type));
+        ok = false;
+        break;
+    }
+
+    if (ok)
+        iSt->Set(i, slot.array);
+    return ok;
+}
+//-----------------------------------------------------------------------//
+static bool qSetArray(QFBResultPrivate *rp, int i, const QVariant &val)
+{
+    QFBStatisticsTimer timer(*rp->stats, BlobWritePhase);
+    return rp->writeArray(i, val);
+}
+//-----------------------------------------------------------------------//
+static bool qSetUnknown(QFBResultPrivate *rp, int i, const QVariant &val)
+{
+    Q_UNUSED(val);
+    qWarning("QFBResult::exec: Unknown datatype %d",
+             rp->iSt->ParameterType(i));
+    return false;
+}
+//-----------------------------------------------------------------------//
+// Picks a typed setter for every parameter once, instead of looking the
+// parameter type and scale up on every execution.
+void QFBResultPrivate::describeParameters()
+{
+    if (plan.paramsDescribed)
+        return;
+
+    plan.params.clear();
+
+    std::string table;
+    QVector<std::string> columns;
+    bool targets = false;
+
+    try
+    {
+        const int paramCount = iSt->Parameters();
+        plan.params.reserve(paramCount);
+        for (int i = 1; i <= paramCount; ++i)
+        {
+            QFBParameter param;
+            param.type = iSt->ParameterType(i);
+            param.scale = iSt->ParameterScale(i);
+
+            switch (param.type)
+            {
+            case IBPP::sdLargeint:
+                param.set = param.scale ? qSetScaled : qSetLargeint;
+                break;
+            case IBPP::sdInteger:
+                param.set = param.scale ? qSetScaled : qSetInteger;
+                break;
+            case IBPP::sdSmallint:
+                param.set = param.scale ? qSetScaled : qSetSmallint;
+                break;
+            case IBPP::sdFloat:
+                param.set = qSetFloat;
+                break;
+            case IBPP::sdDouble:
+                param.set = qSetDouble;
+                break;
+            case IBPP::sdTimestamp:
+                param.set = qSetTimestamp;
+                break;
+            case IBPP::sdTime:
+                param.set = qSetTime;
+                break;
+            case IBPP::sdDate:
+                param.set = qSetDate;
+                break;
+            case IBPP::sdString:
+                param.set = qSetString;
+                break;
+            case IBPP::sdBlob:
+                param.set = qSetBlob;
+                break;
+            case IBPP::sdArray:
+                param.set = qSetArray;
+                if (!targets)
+                {
+                    columns = qParameterTargets(sql, table);
+                    targets = true;
+                }
+                if (i <= columns.count() && !columns.at(i - 1).empty())
+                {
+                    param.table = table;
+                    param.column = columns.at(i - 1);
+                }
+                break;
+            default:
+                param.set = qSetUnknown;
+                break;
+            }
+            plan.params.append(param);
+        }
+    }
+    catch (IBPP::Exception& e)
+    {
+        Q_UNUSED(e);
+        plan.params.clear();
+    }
+
+    plan.paramsDescribed = true;
+}
+//-----------------------------------------------------------------------//
+// The setters explain a refused value with a warning, the error names the
+// first parameter refused
+bool QFBResultPrivate::bind(const QVector<QVariant> &values)
+{
+    int failed = 0;
+    const QFBParameter *param = plan.params.constData();
+
+    try
+    {
+        for (int i = 1; i <= values.count(); ++i, ++param)
+        {
+            if (!param->set)
+                continue;
+
+            const QVariant &val = values.at(i - 1);
+            if (val.isNull())
+                iSt->SetNull(i);
+            else if (!param->set(this, i, val) && !failed)
+                failed = i;
+        }
+    }
+    catch (IBPP::Exception& e)
+    {
+        setError("Unable to set parameter", e, QSqlError::StatementError);
+        return false;
+    }
+
+    if (failed)
+    {
+        r->setLastError(QSqlError(QLatin1String("Unable to set parameter ") + QString::number(failed),
+                                  QString(), QSqlError::StatementError));
+        return false;
+    }
+    return true;
 }
 //-----------------------------------------------------------------------//
 bool QFBResultPrivate::transaction()
 {
-    if (iTr->Started())
-        return true;
+    if (iSt.intf() == 0)
+        return false;
+
+    closeReadCursor();
 
-    if (d->dp->iTr != 0)
-        if (d->dp->iTr->Started())
+    if (sharedRead)
+    {
+        // an explicit transaction started since prepare takes over
+        if (d->dp->iTr != 0 && d->dp->iTr->Started())
         {
-            localTransaction = false;
-            iTr.clear();
-            iSt.clear();
-            iTr = d->dp->iTr;
-            iSt = IBPP::StatementFactory(iDb,iTr);
-            return true;
+            const std::string query(sql);
+            release();
+            return prepare(query);
         }
 
-    localTransaction = true;
+        try
+        {
+            d->dp->startReadTransaction();
+        }
+        catch (IBPP::Exception& e)
+        {
+            setError("Unable start transaction", e, QSqlError::TransactionError);
+            return false;
+        }
+        return true;
+    }
+
+    if (iTr->Started())
+        return true;
+
+    // The transaction the statement was prepared in is over. A local one is
+    // simply restarted, otherwise prepare again in the current transaction.
+    if (!localTransaction || (d->dp->iTr != 0 && d->dp->iTr->Started()))
+    {
+        const std::string query(sql);
+        release();
+        return prepare(query);
+    }
 
     try
     {
-        iTr.clear();
-        iSt.clear();
-        d->dp->checkTransactionArguments();
-        iTr = IBPP::TransactionFactory(iDb, d->dp->tam, d->dp->til, d->dp->tlr, d->dp->tff);
-        iSt = IBPP::StatementFactory(iDb,iTr);
+        QFBStatisticsTimer timer(d->dp->stats, StartPhase);
         iTr->Start();
     }
     catch (IBPP::Exception& e)
@@ -454,7 +3794,7 @@ bool QFBResultPrivate::transaction()
 //-----------------------------------------------------------------------//
 bool QFBResultPrivate::commit()
 {
-    if (!localTransaction)
+    if (!localTransaction || sharedRead || iTr.intf() == 0)
         return true;
 
     if (!iTr->Started())
@@ -462,6 +3802,7 @@ bool QFBResultPrivate::commit()
 
     try
     {
+        QFBStatisticsTimer timer(d->dp->stats, CommitPhase);
         iTr->Commit();
     }
     catch (IBPP::Exception& e)
@@ -473,6 +3814,28 @@ bool QFBResultPrivate::commit()
     return true;
 }
 //-----------------------------------------------------------------------//
+bool QFBResultPrivate::rollback()
+{
+    if (!localTransaction || sharedRead || iTr.intf() == 0)
+        return true;
+
+    if (!iTr->Started())
+        return true;
+
+    try
+    {
+        QFBStatisticsTimer timer(d->dp->stats, RollbackPhase);
+        iTr->Rollback();
+    }
+    catch (IBPP::Exception& e)
+    {
+        setError("Unable to rollback transaction", e, QSqlError::TransactionError);
+        return false;
+    }
+
+    return true;
+}
+//-----------------------------------------------------------------------//
 QFBResult::QFBResult(const QFBDriver *db, QTextCodec *tc):
         QSqlCachedResult(db)
 {
@@ -495,20 +3858,14 @@ bool QFBResult::prepare(const QString& query)
     setActive(false);
     setAt(QSql::BeforeFirstRow);
 
-    if (!rp->transaction())
-    {
-        return false;
-    }
-
-    try
+    bool ok;
+    rp->slowPrepare = 0;
     {
-        rp->iSt->Prepare(toIBPPStr(query, rp->textCodec));
+        QFBScopeTimer timer(rp->slowQueryMs ? &rp->slowPrepare : 0);
+        ok = rp->prepare(toIBPPStr(query, rp->textCodec));
     }
-    catch (IBPP::Exception& e)
-    {
-        rp->setError("Unable prepare statement", e , QSqlError::StatementError);
+    if (!ok)
         return false;
-    }
 
     setSelect(rp->isSelect());
 
@@ -529,158 +3886,273 @@ bool QFBResult::exec()
 
     setActive(false);
     setAt(QSql::BeforeFirstRow);
+    rp->batchRowsAffected = -1;
+    rp->dropLazyBlobs();
 
-    int paramCount = 0;
-
-    try
-    {
-        paramCount = rp->iSt->Parameters();
-    }
-    catch (IBPP::Exception& e)
-    {
-        Q_UNUSED(e);
-        paramCount = 0;
-    }
+    rp->describeParameters();
+    const int paramCount = rp->plan.params.count();
 
     bool ok = true;
+    QVector<QVariant> values;
     if (paramCount)
     {
-        QVector<QVariant>& values = boundValues();
-        int i;
+        values = parameterValues();
         if (values.count() > paramCount)
         {
             qWarning("QFBResult::exec: Parameter mismatch, expected %d, got %d parameters",
-                     rp->iSt->Parameters(), values.count());
+                     paramCount, values.count());
             return false;
         }
-        for (i = 1; i <= values.count(); ++i)
+        ok = rp->bind(values);
+    }
+
+    if (!ok)
+        return false;
+
+    if (rp->plan.ddl)
+        rp->schemaChanging();
+
+    rp->startSlowQuery(values);
+    rp->startTimeout();
+    try
+    {
+        QFBTimeoutGuard guard(rp);
         {
+            QFBStatisticsTimer timer(*rp->stats, ExecutePhase, rp->plan.stats);
+            QFBScopeTimer slow(rp->slowTiming ? &rp->slowExecute : 0);
+            rp->iSt->Execute();
+        }
+        if (rp->plan.stats)
+            rp->plan.stats->executions.fetchAndAddRelaxed(1);
 
-            if (!rp->iSt->ParameterType(i))
-                continue;
+        if (rp->plan.ddl)
+            rp->schemaChanged();
+    }
+    catch (IBPP::Exception& e)
+    {
+        rp->finishSlowQuery();
+        rp->setError("Unable execute statement", e ,QSqlError::StatementError);
+        return false;
+    }
+    rp->describeColumns();
+    const int cols = rp->plan.columns.count();
 
-            const QVariant val(values[i-1]);
+    if (cols > 0)
+    {
+        init(cols);
+        rp->openReadCursor();
+    }
+    else
+    {
+        cleanup(); // cleanup
+        rp->finishSlowQuery();
+    }
 
-            if (val.isNull())
-            {
-                try
-                {
-                    rp->iSt->SetNull(i);
-                }
-                catch (IBPP::Exception& e)
-                {
-                    rp->setError("Unable to set NULL", e, QSqlError::StatementError);
-                    return false;
-                }
-                continue;
-            }
+    if (!rp->isSelect())
+        rp->commit();
 
-            switch (rp->iSt->ParameterType(i))
-            {
-            case IBPP::sdLargeint:
-                if (rp->iSt->ParameterScale(i))
-                    rp->iSt->Set(i, val.toDouble());
-                else
-                    rp->iSt->Set(i, val.toLongLong());
-                break;
-            case IBPP::sdInteger:
-                if (rp->iSt->ParameterScale(i))
-                    rp->iSt->Set(i, val.toDouble());
-                else
-                    rp->iSt->Set(i, val.toInt());
-                break;
-            case IBPP::sdSmallint:
-                if (rp->iSt->ParameterScale(i))
-                    rp->iSt->Set(i, val.toDouble());
-                else
-                    rp->iSt->Set(i, (short)val.toInt());
-                break;
-            case IBPP::sdFloat:
-                rp->iSt->Set(i, (float)val.toDouble());
-                break;
-            case IBPP::sdDouble:
-                rp->iSt->Set(i, val.toDouble());
-                break;
-            case IBPP::sdTimestamp:
-                rp->iSt->Set(i, toIBPPTimeStamp(val.toDateTime()));
-                break;
-            case IBPP::sdTime:
-                rp->iSt->Set(i, toIBPPTime(val.toTime()));
-                break;
-            case IBPP::sdDate:
-                rp->iSt->Set(i, toIBPPDate(val.toDate()));
-                break;
-            case IBPP::sdString:
-                rp->iSt->Set(i, toIBPPStr(val.toString(), rp->textCodec));
-                break;
-            case IBPP::sdBlob:
-                {
-                    std::string  ss;
-                    QByteArray ba = val.toByteArray();
-                    ss.resize(ba.size());
-                    ss.assign(ba.constData(), ba.size());
-                    rp->iSt->Set(i, ss);
-                    break;
-                }
-            case IBPP::sdArray:
-//                ok &= rp->writeArray(i, val.toList());
-                break;
-            default:
-                qWarning("QFBResult::exec: Unknown datatype %d",
-                         rp->iSt->ParameterType(i));
-                ok = false;
-                break;
-            }
+    setActive(true);
+    return true;
+}
+//-----------------------------------------------------------------------//
+// Bound values in the order of the statement's markers. QSqlResult numbers
+// named values by its own scan of the SQL, which also counts names found
+// in comments and EXECUTE BLOCK bodies, so they are matched by name.
+QVector<QVariant> QFBResult::parameterValues()
+{
+    const QVector<QVariant> &values = boundValues();
+    QFBStatementPlan &plan = rp->plan;
+    if (plan.paramNames.isEmpty())
+        return values;
+
+    if (plan.valueCount != values.count())
+    {
+        QHash<QString, int> indexes;
+        for (int i = values.count() - 1; i >= 0; --i)
+            indexes.insert(boundValueName(i), i);
+
+        plan.valueIndex.resize(plan.paramNames.count());
+        for (int i = 0; i < plan.paramNames.count(); ++i)
+        {
+            const QString &name = plan.paramNames.at(i);
+            if (name.isEmpty())
+                plan.valueIndex[i] = i < values.count() ? i : -1;
+            else
+                plan.valueIndex[i] = indexes.value(QLatin1Char(':') + name, -1);
         }
+        plan.valueCount = values.count();
     }
 
-    if (!ok)
+    // an unbound name is NULL, as with QSqlResult's emulation
+    QVector<QVariant> ordered(plan.valueIndex.count());
+    for (int i = 0; i < plan.valueIndex.count(); ++i)
+        if (plan.valueIndex.at(i) >= 0)
+            ordered[i] = values.at(plan.valueIndex.at(i));
+    return ordered;
+}
+//-----------------------------------------------------------------------//
+bool QFBResult::reset (const QString& query)
+{
+    if (!prepare(query))
         return false;
+    return exec();
+}
+//-----------------------------------------------------------------------//
+// Executes the prepared statement once per row of the bound value lists,
+// all rows in one transaction. The batch stops at the first failing row,
+// whose index the error text ends with. In autocommit mode it rolls the
+// whole batch back; in a transaction of the driver the rows before it stay
+// applied and the caller decides between commit and rollback.
+// QSqlResult::execBatch() reports success unless an error is set, so
+// every failure sets one.
+bool QFBResult::execBatchValues()
+{
+    setLastError(QSqlError());
 
-    try
+    if (!driver() || !driver()->isOpen() || driver()->isOpenError())
     {
-        rp->iSt->Execute();
+        setLastError(QSqlError(QLatin1String("Unable execute batch: database not open"),
+                               QString(), QSqlError::ConnectionError));
+        return false;
     }
-    catch (IBPP::Exception& e)
+
+    if (!rp->transaction())
     {
-        rp->setError("Unable execute statement", e ,QSqlError::StatementError);
+        if (!lastError().isValid())
+            setLastError(QSqlError(QLatin1String("Unable execute batch: statement not prepared"),
+                                   QString(), QSqlError::StatementError));
         return false;
     }
-    int cols = 0;
-    try
+
+    setActive(false);
+    setAt(QSql::BeforeFirstRow);
+    rp->batchRowsAffected = -1;
+
+    rp->describeParameters();
+    const int paramCount = rp->plan.params.count();
+
+    const QVector<QVariant> values = parameterValues();
+    if (values.count() > paramCount)
     {
-        cols = rp->iSt->Columns();
+        qWarning("QFBResult::execBatch: Parameter mismatch, expected %d, got %d parameters",
+                 paramCount, values.count());
+        setLastError(QSqlError(QLatin1String("Unable execute batch: parameter mismatch"),
+                               QString(), QSqlError::StatementError));
+        return false;
     }
-    catch (IBPP::Exception& e)
+
+    QVector<QVariantList> columns(values.count());
+    int rows = values.isEmpty() ? 1 : -1;
+    for (int j = 0; j < values.count(); ++j)
     {
-        Q_UNUSED(e);
+        columns[j] = values.at(j).toList();
+        if (rows < 0)
+            rows = columns.at(j).count();
+        if (columns.at(j).count() != rows)
+        {
+            setLastError(QSqlError(QLatin1String("Unable execute batch: bound lists differ in length"),
+                                   QString(), QSqlError::StatementError));
+            return false;
+        }
+    }
+
+    const bool select = rp->isSelect();
+    QVector<QVariant> row(values.count());
+    int affected = 0;
+    rp->startSlowQuery(values);
+    rp->startTimeout();
+    for (int i = 0; i < rows; ++i)
+    {
+        for (int j = 0; j < columns.count(); ++j)
+            row[j] = columns.at(j).at(i);
+
+        bool ok = rp->bind(row);
+        if (ok)
+        {
+            try
+            {
+                QFBTimeoutGuard guard(rp);
+                {
+                    QFBStatisticsTimer timer(*rp->stats, ExecutePhase, rp->plan.stats);
+                    QFBScopeTimer slow(rp->slowTiming ? &rp->slowExecute : 0);
+                    rp->iSt->Execute();
+                }
+                if (rp->plan.stats)
+                    rp->plan.stats->executions.fetchAndAddRelaxed(1);
+                if (!select)
+                    affected += qMax(0, rp->iSt->AffectedRows());
+            }
+            catch (IBPP::Exception& e)
+            {
+                rp->setError("Unable execute statement", e, QSqlError::StatementError);
+                ok = false;
+            }
+        }
+
+        if (!ok)
+        {
+            QSqlError error = lastError();
+            error.setDriverText(error.driverText() + QLatin1String(" in batch row ") + QString::number(i));
+            setLastError(error);
+            rp->finishSlowQuery();
+            rp->rollback();
+            return false;
+        }
     }
 
+    rp->describeColumns();
+    const int cols = rp->plan.columns.count();
+
     if (cols > 0)
+    {
         init(cols);
+        rp->openReadCursor();
+    }
     else
+    {
         cleanup(); // cleanup
+        rp->finishSlowQuery();
+    }
 
-    if (!rp->isSelect())
+    if (!select)
+    {
+        rp->batchRowsAffected = affected;
         rp->commit();
+    }
 
     setActive(true);
     return true;
 }
 //-----------------------------------------------------------------------//
-bool QFBResult::reset (const QString& query)
+void QFBResult::virtual_hook(int id, void *data)
 {
-    if (!prepare(query))
-        return false;
-    return exec();
+    switch (id)
+    {
+    case QSqlResult::BatchOperation:
+        execBatchValues();
+        break;
+    case QSqlResult::DetachFromResultSet:
+        // QSqlQuery::finish(), the rest of the rows is not wanted
+        rp->closeReadCursor();
+        rp->finishSlowQuery();
+        break;
+    default:
+        QSqlCachedResult::virtual_hook(id, data);
+    }
 }
 //-----------------------------------------------------------------------//
 bool QFBResult::gotoNext(QSqlCachedResult::ValueCache& row, int rowIdx)
 {
 
+    if (!rp->checkReadCursor())
+        return false;
+
     bool stat;
     try
     {
+        QFBTimeoutGuard guard(rp);
+        QFBStatisticsTimer timer(*rp->stats, FetchPhase, rp->plan.stats);
+        QFBScopeTimer slow(rp->slowTiming ? &rp->slowFetch : 0);
         stat = rp->iSt->Fetch();
     }
     catch (IBPP::Exception& e)
@@ -693,36 +4165,35 @@ bool QFBResult::gotoNext(QSqlCachedResult::ValueCache& row, int rowIdx)
     {
         // no more rows
         setAt(QSql::AfterLastRow);
+        rp->closeReadCursor();
+        rp->finishSlowQuery();
         return false;
     }
 
+    if (rp->plan.stats)
+        rp->plan.stats->rows.fetchAndAddRelaxed(1);
+    ++rp->slowRows;
+
     if (rowIdx < 0) // not interested in actual values
         return true;
 
-    int cols = 0;
-    try
-    {
-        cols = rp->iSt->Columns();
-    }
-    catch (IBPP::Exception& e)
-    {
-        Q_UNUSED(e);
-    }
-
-    for (int i = 1; i <= cols; ++i)
+    QFBStatisticsTimer timer(*rp->stats, ConvertPhase, rp->plan.stats);
+    QFBScopeTimer slow(rp->slowTiming ? &rp->slowFetch : 0);
+    const QSql::NumericalPrecisionPolicy policy = numericalPrecisionPolicy();
+    const int cols = rp->plan.columns.count();
+    const QFBColumn *col = rp->plan.columns.constData();
+    for (int i = 1; i <= cols; ++i, ++col)
     {
         int idx = rowIdx + i - 1;
 
         if (rp->iSt->IsNull(i))
         {
             // null value
-            QVariant v;
-            v.convert(qIBPPTypeName(rp->iSt->ColumnType(i)));
-            row[idx] = v;
+            row[idx] = col->nullValue;
             continue;
         }
 
-        switch (rp->iSt->ColumnType(i))
+        switch (col->type)
         {
         case IBPP::sdDate:
             {
@@ -747,11 +4218,11 @@ bool QFBResult::gotoNext(QSqlCachedResult::ValueCache& row, int rowIdx)
             }
         case IBPP::sdSmallint:
             {
-                if (rp->iSt->ColumnScale(i))
+                if (col->scale)
                 {
-                    double l_Double;
-                    rp->iSt->Get(i, l_Double);
-                    row[idx] = l_Double;
+                    qlonglong raw;
+                    rp->iSt->Get(i, raw);
+                    row[idx] = qScaledValue(raw, col->scale, policy);
                 }
                 else
                 {
@@ -763,11 +4234,11 @@ bool QFBResult::gotoNext(QSqlCachedResult::ValueCache& row, int rowIdx)
             }
         case IBPP::sdInteger:
             {
-                if (rp->iSt->ColumnScale(i))
+                if (col->scale)
                 {
-                    double l_Double;
-                    rp->iSt->Get(i, l_Double);
-                    row[idx] = l_Double;
+                    qlonglong raw;
+                    rp->iSt->Get(i, raw);
+                    row[idx] = qScaledValue(raw, col->scale, policy);
                 }
                 else
                 {
@@ -779,11 +4250,11 @@ bool QFBResult::gotoNext(QSqlCachedResult::ValueCache& row, int rowIdx)
             }
         case IBPP::sdLargeint:
             {
-                if (rp->iSt->ColumnScale(i))
+                if (col->scale)
                 {
-                    double l_Double;
-                    rp->iSt->Get(i, l_Double);
-                    row[idx] = l_Double;
+                    qlonglong raw;
+                    rp->iSt->Get(i, raw);
+                    row[idx] = qScaledValue(raw, col->scale, policy);
                 }
                 else
                 {
@@ -810,14 +4281,18 @@ bool QFBResult::gotoNext(QSqlCachedResult::ValueCache& row, int rowIdx)
             }
         case IBPP::sdString:
             {
-                std::string l_String;
-                rp->iSt->Get(i, l_String);
-                row[idx] = fromIBPPStr(l_String, rp->textCodec);
+                // raw bytes of the column, decoded without a std::string copy
+                if (rp->strBuf.size() < col->size)
+                    rp->strBuf.resize(col->size);
+                int len = rp->strBuf.size();
+                rp->iSt->Get(i, rp->strBuf.data(), len);
+                row[idx] = fromIBPPStr(rp->strBuf.constData(), len,
+                                       rp->stringDecoding, rp->textCodec);
                 break;
             }
         case IBPP::sdArray:
             {
-//	            row[idx] = rp->fetchArray(i, (ISC_QUAD*)buf);
+                row[idx] = rp->fetchArray(i, *col);
                 break;
             }
         case IBPP::sdBlob:
@@ -825,20 +4300,16 @@ bool QFBResult::gotoNext(QSqlCachedResult::ValueCache& row, int rowIdx)
                 IBPP::Blob l_Blob = IBPP::BlobFactory(rp->iDb, rp->iTr);
                 rp->iSt->Get(i, l_Blob);
 
-                QByteArray l_QBlob;
-
-                l_Blob->Open();
-                int l_Read, l_Offset = 0;
-                char buffer[1024];
-                while ((l_Read = l_Blob->Read(buffer, 1024)))
+                if (rp->lazyBlobs)
                 {
-                    l_QBlob.resize(l_QBlob.size() + l_Read);
-                    memcpy(l_QBlob.data() + l_Offset, buffer, l_Read);
-                    l_Offset += l_Read;
+                    row[idx] = QVariant::fromValue(l_Blob); // read in data()
+                    rp->holdLazyBlobs();
+                }
+                else
+                {
+                    QFBStatisticsTimer timer(*rp->stats, BlobReadPhase);
+                    row[idx] = fromIBPPBlob(l_Blob);
                 }
-                l_Blob->Close();
-
-                row[idx] = l_QBlob;
                 break;
             }
         default:
@@ -850,6 +4321,232 @@ bool QFBResult::gotoNext(QSqlCachedResult::ValueCache& row, int rowIdx)
     return true;
 }
 //-----------------------------------------------------------------------//
+// Columnar counterpart of QFBResult::gotoNext(), decodes with the same
+// column plan straight into the typed buffers of block.
+int QFBResultPrivate::fetchBlock(QFBRowBlock &block, int maxRows)
+{
+    if (!r->isActive() || !r->isSelect() || maxRows < 0)
+        return -1;
+    if (!checkReadCursor())
+        return -1;
+
+    const int cols = plan.columns.count();
+    block.rowCount = 0;
+    block.columns.resize(cols);
+
+    for (int c = 0; c < cols; ++c)
+    {
+        const QFBColumn &col = plan.columns.at(c);
+        QFBRowBlock::Column &out = block.columns[c];
+
+        out.name = plan.record.fieldName(c);
+        out.scale = col.scale;
+        out.nulls.fill(false, maxRows);
+        switch (col.type)
+        {
+        case IBPP::sdSmallint:
+        case IBPP::sdInteger:
+            out.kind = col.scale ? QFBRowBlock::Double : QFBRowBlock::Int32;
+            break;
+        case IBPP::sdLargeint:
+            out.kind = col.scale ? QFBRowBlock::Double : QFBRowBlock::Int64;
+            break;
+        case IBPP::sdFloat:
+        case IBPP::sdDouble:
+            out.kind = QFBRowBlock::Double;
+            break;
+        case IBPP::sdDate:
+            out.kind = QFBRowBlock::Date;
+            break;
+        case IBPP::sdTime:
+            out.kind = QFBRowBlock::Time;
+            break;
+        case IBPP::sdTimestamp:
+            out.kind = QFBRowBlock::DateTime;
+            break;
+        case IBPP::sdString:
+            out.kind = QFBRowBlock::String;
+            break;
+        default:
+            out.kind = QFBRowBlock::Unsupported;
+            break;
+        }
+
+        switch (out.kind)
+        {
+        case QFBRowBlock::Int32:
+        case QFBRowBlock::Date:
+        case QFBRowBlock::Time:
+            out.int32s.resize(maxRows);
+            break;
+        case QFBRowBlock::Int64:
+        case QFBRowBlock::DateTime:
+            out.int64s.resize(maxRows);
+            break;
+        case QFBRowBlock::Double:
+            out.doubles.resize(maxRows);
+            break;
+        case QFBRowBlock::String:
+            out.offsets.resize(maxRows + 1);
+            out.offsets[0] = 0;
+            out.bytes.resize(0);
+            break;
+        default:
+            break;
+        }
+    }
+
+    const qint64 msecsPerDay = Q_INT64_C(86400000);
+    const int epochDay = QDate(1970, 1, 1).toJulianDay();
+
+    int row = 0;
+    try
+    {
+        QFBTimeoutGuard guard(this);
+        QFBStatisticsTimer timer(d->dp->stats, FetchPhase, plan.stats);
+        QFBScopeTimer slow(slowTiming ? &slowFetch : 0);
+        for (; row < maxRows; ++row)
+        {
+            if (!iSt->Fetch())
+            {
+                r->setAt(QSql::AfterLastRow);
+                closeReadCursor();
+                break;
+            }
+
+            for (int c = 0; c < cols; ++c)
+            {
+                const int i = c + 1;
+                QFBRowBlock::Column &out = block.columns[c];
+
+                if (iSt->IsNull(i))
+                {
+                    out.nulls.setBit(row);
+                    switch (out.kind)
+                    {
+                    case QFBRowBlock::Int32:
+                    case QFBRowBlock::Date:
+                    case QFBRowBlock::Time:
+                        out.int32s[row] = 0;
+                        break;
+                    case QFBRowBlock::Int64:
+                    case QFBRowBlock::DateTime:
+                        out.int64s[row] = 0;
+                        break;
+                    case QFBRowBlock::Double:
+                        out.doubles[row] = 0;
+                        break;
+                    case QFBRowBlock::String:
+                        out.offsets[row + 1] = out.bytes.size();
+                        break;
+                    default:
+                        break;
+                    }
+                    continue;
+                }
+
+                switch (out.kind)
+                {
+                case QFBRowBlock::Int32:
+                    {
+                        int l_Integer;
+                        iSt->Get(i, l_Integer);
+                        out.int32s[row] = l_Integer;
+                        break;
+                    }
+                case QFBRowBlock::Int64:
+                    {
+                        qlonglong l_Long;
+                        iSt->Get(i, l_Long);
+                        out.int64s[row] = l_Long;
+                        break;
+                    }
+                case QFBRowBlock::Double:
+                    {
+                        double l_Double;
+                        iSt->Get(i, l_Double);
+                        out.doubles[row] = l_Double;
+                        break;
+                    }
+                case QFBRowBlock::Date:
+                    {
+                        IBPP::Date dt;
+                        iSt->Get(i, dt);
+                        out.int32s[row] = qJulianDay(dt);
+                        break;
+                    }
+                case QFBRowBlock::Time:
+                    {
+                        IBPP::Time tm;
+                        iSt->Get(i, tm);
+                        out.int32s[row] = qMSecsOfDay(tm);
+                        break;
+                    }
+                case QFBRowBlock::DateTime:
+                    {
+                        IBPP::Timestamp ts;
+                        iSt->Get(i, ts);
+                        out.int64s[row] = (qJulianDay(ts) - epochDay) * msecsPerDay + qMSecsOfDay(ts);
+                        break;
+                    }
+                case QFBRowBlock::String:
+                    {
+                        if (strBuf.size() < plan.columns.at(c).size)
+                            strBuf.resize(plan.columns.at(c).size);
+                        int len = strBuf.size();
+                        iSt->Get(i, strBuf.data(), len);
+                        len = qPaddedLength(strBuf.constData(), len);
+                        out.bytes.append(strBuf.constData(), len);
+                        out.offsets[row + 1] = out.bytes.size();
+                        break;
+                    }
+                default:
+                    break;
+                }
+            }
+        }
+    }
+    catch (IBPP::Exception& e)
+    {
+        setError("Could not fetch next item", e, QSqlError::StatementError);
+        return -1;
+    }
+
+    block.rowCount = row;
+    if (plan.stats)
+        plan.stats->rows.fetchAndAddRelaxed(row);
+    slowRows += row;
+    if (r->at() == QSql::AfterLastRow)
+        finishSlowQuery();
+    for (int c = 0; c < cols; ++c)
+    {
+        QFBRowBlock::Column &out = block.columns[c];
+        out.nulls.resize(row);
+        switch (out.kind)
+        {
+        case QFBRowBlock::Int32:
+        case QFBRowBlock::Date:
+        case QFBRowBlock::Time:
+            out.int32s.resize(row);
+            break;
+        case QFBRowBlock::Int64:
+        case QFBRowBlock::DateTime:
+            out.int64s.resize(row);
+            break;
+        case QFBRowBlock::Double:
+            out.doubles.resize(row);
+            break;
+        case QFBRowBlock::String:
+            out.offsets.resize(row + 1);
+            break;
+        default:
+            break;
+        }
+    }
+
+    return row;
+}
+//-----------------------------------------------------------------------//
 int QFBResult::size()
 {
     int nra = -1;
@@ -874,6 +4571,9 @@ int QFBResult::numRowsAffected()
     if (isSelect())
         return nra;
 
+    if (rp->batchRowsAffected >= 0)
+        return rp->batchRowsAffected;
+
     try
     {
         nra = rp->iSt->AffectedRows();
@@ -885,32 +4585,60 @@ int QFBResult::numRowsAffected()
     return nra;
 }
 //-----------------------------------------------------------------------//
-QSqlRecord QFBResult::record() const
+QVariant QFBResult::data(int i)
 {
-    QSqlRecord rec;
-    if (!isActive())
-        return rec;
+    QVariant v = QSqlCachedResult::data(i);
+    if (v.userType() != qMetaTypeId<IBPP::Blob>())
+        return v;
 
-    int cols = 0;
+    IBPP::Blob l_Blob = v.value<IBPP::Blob>();
     try
     {
-        cols = rp->iSt->Columns();
+        QFBStatisticsTimer timer(*rp->stats, BlobReadPhase);
+        v = fromIBPPBlob(l_Blob);
     }
     catch (IBPP::Exception& e)
     {
-        Q_UNUSED(e);
+        rp->setError("Unable to read blob", e, QSqlError::StatementError);
+        return QVariant(QVariant::ByteArray);
     }
-    for (int i = 1; i <= cols; ++i)
+
+    // keep the contents, the blob is read only once
+    cache()[isForwardOnly() ? i : at() * colCount() + i] = v;
+    return v;
+}
+//-----------------------------------------------------------------------//
+// Replaces the BLOB ids left in the cached rows with their contents
+void QFBResult::readLazyBlobs()
+{
+    QSqlCachedResult::ValueCache &values = cache();
+    const int blobType = qMetaTypeId<IBPP::Blob>();
+
+    for (int i = 0; i < values.count(); ++i)
     {
+        if (values.at(i).userType() != blobType)
+            continue;
 
-        QSqlField f(QString::fromLatin1(rp->iSt->ColumnAlias(i)).simplified(),
-                    qIBPPTypeName(rp->iSt->ColumnType(i)));
-        f.setLength(rp->iSt->ColumnSize(i));
-        f.setPrecision(rp->iSt->ColumnScale(i));
-        f.setSqlType(rp->iSt->ColumnType(i));
-        rec.append(f);
+        IBPP::Blob l_Blob = values.at(i).value<IBPP::Blob>();
+        try
+        {
+            QFBStatisticsTimer timer(*rp->stats, BlobReadPhase);
+            values[i] = fromIBPPBlob(l_Blob);
+        }
+        catch (IBPP::Exception& e)
+        {
+            rp->setError("Unable to read blob", e, QSqlError::StatementError);
+            values[i] = QVariant(QVariant::ByteArray);
+        }
     }
-    return rec;
+}
+//-----------------------------------------------------------------------//
+QSqlRecord QFBResult::record() const
+{
+    if (!isActive())
+        return QSqlRecord();
+
+    return rp->plan.record;
 }
 //-----------------------------------------------------------------------//
 QVariant QFBResult::handle() const
@@ -920,6 +4648,192 @@ QVariant QFBResult::handle() const
 }
 //-----------------------------------------------------------------------//
 //-----------------------------------------------------------------------//
+struct QFBAsyncRequest
+{
+    QString query;
+    QVariantList values;
+    QFutureInterface<QSqlRecord> future;
+};
+//-----------------------------------------------------------------------//
+// I/O thread of QFBDriver::execAsync(). It runs the queued statements one
+// after the other on a connection of its own, so they are executed in the
+// order they were queued and never share IBPP objects with the caller.
+class QFBAsyncWorker : public QThread
+{
+public:
+    QFBAsyncWorker(QFBDriver *owner, const QFBOpenParams &params);
+    ~QFBAsyncWorker();
+
+    void enqueue(const QFBAsyncRequest &request);
+
+protected:
+    void run();
+
+private:
+    void execute(QFBDriver &driver, QFBAsyncRequest &request);
+    void finish(QFBAsyncRequest &request, const QSqlError &error, int numRowsAffected);
+
+    QFBDriver *owner;
+    const QFBOpenParams params;
+
+    QMutex mutex;
+    QWaitCondition queued;
+    QList<QFBAsyncRequest> queue;
+    bool stopping;
+    QFBDriver *connection;                  // of run(), cancelled on shutdown
+    QFutureInterface<QSqlRecord> current;   // request run() executes
+};
+//-----------------------------------------------------------------------//
+static const int asyncBatchRows = 256;
+//-----------------------------------------------------------------------//
+QFBAsyncWorker::QFBAsyncWorker(QFBDriver *owner, const QFBOpenParams &params)
+    : owner(owner), params(params), stopping(false), connection(0)
+{
+}
+//-----------------------------------------------------------------------//
+// Fails the statements still queued and cancels the running one on the
+// server. A cancel only reaches a call in flight, so it is repeated until
+// the thread is done.
+QFBAsyncWorker::~QFBAsyncWorker()
+{
+    QList<QFBAsyncRequest> pending;
+    {
+        QMutexLocker locker(&mutex);
+        stopping = true;
+        pending = queue;
+        queue.clear();
+        queued.wakeAll();
+        current.cancel();
+    }
+
+    const QSqlError closed(QLatin1String("Connection closed"), QString(), QSqlError::ConnectionError);
+    for (int i = 0; i < pending.count(); ++i)
+        finish(pending[i], closed, -1);
+
+    while (!wait(100))
+    {
+        QMutexLocker locker(&mutex);
+        if (connection)
+            connection->cancel();
+    }
+}
+//-----------------------------------------------------------------------//
+void QFBAsyncWorker::enqueue(const QFBAsyncRequest &request)
+{
+    QMutexLocker locker(&mutex);
+    queue.append(request);
+    queued.wakeOne();
+}
+//-----------------------------------------------------------------------//
+void QFBAsyncWorker::run()
+{
+    QFBDriver driver;
+    bool opened = false;
+
+    {
+        QMutexLocker locker(&mutex);
+        connection = &driver;
+    }
+
+    forever
+    {
+        QFBAsyncRequest request;
+        {
+            QMutexLocker locker(&mutex);
+            while (queue.isEmpty() && !stopping)
+                queued.wait(&mutex);
+            if (stopping)
+                break;
+            request = queue.takeFirst();
+            current = request.future;
+        }
+
+        if (request.future.isCanceled())
+        {
+            finish(request, QSqlError(QLatin1String("Statement canceled"), QString(),
+                                      QSqlError::StatementError), -1);
+            continue;
+        }
+
+        if (!opened)
+            opened = driver.open(params.db, params.user, params.password,
+                                 params.host, params.port, params.connOpts);
+        if (!opened)
+        {
+            finish(request, driver.lastError(), -1);
+            continue;
+        }
+
+        execute(driver, request);
+    }
+
+    {
+        QMutexLocker locker(&mutex);
+        connection = 0;
+        current = QFutureInterface<QSqlRecord>();
+    }
+    driver.close();
+}
+//-----------------------------------------------------------------------//
+void QFBAsyncWorker::execute(QFBDriver &driver, QFBAsyncRequest &request)
+{
+    QSqlQuery query(driver.createResult());
+    query.setForwardOnly(true);
+
+    bool ok = query.prepare(request.query);
+    if (ok)
+    {
+        for (int i = 0; i < request.values.count(); ++i)
+            query.addBindValue(request.values.at(i));
+        ok = query.exec();
+    }
+
+    if (!ok)
+    {
+        finish(request, query.lastError(), -1);
+        return;
+    }
+
+    if (!query.isSelect())
+    {
+        finish(request, QSqlError(), query.numRowsAffected());
+        return;
+    }
+
+    // rows go to the future in batches, QFutureWatcher::resultsReadyAt()
+    // tells the caller about them while the rest is still being fetched.
+    // A canceled future stops the fetch before the next row.
+    QVector<QSqlRecord> rows;
+    rows.reserve(asyncBatchRows);
+    while (!request.future.isCanceled() && query.next())
+    {
+        rows.append(query.record());
+        if (rows.count() == asyncBatchRows)
+        {
+            request.future.reportResults(rows);
+            rows.clear();
+        }
+    }
+    if (!rows.isEmpty())
+        request.future.reportResults(rows);
+
+    // a select stopped by cancel() or on shutdown did not deliver all rows
+    QSqlError error = query.lastError();
+    if (!error.isValid() && request.future.isCanceled())
+        error = QSqlError(QLatin1String("Statement canceled"), QString(), QSqlError::StatementError);
+    finish(request, error, -1);
+}
+//-----------------------------------------------------------------------//
+void QFBAsyncWorker::finish(QFBAsyncRequest &request, const QSqlError &error, int numRowsAffected)
+{
+    if (error.isValid())
+        request.future.reportCanceled();
+    request.future.reportFinished();
+
+    emit owner->asyncExecuted(request.future.future(), error, numRowsAffected);
+}
+//-----------------------------------------------------------------------//
+//-----------------------------------------------------------------------//
 QFBDriver::QFBDriver(QObject * parent)
     : QSqlDriver(parent)
 {
@@ -931,12 +4845,17 @@ QFBDriver::QFBDriver(void *connection, QObject *parent)
 {
     dp = new QFBDriverPrivate(this);
     dp->iDb=(IBPP::IDatabase*)connection;
+    dp->updateCancelHandle();
     setOpen(true);
     setOpenError(false);
 }
 //-----------------------------------------------------------------------//
 QFBDriver::~QFBDriver()
 {
+    delete dp->asyncWorker;
+
+    if (!dp->poolKey.isEmpty())
+        close();    // hand the attachment back
     delete dp;
 }
 //-----------------------------------------------------------------------//
@@ -947,8 +4866,11 @@ bool QFBDriver::hasFeature(DriverFeature f) const
     case Transactions:
     case PreparedQueries:
     case PositionalPlaceholders:
+    case NamedPlaceholders:
     case Unicode:
     case BLOB:
+    case BatchOperations:
+    case EventNotifications:
         return true;
     default:
         return false;
@@ -960,12 +4882,26 @@ bool QFBDriver::open(const QString & db,
                      const QString & user,
                      const QString & password,
                      const QString & host,
-                     int /*port*/,
+                     int port,
                      const QString & connOpts )
 {
 
     QString charSet = QLatin1String("NONE");
     QString role = QLatin1String("");
+    int stmtCacheSize = 0;
+    bool lazyBlobs = false;
+    bool pooled = false;
+    QFBPoolSettings poolSettings;
+    bool sharedReads = false;
+    int readRefresh = 60;
+    int statementTimeout = 0;
+    int eventInterval = 100;
+    bool metadataCache = false;
+    int metadataTtl = 0;
+    QString schemaSnapshot;
+    bool statistics = false;
+    int slowQueryMs = 0;
+    QString slowQueryLog;
 
     // Set connection attributes
     const QStringList opts(connOpts.split(QLatin1Char(';'), QString::SkipEmptyParts));
@@ -975,21 +4911,169 @@ bool QFBDriver::open(const QString & db,
         int idx;
         if ((idx = tmp.indexOf(QLatin1Char('='))) == -1)
         {
-            qWarning("QFBDriver::open: Illegal connect option value '%s'",
-                     tmp.toLocal8Bit().constData());
-            continue;
+            qWarning("QFBDriver::open: Illegal connect option value '%s'",
+                     tmp.toLocal8Bit().constData());
+            continue;
+        }
+
+        const QString opt(tmp.left(idx));
+        const QString val(tmp.mid(idx + 1).simplified());
+
+        if (opt == QLatin1String("CHARSET"))
+        {
+            charSet = val.toUpper();
+        }
+        else if (opt == QLatin1String("ROLE"))
+        {
+            role = val;
+        }
+        else if (opt == QLatin1String("STMT_CACHE_SIZE"))
+        {
+            bool ok;
+            stmtCacheSize = val.toInt(&ok);
+            if (!ok || stmtCacheSize < 0)
+            {
+                qWarning("QFBDriver::open: Illegal STMT_CACHE_SIZE value '%s'",
+                         val.toLocal8Bit().constData());
+                stmtCacheSize = 0;
+            }
+        }
+        else if (opt == QLatin1String("BLOB_MODE"))
+        {
+            if (val.toUpper() == QLatin1String("LAZY"))
+                lazyBlobs = true;
+            else if (val.toUpper() == QLatin1String("EAGER"))
+                lazyBlobs = false;
+            else
+                qWarning("QFBDriver::open: Unknown BLOB_MODE value '%s'",
+                         val.toLocal8Bit().constData());
+        }
+        else if (opt == QLatin1String("POOL"))
+        {
+            if (val.toUpper() == QLatin1String("ON"))
+                pooled = true;
+            else if (val.toUpper() == QLatin1String("OFF"))
+                pooled = false;
+            else
+                qWarning("QFBDriver::open: Unknown POOL value '%s'",
+                         val.toLocal8Bit().constData());
+        }
+        else if (opt == QLatin1String("POOL_MIN") ||
+                 opt == QLatin1String("POOL_MAX") ||
+                 opt == QLatin1String("POOL_IDLE_TIMEOUT") ||
+                 opt == QLatin1String("POOL_WAIT_TIMEOUT"))
+        {
+            bool ok;
+            int v = val.toInt(&ok);
+            if (!ok || v < 0 || (v == 0 && opt == QLatin1String("POOL_MAX")))
+                qWarning("QFBDriver::open: Illegal %s value '%s'",
+                         opt.toLocal8Bit().constData(), val.toLocal8Bit().constData());
+            else if (opt == QLatin1String("POOL_MIN"))
+                poolSettings.minSize = v;
+            else if (opt == QLatin1String("POOL_MAX"))
+                poolSettings.maxSize = v;
+            else if (opt == QLatin1String("POOL_IDLE_TIMEOUT"))
+                poolSettings.idleTimeout = v;
+            else
+                poolSettings.waitTimeout = v;
+        }
+        else if (opt == QLatin1String("POOL_VALIDATION_QUERY"))
+        {
+            poolSettings.validationQuery = val.toStdString();
+        }
+        else if (opt == QLatin1String("READ_TRANSACTION"))
+        {
+            if (val.toUpper() == QLatin1String("SHARED"))
+                sharedReads = true;
+            else if (val.toUpper() == QLatin1String("LOCAL"))
+                sharedReads = false;
+            else
+                qWarning("QFBDriver::open: Unknown READ_TRANSACTION value '%s'",
+                         val.toLocal8Bit().constData());
+        }
+        else if (opt == QLatin1String("STATEMENT_TIMEOUT"))
+        {
+            bool ok;
+            statementTimeout = val.toInt(&ok);
+            if (!ok || statementTimeout < 0)
+            {
+                qWarning("QFBDriver::open: Illegal STATEMENT_TIMEOUT value '%s'",
+                         val.toLocal8Bit().constData());
+                statementTimeout = 0;
+            }
+        }
+        else if (opt == QLatin1String("EVENT_INTERVAL"))
+        {
+            bool ok;
+            eventInterval = val.toInt(&ok);
+            if (!ok || eventInterval <= 0)
+            {
+                qWarning("QFBDriver::open: Illegal EVENT_INTERVAL value '%s'",
+                         val.toLocal8Bit().constData());
+                eventInterval = 100;
+            }
+        }
+        else if (opt == QLatin1String("METADATA_CACHE"))
+        {
+            if (val.toUpper() == QLatin1String("ON"))
+                metadataCache = true;
+            else if (val.toUpper() == QLatin1String("OFF"))
+                metadataCache = false;
+            else
+                qWarning("QFBDriver::open: Unknown METADATA_CACHE value '%s'",
+                         val.toLocal8Bit().constData());
+        }
+        else if (opt == QLatin1String("STATISTICS"))
+        {
+            if (val.toUpper() == QLatin1String("ON"))
+                statistics = true;
+            else if (val.toUpper() == QLatin1String("OFF"))
+                statistics = false;
+            else
+                qWarning("QFBDriver::open: Unknown STATISTICS value '%s'",
+                         val.toLocal8Bit().constData());
         }
-
-        const QString opt(tmp.left(idx));
-        const QString val(tmp.mid(idx + 1).simplified());
-
-        if (opt == QLatin1String("CHARSET"))
+        else if (opt == QLatin1String("SLOW_QUERY_MS"))
         {
-            charSet = val.toUpper();
+            bool ok;
+            slowQueryMs = val.toInt(&ok);
+            if (!ok || slowQueryMs < 0)
+            {
+                qWarning("QFBDriver::open: Illegal SLOW_QUERY_MS value '%s'",
+                         val.toLocal8Bit().constData());
+                slowQueryMs = 0;
+            }
         }
-        else if (opt == QLatin1String("ROLE"))
+        else if (opt == QLatin1String("SLOW_QUERY_LOG"))
         {
-            role = val;
+            slowQueryLog = tmp.mid(idx + 1).trimmed();
+        }
+        else if (opt == QLatin1String("SCHEMA_SNAPSHOT"))
+        {
+            // a path, keep inner spaces
+            schemaSnapshot = tmp.mid(idx + 1).trimmed();
+        }
+        else if (opt == QLatin1String("METADATA_TTL"))
+        {
+            bool ok;
+            metadataTtl = val.toInt(&ok);
+            if (!ok || metadataTtl < 0)
+            {
+                qWarning("QFBDriver::open: Illegal METADATA_TTL value '%s'",
+                         val.toLocal8Bit().constData());
+                metadataTtl = 0;
+            }
+        }
+        else if (opt == QLatin1String("READ_TRANSACTION_REFRESH"))
+        {
+            bool ok;
+            readRefresh = val.toInt(&ok);
+            if (!ok || readRefresh < 0)
+            {
+                qWarning("QFBDriver::open: Illegal READ_TRANSACTION_REFRESH value '%s'",
+                         val.toLocal8Bit().constData());
+                readRefresh = 60;
+            }
         }
         else
         {
@@ -1007,6 +5091,13 @@ bool QFBDriver::open(const QString & db,
     if (isOpen())
         close();
 
+    dp->openParams.db = db;
+    dp->openParams.user = user;
+    dp->openParams.password = password;
+    dp->openParams.host = host;
+    dp->openParams.port = port;
+    dp->openParams.connOpts = connOpts;
+
 //    set textCodec
     QByteArray codecName;
     if (charSet == QLatin1String("ASCII"))
@@ -1087,18 +5178,54 @@ bool QFBDriver::open(const QString & db,
     if (!dp->textCodec)
         dp->textCodec = QTextCodec::codecForLocale(); //if unknown set locale
 
+    if (charSet == QLatin1String("UTF8") || charSet == QLatin1String("UNICODE_FSS"))
+        dp->stringDecoding = Utf8Strings;
+    else if (charSet == QLatin1String("ASCII"))
+        dp->stringDecoding = Latin1Strings;
+    else if (charSet == QLatin1String("NONE"))
+        dp->stringDecoding = AsciiStrings;
+    else
+        dp->stringDecoding = CodecStrings;
+
+    if (poolSettings.minSize > poolSettings.maxSize)
+        poolSettings.minSize = poolSettings.maxSize;
+
     try
     {
-        dp->iDb=IBPP::DatabaseFactory(host.toStdString(),
-                                      db.toStdString(),
-                                      user.toStdString(),
-                                      password.toStdString(),
-                                      role.toStdString(),
-                                      charSet.toStdString(),
-                                      "");
+        if (pooled)
+        {
+            QFBAttachParams params;
+            params.host = host.toStdString();
+            params.db = db.toStdString();
+            params.user = user.toStdString();
+            params.password = password.toStdString();
+            params.role = role.toStdString();
+            params.charSet = charSet.toStdString();
 
-        dp->iDb->Connect();
+            const QByteArray key = QFBConnectionPool::key(params);
+            dp->iDb = connectionPool()->acquire(key, params, poolSettings, &dp->poolWaitTime);
+            if (dp->iDb == 0)
+            {
+                setOpenError(true);
+                setLastError(QSqlError(QLatin1String("Unable to connect"),
+                                       QLatin1String("No pooled connection got free in time"),
+                                       QSqlError::ConnectionError));
+                return false;
+            }
+            dp->poolKey = key;
+        }
+        else
+        {
+            dp->iDb=IBPP::DatabaseFactory(host.toStdString(),
+                                          db.toStdString(),
+                                          user.toStdString(),
+                                          password.toStdString(),
+                                          role.toStdString(),
+                                          charSet.toStdString(),
+                                          "");
 
+            dp->iDb->Connect();
+        }
     }
     catch (IBPP::Exception& e)
     {
@@ -1107,6 +5234,21 @@ bool QFBDriver::open(const QString & db,
         return false;
     }
 
+    dp->stmtCache.setMaxSize(stmtCacheSize);
+    dp->lazyBlobs = lazyBlobs;
+    dp->sharedReads = sharedReads;
+    dp->readRefresh = readRefresh;
+    dp->statementTimeout = statementTimeout;
+    dp->eventInterval = eventInterval;
+    dp->metadataCache = metadataCache || !schemaSnapshot.isEmpty();
+    dp->metadataTtl = metadataTtl;
+    dp->snapshotPath = schemaSnapshot;
+    dp->stats.enabled = statistics;
+    dp->slowQueryMs = slowQueryMs;
+    dp->slowQueryLog = slowQueryLog;
+    dp->snapshotKey = host + QLatin1Char(':') + db + QLatin1Char('/') + charSet;
+    dp->updateCancelHandle();
+
     setOpen(true);
     return true;
 }
@@ -1119,6 +5261,62 @@ void QFBDriver::close()
     if (dp->iL.count())
         qWarning("QFBDriver::close : %d transaction still sarted ! Rollback all.",dp->iL.count());
 
+    delete dp->asyncWorker;
+    dp->asyncWorker = 0;
+
+    {
+        QMutexLocker locker(&dp->cancelMutex);
+        dp->cancelHandle = 0;
+    }
+
+    if (dp->eventTimer)
+    {
+        killTimer(dp->eventTimer);
+        dp->eventTimer = 0;
+    }
+    dp->eventNames.clear();
+    dp->eventHandler.fired.clear();
+    dp->iEv.clear();
+
+    dp->invalidateMetadata();
+    dp->metadataDirty = false;
+
+    dp->readLazyBlobs(0);
+    dp->stmtCache.clear();
+    dp->spareHandles.clear();
+
+    if (dp->readTr != 0)
+    {
+        try
+        {
+            if (dp->readTr->Started())
+                dp->readTr->Commit();
+        }
+        catch (IBPP::Exception& e)
+        {
+            Q_UNUSED(e);
+        }
+        dp->readTr.clear();
+        dp->readCursors = 0;
+    }
+
+    if (!dp->poolKey.isEmpty())
+    {
+        dp->iTr.clear();
+        dp->iL.clear();
+
+        // the pool takes the driver's reference; an attachment results
+        // still refer to must not reach another thread
+        IBPP::Database db = dp->iDb;
+        dp->iDb.clear();
+        connectionPool()->release(dp->poolKey, db, dp->dbUsers > 0);
+        dp->dbUsers = 0;
+        dp->poolKey.clear();
+        setOpen(false);
+        setOpenError(false);
+        return;
+    }
+
     try
     {
         dp->iDb->Disconnect();
@@ -1128,6 +5326,7 @@ void QFBDriver::close()
         dp->setError("Unable to disconnect", e, QSqlError::ConnectionError);
         return;
     }
+    dp->dbUsers = 0;
     setOpen(false);
     setOpenError(false);
 }
@@ -1152,6 +5351,7 @@ bool QFBDriver::beginTransaction()
     {
         dp->checkTransactionArguments();
         dp->iTr = IBPP::TransactionFactory(dp->iDb, dp->tam, dp->til, dp->tlr, dp->tff);
+        QFBStatisticsTimer timer(dp->stats, StartPhase);
         dp->iTr->Start();
     }
     catch (IBPP::Exception& e)
@@ -1175,8 +5375,11 @@ bool QFBDriver::commitTransaction()
     if (dp->iTr == 0)
         return false;
 
+    dp->readLazyBlobs(dp->iTr.intf());
+
     try
     {
+        QFBStatisticsTimer timer(dp->stats, CommitPhase);
         dp->iTr->Commit();
     }
     catch (IBPP::Exception& e)
@@ -1185,6 +5388,12 @@ bool QFBDriver::commitTransaction()
         return false;
     }
 
+    if (dp->metadataDirty)
+    {
+        dp->invalidateMetadata();
+        dp->metadataDirty = false;
+    }
+    dp->stmtCache.purge(dp->iTr.intf());
     dp->iTr.clear();
     dp->iL.removeLast ();
     if (!dp->iL.isEmpty())
@@ -1202,8 +5411,11 @@ bool QFBDriver::rollbackTransaction()
     if (dp->iTr == 0)
         return false;
 
+    dp->readLazyBlobs(dp->iTr.intf());
+
     try
     {
+        QFBStatisticsTimer timer(dp->stats, RollbackPhase);
         dp->iTr->Rollback();
     }
     catch (IBPP::Exception& e)
@@ -1212,6 +5424,12 @@ bool QFBDriver::rollbackTransaction()
         return false;
     }
 
+    if (dp->metadataDirty)
+    {
+        dp->invalidateMetadata();
+        dp->metadataDirty = false;
+    }
+    dp->stmtCache.purge(dp->iTr.intf());
     dp->iTr.clear();
     dp->iL.removeLast ();
     if (!dp->iL.isEmpty())
@@ -1251,6 +5469,27 @@ QStringList QFBDriver::tables(QSql::TableType type) const
     if (!typeFilter.isEmpty())
         typeFilter.prepend(QLatin1String("where "));
 
+    if (dp->metadataCache && dp->loadMetadata())
+    {
+        // same selection as typeFilter
+        for (int i = 0; i < dp->relationNames.count(); ++i)
+        {
+            const QFBRelationInfo &info = dp->relations[dp->relationNames.at(i)];
+            bool match;
+            if (type == QSql::SystemTables)
+                match = info.system;
+            else if (type == (QSql::SystemTables | QSql::Views))
+                match = info.system || info.view;
+            else
+                match = ((type & QSql::SystemTables) || !info.system) &&
+                        ((type & QSql::Views) || !info.view) &&
+                        ((type & QSql::Tables) || info.view);
+            if (match)
+                res << info.name;
+        }
+        return res;
+    }
+
     QSqlQuery q(createResult());
     q.setForwardOnly(true);
     if (!q.exec(QLatin1String("select rdb$relation_name from rdb$relations ") + typeFilter))
@@ -1261,33 +5500,40 @@ QStringList QFBDriver::tables(QSql::TableType type) const
     return res;
 }
 //-----------------------------------------------------------------------//
+// Name of a table or column as the catalog keeps it: a quoted name as it
+// is, others in upper case
+static QString qCatalogName(const QString &name)
+{
+    QString s = name.trimmed();
+    if (s.size() > 1 && s.at(0) == QLatin1Char('"') && s.at(s.size() - 1) == QLatin1Char('"'))
+        return s.mid(1, s.size() - 2).replace(QLatin1String("\"\""), QLatin1String("\""));
+    return s.toUpper();
+}
+//-----------------------------------------------------------------------//
 QSqlRecord QFBDriver::record(const QString& tablename) const
 {
     QSqlRecord rec;
     if (!isOpen())
         return rec;
 
+    const QString relation = qCatalogName(tablename);
+    if (dp->metadataCache && dp->loadMetadata())
+        return dp->relations.value(relation).record;
+
     QSqlQuery q(createResult());
     q.setForwardOnly(true);
 
-    q.exec(QLatin1String("SELECT a.RDB$FIELD_NAME, b.RDB$FIELD_TYPE, b.RDB$FIELD_LENGTH, "
-                         "b.RDB$FIELD_SCALE, b.RDB$FIELD_PRECISION, a.RDB$NULL_FLAG "
-                         "FROM RDB$RELATION_FIELDS a, RDB$FIELDS b "
-                         "WHERE b.RDB$FIELD_NAME = a.RDB$FIELD_SOURCE "
-                         "AND a.RDB$RELATION_NAME = '") + tablename.toUpper() + QLatin1String("' "
-                                 "ORDER BY a.RDB$FIELD_POSITION"));
+    q.prepare(QLatin1String("SELECT a.RDB$FIELD_NAME, b.RDB$FIELD_TYPE, b.RDB$FIELD_LENGTH, "
+                            "b.RDB$FIELD_SCALE, b.RDB$FIELD_PRECISION, a.RDB$NULL_FLAG "
+                            "FROM RDB$RELATION_FIELDS a, RDB$FIELDS b "
+                            "WHERE b.RDB$FIELD_NAME = a.RDB$FIELD_SOURCE "
+                            "AND a.RDB$RELATION_NAME = ? "
+                            "ORDER BY a.RDB$FIELD_POSITION"));
+    q.addBindValue(relation);
+    q.exec();
 
     while (q.next())
-    {
-        int type = q.value(1).toInt();
-        QSqlField f(q.value(0).toString().simplified(), qIBaseTypeName(type));
-        f.setLength(q.value(2).toInt()); // ?????????
-        f.setPrecision(qAbs(q.value(3).toInt()));
-        f.setRequired(q.value(5).toInt() > 0 ? true : false);
-        f.setSqlType(type);
-
-        rec.append(f);
-    }
+        rec.append(qRelationField(q, 0));
     return rec;
 }
 //-----------------------------------------------------------------------//
@@ -1297,22 +5543,39 @@ QSqlIndex QFBDriver::primaryIndex(const QString &table) const
     if (!isOpen())
         return index;
 
+    const QString relation = qCatalogName(table);
+    if (dp->metadataCache && dp->loadMetadata())
+    {
+        if (!dp->relations.contains(relation))
+            return index;
+
+        const QSqlIndex &cached = dp->relations[relation].primaryIndex;
+        for (int i = 0; i < cached.count(); ++i)
+            index.append(cached.field(i), cached.isDescending(i));
+        index.setName(cached.name());
+        return index;
+    }
+
     QSqlQuery q(createResult());
     q.setForwardOnly(true);
-    q.exec(QLatin1String("SELECT a.RDB$INDEX_NAME, b.RDB$FIELD_NAME, d.RDB$FIELD_TYPE "
-                         "FROM RDB$RELATION_CONSTRAINTS a, RDB$INDEX_SEGMENTS b, RDB$RELATION_FIELDS c, RDB$FIELDS d "
-                         "WHERE a.RDB$CONSTRAINT_TYPE = 'PRIMARY KEY' "
-                         "AND a.RDB$RELATION_NAME = '") + table.toUpper() +
-           QLatin1String(" 'AND a.RDB$INDEX_NAME = b.RDB$INDEX_NAME "
-                         "AND c.RDB$RELATION_NAME = a.RDB$RELATION_NAME "
-                         "AND c.RDB$FIELD_NAME = b.RDB$FIELD_NAME "
-                         "AND d.RDB$FIELD_NAME = c.RDB$FIELD_SOURCE "
-                         "ORDER BY b.RDB$FIELD_POSITION"));
+    q.prepare(QLatin1String("SELECT a.RDB$INDEX_NAME, b.RDB$FIELD_NAME, d.RDB$FIELD_TYPE, e.RDB$INDEX_TYPE "
+                            "FROM RDB$RELATION_CONSTRAINTS a, RDB$INDEX_SEGMENTS b, RDB$RELATION_FIELDS c, RDB$FIELDS d, "
+                            "RDB$INDICES e "
+                            "WHERE a.RDB$CONSTRAINT_TYPE = 'PRIMARY KEY' "
+                            "AND a.RDB$RELATION_NAME = ? "
+                            "AND a.RDB$INDEX_NAME = b.RDB$INDEX_NAME "
+                            "AND e.RDB$INDEX_NAME = a.RDB$INDEX_NAME "
+                            "AND c.RDB$RELATION_NAME = a.RDB$RELATION_NAME "
+                            "AND c.RDB$FIELD_NAME = b.RDB$FIELD_NAME "
+                            "AND d.RDB$FIELD_NAME = c.RDB$FIELD_SOURCE "
+                            "ORDER BY b.RDB$FIELD_POSITION"));
+    q.addBindValue(relation);
+    q.exec();
 
     while (q.next())
     {
         QSqlField field(q.value(1).toString().simplified(), qIBaseTypeName(q.value(2).toInt()));
-        index.append(field); //TODO: asc? desc?
+        index.append(field, q.value(3).toInt() == 1);  // RDB$INDEX_TYPE 1: descending
         index.setName(q.value(0).toString());
     }
 
@@ -1361,3 +5624,424 @@ QVariant QFBDriver::handle() const
     return QVariant();
 }
 //-----------------------------------------------------------------------//
+int QFBDriver::fetchRowBlock(const QSqlResult *result, QFBRowBlock *block, int maxRows)
+{
+    const QFBResult *r = dynamic_cast<const QFBResult *>(result);
+    if (!r || !block)
+        return -1;
+
+    return r->rp->fetchBlock(*block, maxRows);
+}
+//-----------------------------------------------------------------------//
+// Limits of one bulk EXECUTE BLOCK. A Firebird 2.x request has at most 255
+// contexts, one per INSERT, and at most 64 KB of statement text and of
+// input message; the parameter count leaves room for the block's BLR.
+static const int maxBulkRows = 250;
+static const int maxBulkParams = 1000;
+static const int maxBulkText = 64 * 1024 - 1;
+static const int maxBulkMessage = 64 * 1024 - 1;
+//-----------------------------------------------------------------------//
+// Catalog name as a quoted identifier, which keeps its case
+static QString qQuotedName(const QString &catalogName)
+{
+    QString s = catalogName;
+    return QLatin1Char('"') + s.replace(QLatin1Char('"'), QLatin1String("\"\"")) + QLatin1Char('"');
+}
+//-----------------------------------------------------------------------//
+// Input parameters and INSERT of row r of a bulk EXECUTE BLOCK, the values
+// of the row are the parameters P<r * columns> and up
+static void qAppendBulkRow(QString &params, QString &body, const QString &table,
+                           const QStringList &columns, int r)
+{
+    QString values;
+    for (int c = 0; c < columns.count(); ++c)
+    {
+        const QString p = QLatin1Char('P') + QString::number(r * columns.count() + c);
+        if (!params.isEmpty())
+            params += QLatin1String(", ");
+        params += p + QLatin1String(" TYPE OF COLUMN ") + table + QLatin1Char('.') +
+                  columns.at(c) + QLatin1String(" = ?");
+        if (c)
+            values += QLatin1String(", ");
+        values += QLatin1Char(':') + p;
+    }
+    body += QLatin1String("INSERT INTO ") + table + QLatin1String(" (") +
+            columns.join(QLatin1String(", ")) + QLatin1String(") VALUES (") + values + QLatin1String(");\n");
+}
+//-----------------------------------------------------------------------//
+static QString qBulkStatement(const QString &table, const QStringList &columns, int rows)
+{
+    QString params, body;
+    for (int r = 0; r < rows; ++r)
+        qAppendBulkRow(params, body, table, columns, r);
+    return QLatin1String("EXECUTE BLOCK (") + params + QLatin1String(")\nAS BEGIN\n") +
+           body + QLatin1String("END");
+}
+//-----------------------------------------------------------------------//
+// Inserts the rows of source with EXECUTE BLOCK statements of as many rows
+// as the limits allow, see qFBBulkInsert(). A statement is prepared once
+// per row count; there are at most three of them, for full statements,
+// the last one of a chunk and the last one of the rows. Chunks are
+// committed with CommitRetain(), which keeps the statements prepared.
+QVariantMap QFBDriver::bulkInsert(const QString &table, const QStringList &columns,
+                                  QFBRowSource *source, int commitRows)
+{
+    QVariantMap stat;
+    if (!isOpen() || isOpenError() || !source)
+        return stat;
+
+    if (columns.isEmpty())
+    {
+        qWarning("QFBDriver::bulkInsert: No columns given");
+        return stat;
+    }
+
+    if (commitRows <= 0)
+    {
+        qWarning("QFBDriver::bulkInsert: Illegal commitRows value %d", commitRows);
+        commitRows = 10000;
+    }
+
+    // bytes of a row in the input message: value, VARCHAR length, NULL
+    // indicator and alignment
+    const QSqlRecord rec = record(table);
+    const QString quotedTable = qQuotedName(qCatalogName(table));
+    QStringList quotedColumns;
+    const int cols = columns.count();
+    int rowBytes = 0;
+    for (int c = 0; c < cols; ++c)
+    {
+        const QString columnName = qCatalogName(columns.at(c));
+        quotedColumns << qQuotedName(columnName);
+        const int idx = rec.indexOf(columnName);
+        if (idx < 0)
+        {
+            qWarning("QFBDriver::bulkInsert: Unknown column '%s' of table '%s'",
+                     columns.at(c).toLocal8Bit().constData(), table.toLocal8Bit().constData());
+            setLastError(QSqlError(QLatin1String("Unknown column ") + columns.at(c),
+                                   QString(), QSqlError::StatementError));
+            stat[QLatin1String("error")] = lastError().text();
+            return stat;
+        }
+        rowBytes += rec.field(idx).length() + 12;
+    }
+
+    // text of a row with the widest parameter numbers
+    QString params, body;
+    qAppendBulkRow(params, body, quotedTable, quotedColumns, maxBulkParams / cols);
+    const int rowText = int(toIBPPStr(params + body, dp->textCodec).size()) + 2 * cols;
+
+    int blockRows = qMin(maxBulkRows, maxBulkParams / cols);
+    blockRows = qMin(blockRows, maxBulkMessage / rowBytes);
+    blockRows = qMin(blockRows, (maxBulkText - 64) / rowText);
+    blockRows = qMax(blockRows, 1);
+
+    // inside of a transaction of the caller the rows are left to it
+    const bool ownTransaction = dp->iTr == 0 || !dp->iTr->Started();
+
+    QMap<int, QFBResult *> statements;  // by rows per statement
+    QVariantList row;
+    int rows = 0, committed = 0, chunkRows = 0, executions = 0, commits = 0;
+    bool begun = false, more = true, ok = true;
+
+    QFBStopwatch watch;
+    watch.start();
+    while (ok && more)
+    {
+        if (ownTransaction && !begun)
+        {
+            if (!(ok = beginTransaction()))
+                break;
+            begun = true;
+        }
+
+        // rows of the next statement, which ends at a commit
+        const int limit = ownTransaction ? qMin(blockRows, commitRows - chunkRows) : blockRows;
+        QVector<QVariant> values;
+        values.reserve(limit * cols);
+        int n = 0;
+        while (n < limit && (more = source->next(row)))
+        {
+            if (row.count() != cols)
+            {
+                qWarning("QFBDriver::bulkInsert: Row %d has %d values, %d expected",
+                         rows + n + 1, row.count(), cols);
+                setLastError(QSqlError(QLatin1String("Wrong number of values in row ") +
+                                       QString::number(rows + n + 1), QString(), QSqlError::StatementError));
+                ok = false;
+                break;
+            }
+            for (int c = 0; c < cols; ++c)
+                values.append(row.at(c));
+            ++n;
+        }
+
+        if (ok && n > 0)
+        {
+            QFBResult *&r = statements[n];
+            if (!r)
+            {
+                r = new QFBResult(this, dp->textCodec);
+                ok = r->prepare(qBulkStatement(quotedTable, quotedColumns, n));
+            }
+            if (ok)
+            {
+                for (int k = 0; k < values.count(); ++k)
+                    r->bindValue(k, values.at(k), QSql::In);
+                ok = r->exec();
+            }
+
+            if (ok)
+            {
+                rows += n;
+                chunkRows += n;
+                ++executions;
+            }
+            else
+                setLastError(r->lastError());
+        }
+
+        if (ok && begun && (chunkRows >= commitRows || !more))
+        {
+            if (more)
+            {
+                try
+                {
+                    QFBStatisticsTimer timer(dp->stats, CommitPhase);
+                    dp->iTr->CommitRetain();
+                }
+                catch (IBPP::Exception& e)
+                {
+                    dp->setError("Unable to commit transaction", e, QSqlError::TransactionError);
+                    ok = false;
+                }
+            }
+            else
+            {
+                begun = false;
+                ok = commitTransaction();
+            }
+
+            if (ok)
+            {
+                committed = rows;
+                chunkRows = 0;
+                ++commits;
+            }
+        }
+    }
+
+    if (begun)
+        rollbackTransaction();
+    qDeleteAll(statements);
+
+    const double seconds = watch.usecs() / 1000000.0;
+    if (!ok && ownTransaction)
+        rows = committed;
+
+    stat[QLatin1String("rows")] = rows;
+    stat[QLatin1String("statements")] = executions;
+    stat[QLatin1String("rowsPerStatement")] = blockRows;
+    stat[QLatin1String("commits")] = commits;
+    stat[QLatin1String("seconds")] = seconds;
+    stat[QLatin1String("rowsPerSecond")] = seconds > 0 ? rows / seconds : 0.0;
+    if (!ok)
+        stat[QLatin1String("error")] = lastError().text();
+    return stat;
+}
+//-----------------------------------------------------------------------//
+QVariantMap QFBDriver::statementCacheStatistics() const
+{
+    QVariantMap stat;
+    stat[QLatin1String("size")] = dp->stmtCache.count();
+    stat[QLatin1String("capacity")] = dp->stmtCache.maxSize;
+    stat[QLatin1String("hits")] = dp->stmtCache.hits;
+    stat[QLatin1String("misses")] = dp->stmtCache.misses;
+    stat[QLatin1String("evictions")] = dp->stmtCache.evictions;
+    return stat;
+}
+//-----------------------------------------------------------------------//
+// Queues query for the I/O thread of this driver and returns at once. The
+// future receives the rows of a select while they are fetched; it is
+// canceled if the statement fails, is canceled or the driver is closed
+// first, asyncExecuted() reports the error.
+// The I/O thread has an attachment of its own and runs each statement in
+// a transaction of its own: it does not see changes the caller has not
+// committed, and a rollback of the caller does not undo it. Canceling the
+// future stops a select before its next row, but does not interrupt an
+// execute or fetch the server is still working on; STATEMENT_TIMEOUT of
+// the connect options limits those.
+QFuture<QSqlRecord> QFBDriver::execAsync(const QString &query, const QVariantList &values)
+{
+    QFBAsyncRequest request;
+    request.query = query;
+    request.values = values;
+    request.future.reportStarted();
+
+    if (!isOpen() || isOpenError() || dp->openParams.db.isEmpty())
+    {
+        request.future.reportCanceled();
+        request.future.reportFinished();
+        return request.future.future();
+    }
+
+    if (!dp->asyncWorker)
+    {
+        qRegisterMetaType<QFuture<QSqlRecord> >("QFuture<QSqlRecord>");
+        qRegisterMetaType<QSqlError>("QSqlError");
+
+        dp->asyncWorker = new QFBAsyncWorker(this, dp->openParams);
+        dp->asyncWorker->start();
+    }
+    dp->asyncWorker->enqueue(request);
+
+    return request.future.future();
+}
+//-----------------------------------------------------------------------//
+// Cancels the statement running on this connection, callable from any
+// thread. The interrupted call fails with "Statement canceled".
+bool QFBDriver::cancel()
+{
+    return dp->cancelOperation();
+}
+//-----------------------------------------------------------------------//
+// Drops the cached catalog and the schema snapshot, for schema changes the
+// driver cannot see, e.g. by other connections or inside EXECUTE BLOCK
+void QFBDriver::invalidateMetadata()
+{
+    dp->invalidateMetadata();
+    if (!dp->snapshotPath.isEmpty())
+        QFile::remove(dp->snapshotPath);
+}
+//-----------------------------------------------------------------------//
+bool QFBDriver::subscribeToNotificationImplementation(const QString &name)
+{
+    if (!isOpen())
+    {
+        qWarning("QFBDriver::subscribeToNotificationImplementation: database not open.");
+        return false;
+    }
+
+    const std::string event = toIBPPStr(name, dp->textCodec);
+    const QByteArray key(event.data(), int(event.size()));
+    if (dp->eventNames.contains(key))
+    {
+        qWarning("QFBDriver::subscribeToNotificationImplementation: already subscribing to '%s'.",
+                 name.toLocal8Bit().constData());
+        return false;
+    }
+
+    try
+    {
+        if (dp->iEv == 0)
+            dp->iEv = IBPP::EventsFactory(dp->iDb);
+        dp->iEv->Add(event, &dp->eventHandler);
+    }
+    catch (IBPP::Exception& e)
+    {
+        dp->setError("Unable to subscribe to event notification", e, QSqlError::StatementError);
+        return false;
+    }
+
+    dp->eventNames.insert(key, name);
+    if (!dp->eventTimer)
+        dp->eventTimer = startTimer(dp->eventInterval);
+    return true;
+}
+//-----------------------------------------------------------------------//
+bool QFBDriver::unsubscribeFromNotificationImplementation(const QString &name)
+{
+    if (!isOpen())
+    {
+        qWarning("QFBDriver::unsubscribeFromNotificationImplementation: database not open.");
+        return false;
+    }
+
+    const std::string event = toIBPPStr(name, dp->textCodec);
+    const QByteArray key(event.data(), int(event.size()));
+    if (!dp->eventNames.contains(key))
+    {
+        qWarning("QFBDriver::unsubscribeFromNotificationImplementation: not subscribed to '%s'.",
+                 name.toLocal8Bit().constData());
+        return false;
+    }
+
+    try
+    {
+        dp->iEv->Drop(event);
+    }
+    catch (IBPP::Exception& e)
+    {
+        dp->setError("Unable to unsubscribe from event notification", e, QSqlError::StatementError);
+        return false;
+    }
+
+    dp->eventNames.remove(key);
+    dp->eventHandler.fired.removeAll(key);
+    if (dp->eventNames.isEmpty() && dp->eventTimer)
+    {
+        killTimer(dp->eventTimer);
+        dp->eventTimer = 0;
+    }
+    return true;
+}
+//-----------------------------------------------------------------------//
+QStringList QFBDriver::subscribedToNotificationsImplementation() const
+{
+    return dp->eventNames.values();
+}
+//-----------------------------------------------------------------------//
+// Event traps fire on a thread of the client library; IBPP hands them over
+// in Dispatch(), which runs every EVENT_INTERVAL milliseconds on the
+// driver's thread, so notification() is emitted on that thread.
+void QFBDriver::timerEvent(QTimerEvent *event)
+{
+    if (event->timerId() != dp->eventTimer)
+    {
+        QSqlDriver::timerEvent(event);
+        return;
+    }
+
+    try
+    {
+        dp->iEv->Dispatch();
+    }
+    catch (IBPP::Exception& e)
+    {
+        dp->setError("Unable to dispatch event notifications", e, QSqlError::ConnectionError);
+        return;
+    }
+
+    const QList<QByteArray> fired = dp->eventHandler.fired;
+    dp->eventHandler.fired.clear();
+    for (int i = 0; i < fired.count(); ++i)
+    {
+        // a slot may have unsubscribed in the meantime
+        if (dp->eventNames.contains(fired.at(i)))
+            emit notification(dp->eventNames.value(fired.at(i)));
+    }
+}
+//-----------------------------------------------------------------------//
+// Counters and latency histograms of STATISTICS=ON, per phase and per
+// normalized statement text; times are in microseconds. Safe to read from
+// any thread.
+QVariantMap QFBDriver::statistics() const
+{
+    return dp->stats.toMap();
+}
+//-----------------------------------------------------------------------//
+void QFBDriver::resetStatistics()
+{
+    dp->stats.reset();
+}
+//-----------------------------------------------------------------------//
+QVariantMap QFBDriver::connectionPoolStatistics() const
+{
+    if (dp->poolKey.isEmpty())
+        return QVariantMap();
+
+    QVariantMap stat = connectionPool()->statistics(dp->poolKey);
+    stat[QLatin1String("lastWaitTime")] = dp->poolWaitTime;
+    return stat;
+}
+//-----------------------------------------------------------------------//
@@ -28,17 +28,26 @@
 
 #include <QtSql/qsqlresult.h>
 #include <QtSql/qsqldriver.h>
+#include <QtCore/qvariant.h>
+#include <QtCore/qstringlist.h>
+#include <QtCore/qfuture.h>
+#include <QtSql/qsqlerror.h>
+#include <QtSql/qsqlrecord.h>
 #include "qsqlcachedresult_p.h"
+#include "qfbrowblock.h"
+#include "qfbbulkinsert.h"
 
 QT_BEGIN_HEADER
 class QFBDriverPrivate;
 class QFBResultPrivate;
+class QFBAsyncWorker;
 class QFBDriver;
 class QTextCodec;
 
 class QFBResult : public QSqlCachedResult
 {
     friend class QFBResultPrivate;
+    friend class QFBDriver;
 
 public:
     explicit QFBResult(const QFBDriver *db, QTextCodec *tc);
@@ -51,18 +60,30 @@ public:
 protected:
     bool gotoNext(QSqlCachedResult::ValueCache& row, int rowIdx);
     bool reset (const QString& query);
+    QVariant data(int i);
     int size();
     int numRowsAffected();
     QSqlRecord record() const;
+    void virtual_hook(int id, void *data);
 
 private:
+    bool execBatchValues();
+    QVector<QVariant> parameterValues();
+    void readLazyBlobs();
+
     QFBResultPrivate* rp;
 };
 
 class QFBDriver : public QSqlDriver
 {
+    Q_OBJECT
+    Q_PROPERTY(QVariantMap StatementCache READ statementCacheStatistics)
+    Q_PROPERTY(QVariantMap ConnectionPool READ connectionPoolStatistics)
+    Q_PROPERTY(QVariantMap Statistics READ statistics)
+
     friend class QFBDriverPrivate;
     friend class QFBResultPrivate;
+    friend class QFBAsyncWorker;
 public:
     explicit QFBDriver(QObject *parent = 0);
     explicit QFBDriver(void *connection, QObject *parent = 0);
@@ -93,6 +114,30 @@ public:
     QString formatValue(const QSqlField &field, bool trimStrings) const;
     QVariant handle() const;
 
+    QVariantMap statementCacheStatistics() const;
+    QVariantMap connectionPoolStatistics() const;
+    QVariantMap statistics() const;
+
+    Q_INVOKABLE int fetchRowBlock(const QSqlResult *result, QFBRowBlock *block, int maxRows);
+    Q_INVOKABLE QFuture<QSqlRecord> execAsync(const QString &query,
+                                              const QVariantList &values = QVariantList());
+    Q_INVOKABLE QVariantMap bulkInsert(const QString &table, const QStringList &columns,
+                                       QFBRowSource *source, int commitRows = 10000);
+
+public Q_SLOTS:
+    bool cancel();
+    void resetStatistics();
+    void invalidateMetadata();
+    bool subscribeToNotificationImplementation(const QString &name);
+    bool unsubscribeFromNotificationImplementation(const QString &name);
+    QStringList subscribedToNotificationsImplementation() const;
+
+Q_SIGNALS:
+    void asyncExecuted(const QFuture<QSqlRecord> &future, const QSqlError &error, int numRowsAffected);
+
+protected:
+    void timerEvent(QTimerEvent *event);
+
 private:
     QFBDriverPrivate* dp;
 };
@@ -0,0 +1,482 @@
+/*
+* This file is part of QtFirebirdIBPPSQLDriver - Qt SQL driver for Firebird with IBPP library
+* Copyright (C) 2006-2010 Alex Wencel
+*
+* Contact e-mail: Alex Wencel <alex.wencel@gmail.com>
+* Program URL   : http://code.google.com/p/qtfirebirdibppsqldriver
+*
+* GNU Lesser General Public License Usage
+* This file may be used under the terms of the GNU Lesser
+* General Public License version 2.1 as published by the Free Software
+* Foundation and appearing in the file LICENSE.LGPL included in the
+* packaging of this file.  Please review the following information to
+* ensure the GNU Lesser General Public License version 2.1 requirements
+* will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+*
+* GNU General Public License Usage
+* Alternatively, this file may be used under the terms of the GNU
+* General Public License version 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in the
+* packaging of this file.  Please review the following information to
+* ensure the GNU General Public License version 3.0 requirements will be
+* met: http://www.gnu.org/copyleft/gpl.html.
+*
+*/
+
+// Stand-in for IBPP's internal header in builds against the fake backend:
+// the Firebird client types the driver uses, and the classes behind the
+// IBPP interfaces, which serve tables from memory instead of a server.
+// See fakeibpp.h for what the fake understands.
+
+#ifndef FAKEIBPP_INTERNALS_H
+#define FAKEIBPP_INTERNALS_H
+
+#include "ibpp.h"
+
+#include <QtCore/qatomic.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+typedef long ISC_STATUS;
+typedef ISC_STATUS ISC_STATUS_ARRAY[20];
+typedef unsigned int isc_db_handle;
+typedef unsigned short ISC_USHORT;
+
+#define fb_cancel_raise 3
+
+ISC_STATUS fb_cancel_operation(ISC_STATUS *status, isc_db_handle *handle, ISC_USHORT option);
+
+namespace ibpp_internals
+{
+
+// Text of a fake exception, what() laid out like IBPP's messages
+struct FakeMessage
+{
+    FakeMessage(const char *kind, const char *context, const std::string &message);
+
+    std::string context;
+    std::string message;
+    std::string text;
+};
+
+class LogicExceptionImpl : public IBPP::LogicException
+{
+public:
+    LogicExceptionImpl(const char *context, const std::string &message)
+        : m("LogicException", context, message) {}
+    ~LogicExceptionImpl() throw() {}
+
+    const char *Origin() const throw() { return m.context.c_str(); }
+    const char *ErrorMessage() const throw() { return m.message.c_str(); }
+    const char *what() const throw() { return m.text.c_str(); }
+
+private:
+    FakeMessage m;
+};
+
+class WrongTypeImpl : public IBPP::WrongType
+{
+public:
+    WrongTypeImpl(const char *context, const std::string &message)
+        : m("WrongType", context, message) {}
+    ~WrongTypeImpl() throw() {}
+
+    const char *Origin() const throw() { return m.context.c_str(); }
+    const char *ErrorMessage() const throw() { return m.message.c_str(); }
+    const char *what() const throw() { return m.text.c_str(); }
+
+private:
+    FakeMessage m;
+};
+
+class SQLExceptionImpl : public IBPP::SQLException
+{
+public:
+    SQLExceptionImpl(const char *context, int sqlCode, int engineCode, const std::string &message)
+        : m("SQLException", context, message), mSqlCode(sqlCode), mEngineCode(engineCode) {}
+    ~SQLExceptionImpl() throw() {}
+
+    const char *Origin() const throw() { return m.context.c_str(); }
+    const char *ErrorMessage() const throw() { return m.message.c_str(); }
+    const char *what() const throw() { return m.text.c_str(); }
+    int SqlCode() const throw() { return mSqlCode; }
+    int EngineCode() const throw() { return mEngineCode; }
+
+private:
+    FakeMessage m;
+    int mSqlCode;
+    int mEngineCode;
+};
+
+// One value of a row or parameter. Integer types keep the unscaled value
+// in i, DATE the IBPP day in i, TIME the ticks in t, TIMESTAMP both,
+// strings and BLOBs their bytes in s.
+struct FakeCell
+{
+    FakeCell() : null(true), i(0), t(0), d(0) {}
+
+    bool null;
+    long long i;
+    int t;
+    double d;
+    std::string s;
+};
+
+struct FakeColumnDef
+{
+    FakeColumnDef() : type(IBPP::sdInteger), size(4), scale(0), subtype(0), padded(false) {}
+
+    std::string name;
+    IBPP::SDT type;
+    int size;       // bytes, four per character for strings
+    int scale;
+    int subtype;
+    bool padded;    // CHAR
+};
+
+struct FakeTable
+{
+    FakeTable() : users(0), generation(0) {}
+
+    std::string name;
+    std::vector<FakeColumnDef> columns;
+    std::vector<std::vector<FakeCell> > rows;
+    int users;          // prepared statements referring to the table
+    int generation;     // bumped by DELETE, ends open cursors
+};
+
+// Where a value of an INSERT or a WHERE comes from
+struct FakeValueSource
+{
+    FakeValueSource() : param(-1), column(-1) {}
+
+    int param;          // 0-based parameter, -1 for a literal
+    int column;
+    FakeCell literal;
+};
+
+class DatabaseImpl : public IBPP::IDatabase
+{
+public:
+    DatabaseImpl(const std::string &server, const std::string &database,
+                 const std::string &user, const std::string &password,
+                 const std::string &role, const std::string &charSet,
+                 const std::string &createParams);
+    ~DatabaseImpl();
+
+    const char *ServerName() const { return mServerName.c_str(); }
+    const char *DatabaseName() const { return mDatabaseName.c_str(); }
+    const char *Username() const { return mUserName.c_str(); }
+    const char *UserPassword() const { return mUserPassword.c_str(); }
+    const char *RoleName() const { return mRoleName.c_str(); }
+    const char *CharSet() const { return mCharSet.c_str(); }
+    const char *CreateParams() const { return mCreateParams.c_str(); }
+
+    void Info(int *ODS, int *ODSMinor, int *PageSize, int *Pages,
+              int *Buffers, int *Sweep, bool *Sync, bool *Reserve);
+    void Statistics(int *Fetches, int *Marks, int *Reads, int *Writes);
+    void Counts(int *Insert, int *Update, int *Delete, int *ReadIdx, int *ReadSeq);
+    void Users(std::vector<std::string> &users);
+    int Dialect() { return 3; }
+
+    void Create(int dialect);
+    void Connect();
+    bool Connected() { return mHandle != 0; }
+    void Inactivate() {}
+    void Disconnect();
+    void Drop();
+
+    IBPP::IDatabase *AddRef();
+    void Release();
+
+    isc_db_handle GetHandle() { return mHandle; }
+    isc_db_handle *GetHandlePtr() { return &mHandle; }
+
+    // Brackets a blocking call, which fb_cancel_operation() may interrupt
+    void BeginCall(const char *origin);
+    void EndCall();
+    bool RequestCancel();
+    void CheckCancel(const char *origin);
+
+private:
+    int mRefCount;
+    isc_db_handle mHandle;
+    QAtomicInt mBusy;
+    QAtomicInt mCancel;
+
+    std::string mServerName;
+    std::string mDatabaseName;
+    std::string mUserName;
+    std::string mUserPassword;
+    std::string mRoleName;
+    std::string mCharSet;
+    std::string mCreateParams;
+};
+
+class TransactionImpl : public IBPP::ITransaction
+{
+public:
+    TransactionImpl(IBPP::Database db, IBPP::TAM am, IBPP::TIL il, IBPP::TLR lr, IBPP::TFF flags);
+    ~TransactionImpl();
+
+    void AttachDatabase(IBPP::Database db, IBPP::TAM am = IBPP::amWrite,
+                        IBPP::TIL il = IBPP::ilConcurrency, IBPP::TLR lr = IBPP::lrWait,
+                        IBPP::TFF flags = IBPP::TFF(0));
+    void DetachDatabase(IBPP::Database db);
+    void AddReservation(IBPP::Database db, const std::string &table, IBPP::TTR tr);
+
+    void Start();
+    bool Started() { return mStarted; }
+    void Commit();
+    void Rollback();
+    void CommitRetain();
+    void RollbackRetain();
+
+    IBPP::ITransaction *AddRef();
+    void Release();
+
+    // Changes on every Start(), BLOB ids of an earlier run are invalid
+    int Generation() const { return mGeneration; }
+
+private:
+    int mRefCount;
+    bool mStarted;
+    int mGeneration;
+    std::vector<IBPP::Database> mDatabases;
+};
+
+class BlobImpl : public IBPP::IBlob
+{
+public:
+    BlobImpl(IBPP::Database db, IBPP::Transaction tr);
+    ~BlobImpl();
+
+    void Create();
+    void Open();
+    void Close();
+    void Cancel();
+    int Read(void *buffer, int size);
+    void Write(const void *buffer, int size);
+    void Info(int *Size, int *Largest, int *Segments);
+    void Save(const std::string &data);
+    void Load(std::string &data);
+
+    IBPP::Database DatabasePtr() const { return mDatabase; }
+    IBPP::Transaction TransactionPtr() const { return mTransaction; }
+
+    IBPP::IBlob *AddRef();
+    void Release();
+
+    // The value of a fetched BLOB column, its id is valid while the run of
+    // tr it was fetched in lasts
+    void SetId(const std::string &data, IBPP::Transaction tr);
+    const std::string &Data(const char *origin) const;
+
+private:
+    enum State { Empty, Writing, Written, Reading, Closed };
+
+    int mRefCount;
+    State mState;
+    std::string mData;
+    std::string::size_type mPos;
+    IBPP::Transaction mIdTransaction;
+    int mIdGeneration;
+    IBPP::Database mDatabase;
+    IBPP::Transaction mTransaction;
+};
+
+class ArrayImpl : public IBPP::IArray
+{
+public:
+    ArrayImpl(IBPP::Database db, IBPP::Transaction tr);
+
+    void Describe(const std::string &table, const std::string &column);
+    void ReadTo(IBPP::ADT, void *, int);
+    void WriteFrom(IBPP::ADT, const void *, int);
+    IBPP::SDT ElementType();
+    int ElementSize();
+    int ElementScale();
+    int Dimensions();
+    void Bounds(int dim, int *low, int *high);
+    void SetBounds(int dim, int low, int high);
+
+    IBPP::Database DatabasePtr() const { return mDatabase; }
+    IBPP::Transaction TransactionPtr() const { return mTransaction; }
+
+    IBPP::IArray *AddRef();
+    void Release();
+
+private:
+    int mRefCount;
+    IBPP::Database mDatabase;
+    IBPP::Transaction mTransaction;
+};
+
+class StatementImpl : public IBPP::IStatement
+{
+public:
+    StatementImpl(IBPP::Database db, IBPP::Transaction tr);
+    ~StatementImpl();
+
+    void Prepare(const std::string &sql);
+    void Execute(const std::string &sql);
+    void Execute();
+    void ExecuteImmediate(const std::string &sql);
+    void CursorExecute(const std::string &cursor, const std::string &sql);
+    void CursorExecute(const std::string &cursor);
+    bool Fetch();
+    bool Fetch(IBPP::Row &row);
+    int AffectedRows();
+    void Close();
+    std::string &Sql() { return mSql; }
+    IBPP::STT Type();
+
+    void SetNull(int param);
+    void Set(int param, bool value);
+    void Set(int param, const void *value, int size);
+    void Set(int param, const char *value);
+    void Set(int param, const std::string &value);
+    void Set(int param, int16_t value);
+    void Set(int param, int32_t value);
+    void Set(int param, int64_t value);
+    void Set(int param, float value);
+    void Set(int param, double value);
+    void Set(int param, const IBPP::Timestamp &value);
+    void Set(int param, const IBPP::Date &value);
+    void Set(int param, const IBPP::Time &value);
+    void Set(int param, const IBPP::DBKey &value);
+    void Set(int param, const IBPP::Blob &value);
+    void Set(int param, const IBPP::Array &value);
+
+    bool IsNull(int column);
+    bool Get(int column, bool &value);
+    bool Get(int column, char *value);
+    bool Get(int column, char *value, int size);
+    bool Get(int column, void *value, int &size);
+    bool Get(int column, std::string &value);
+    bool Get(int column, int16_t &value);
+    bool Get(int column, int32_t &value);
+    bool Get(int column, int64_t &value);
+    bool Get(int column, float &value);
+    bool Get(int column, double &value);
+    bool Get(int column, IBPP::Timestamp &value);
+    bool Get(int column, IBPP::Date &value);
+    bool Get(int column, IBPP::Time &value);
+    bool Get(int column, IBPP::DBKey &value);
+    bool Get(int column, IBPP::Blob &value);
+    bool Get(int column, IBPP::Array &value);
+
+    bool IsNull(const std::string &name) { return IsNull(ColumnNum(name)); }
+    bool Get(const std::string &name, bool &value) { return Get(ColumnNum(name), value); }
+    bool Get(const std::string &name, char *value) { return Get(ColumnNum(name), value); }
+    bool Get(const std::string &name, char *value, int size) { return Get(ColumnNum(name), value, size); }
+    bool Get(const std::string &name, void *value, int &size) { return Get(ColumnNum(name), value, size); }
+    bool Get(const std::string &name, std::string &value) { return Get(ColumnNum(name), value); }
+    bool Get(const std::string &name, int16_t &value) { return Get(ColumnNum(name), value); }
+    bool Get(const std::string &name, int32_t &value) { return Get(ColumnNum(name), value); }
+    bool Get(const std::string &name, int64_t &value) { return Get(ColumnNum(name), value); }
+    bool Get(const std::string &name, float &value) { return Get(ColumnNum(name), value); }
+    bool Get(const std::string &name, double &value) { return Get(ColumnNum(name), value); }
+    bool Get(const std::string &name, IBPP::Timestamp &value) { return Get(ColumnNum(name), value); }
+    bool Get(const std::string &name, IBPP::Date &value) { return Get(ColumnNum(name), value); }
+    bool Get(const std::string &name, IBPP::Time &value) { return Get(ColumnNum(name), value); }
+    bool Get(const std::string &name, IBPP::DBKey &value) { return Get(ColumnNum(name), value); }
+    bool Get(const std::string &name, IBPP::Blob &value) { return Get(ColumnNum(name), value); }
+    bool Get(const std::string &name, IBPP::Array &value) { return Get(ColumnNum(name), value); }
+
+    int ColumnNum(const std::string &name);
+    const char *ColumnName(int column);
+    const char *ColumnAlias(int column);
+    const char *ColumnTable(int column);
+    IBPP::SDT ColumnType(int column);
+    int ColumnSubtype(int column);
+    int ColumnSize(int column);
+    int ColumnScale(int column);
+    int Columns();
+
+    IBPP::SDT ParameterType(int param);
+    int ParameterSubtype(int param);
+    int ParameterSize(int param);
+    int ParameterScale(int param);
+    int Parameters();
+
+    void Plan(std::string &plan);
+
+    IBPP::Database DatabasePtr() const { return mDatabase; }
+    IBPP::Transaction TransactionPtr() const { return mTransaction; }
+
+    IBPP::IStatement *AddRef();
+    void Release();
+
+private:
+    enum Kind { Unprepared, Select, Count, Insert, Delete, CreateTable, DropTable };
+
+    void checkReady(const char *origin);
+    const FakeColumnDef &paramDef(int param, const char *origin);
+    void store(int param, const FakeCell &cell);
+    const FakeColumnDef &column(int column, const char *origin);
+    const FakeCell &value(int column, const char *origin);
+    void setInteger(int param, long long value);
+    void setDouble(int param, double value);
+    void setBytes(int param, const char *value, int size);
+    const FakeCell &sourceValue(const FakeValueSource &source) const;
+    bool matches(const std::vector<FakeCell> &row) const;
+    void prepareLocked(const std::string &sql);
+    void executeLocked();
+    void releaseLocked();
+
+    int mRefCount;
+    IBPP::Database mDatabase;
+    IBPP::Transaction mTransaction;
+    std::string mSql;
+
+    Kind mKind;
+    FakeTable *mTable;          // holds a reference while prepared
+    std::string mTableName;
+    std::vector<FakeColumnDef> mNewColumns;     // CREATE TABLE
+    std::vector<int> mSelected;                 // table column per result column
+    std::vector<FakeColumnDef> mColumns;
+    std::vector<FakeColumnDef> mParamDefs;
+    std::vector<FakeCell> mParams;
+    std::vector<bool> mParamSet;
+    std::vector<FakeValueSource> mValues;       // INSERT, one per target column
+    bool mHasWhere;
+    FakeValueSource mWhere;
+
+    bool mCursorOpen;
+    std::vector<std::vector<FakeCell> >::size_type mPos;
+    std::vector<std::vector<FakeCell> >::size_type mEnd;
+    int mCursorGeneration;
+    long long mCount;
+    bool mHasRow;
+    std::vector<FakeCell> mRow;
+    int mAffected;
+};
+
+class EventsImpl : public IBPP::IEvents
+{
+public:
+    explicit EventsImpl(IBPP::Database db);
+
+    void Add(const std::string &name, IBPP::EventInterface *handler);
+    void Drop(const std::string &name);
+    void List(std::vector<std::string> &names);
+    void Clear();
+    void Dispatch() {}
+
+    IBPP::Database DatabasePtr() const { return mDatabase; }
+
+    IBPP::IEvents *AddRef();
+    void Release();
+
+private:
+    int mRefCount;
+    IBPP::Database mDatabase;
+    std::map<std::string, IBPP::EventInterface *> mHandlers;
+};
+
+} // namespace ibpp_internals
+
+#endif // FAKEIBPP_INTERNALS_H
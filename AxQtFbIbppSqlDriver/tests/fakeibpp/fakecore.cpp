@@ -0,0 +1,376 @@
+/*
+* This file is part of QtFirebirdIBPPSQLDriver - Qt SQL driver for Firebird with IBPP library
+* Copyright (C) 2006-2010 Alex Wencel
+*
+* Contact e-mail: Alex Wencel <alex.wencel@gmail.com>
+* Program URL   : http://code.google.com/p/qtfirebirdibppsqldriver
+*
+* GNU Lesser General Public License Usage
+* This file may be used under the terms of the GNU Lesser
+* General Public License version 2.1 as published by the Free Software
+* Foundation and appearing in the file LICENSE.LGPL included in the
+* packaging of this file.  Please review the following information to
+* ensure the GNU Lesser General Public License version 2.1 requirements
+* will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+*
+* GNU General Public License Usage
+* Alternatively, this file may be used under the terms of the GNU
+* General Public License version 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in the
+* packaging of this file.  Please review the following information to
+* ensure the GNU General Public License version 3.0 requirements will be
+* met: http://www.gnu.org/copyleft/gpl.html.
+*
+*/
+
+// Members of the classes in ibpp.h that IBPP's core defines out of line:
+// dates, times, DB_KEYs and exceptions, with IBPP's calendar. Day 0 is
+// 31 December 1899 and the calendar is proleptic Gregorian, from
+// IBPP::MinDate (1 January 1) to IBPP::MaxDate (31 December 9999).
+
+#include "_ibpp.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+using namespace ibpp_internals;
+
+static const int ibppDayOffset = 2415020;   // Julian day of IBPP's day 0
+static const int ticksPerDay = 24 * 3600 * 10000;
+//-----------------------------------------------------------------------//
+static bool qIsLeapYear(int year)
+{
+    return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+}
+//-----------------------------------------------------------------------//
+static int qDaysInMonth(int year, int month)
+{
+    static const int days[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    return month == 2 && qIsLeapYear(year) ? 29 : days[month - 1];
+}
+//-----------------------------------------------------------------------//
+FakeMessage::FakeMessage(const char *kind, const char *ctx, const std::string &msg)
+    : context(ctx), message(msg)
+{
+    text = std::string("*** IBPP::") + kind + " ***\nContext: " + context +
+           "\nMessage: " + message + "\n";
+}
+//-----------------------------------------------------------------------//
+IBPP::Exception::~Exception() throw() {}
+IBPP::LogicException::~LogicException() throw() {}
+IBPP::SQLException::~SQLException() throw() {}
+IBPP::WrongType::~WrongType() throw() {}
+//-----------------------------------------------------------------------//
+bool IBPP::dtoi(int date, int *py, int *pm, int *pd)
+{
+    if (date < IBPP::MinDate || date > IBPP::MaxDate)
+        return false;
+
+    // Julian day to Gregorian date, Fliegel and Van Flandern
+    const int a = date + ibppDayOffset + 32044;
+    const int b = (4 * a + 3) / 146097;
+    const int c = a - 146097 * b / 4;
+    const int d = (4 * c + 3) / 1461;
+    const int e = c - 1461 * d / 4;
+    const int m = (5 * e + 2) / 153;
+
+    if (pd)
+        *pd = e - (153 * m + 2) / 5 + 1;
+    if (pm)
+        *pm = m + 3 - 12 * (m / 10);
+    if (py)
+        *py = 100 * b + d - 4800 + m / 10;
+    return true;
+}
+//-----------------------------------------------------------------------//
+bool IBPP::itod(int *pdate, int year, int month, int day)
+{
+    if (year < 1 || year > 9999 || month < 1 || month > 12 ||
+        day < 1 || day > qDaysInMonth(year, month))
+        return false;
+
+    const int a = (14 - month) / 12;
+    const int y = year + 4800 - a;
+    const int m = month + 12 * a - 3;
+    *pdate = day + (153 * m + 2) / 5 + 365 * y + y / 4 - y / 100 + y / 400 - 32045 - ibppDayOffset;
+    return true;
+}
+//-----------------------------------------------------------------------//
+void IBPP::ttoi(int itime, int *phour, int *pminute, int *psecond, int *ptt)
+{
+    if (phour)
+        *phour = itime / 36000000;
+    if (pminute)
+        *pminute = itime / 600000 % 60;
+    if (psecond)
+        *psecond = itime / 10000 % 60;
+    if (ptt)
+        *ptt = itime % 10000;
+}
+//-----------------------------------------------------------------------//
+void IBPP::itot(int *ptime, int hour, int minute, int second, int tenthousandths)
+{
+    *ptime = ((hour * 60 + minute) * 60 + second) * 10000 + tenthousandths;
+}
+//-----------------------------------------------------------------------//
+void IBPP::Date::Today()
+{
+    const time_t now = time(0);
+    const struct tm *t = localtime(&now);
+    SetDate(t->tm_year + 1900, t->tm_mon + 1, t->tm_mday);
+}
+//-----------------------------------------------------------------------//
+void IBPP::Date::SetDate(int year, int month, int day)
+{
+    int dt;
+    if (!IBPP::itod(&dt, year, month, day))
+        throw LogicExceptionImpl("Date::SetDate", "Invalid date.");
+    mDate = dt;
+}
+//-----------------------------------------------------------------------//
+void IBPP::Date::SetDate(int dt)
+{
+    if (!IBPP::dtoi(dt, 0, 0, 0))
+        throw LogicExceptionImpl("Date::SetDate", "Invalid date.");
+    mDate = dt;
+}
+//-----------------------------------------------------------------------//
+void IBPP::Date::GetDate(int &year, int &month, int &day) const
+{
+    if (!IBPP::dtoi(mDate, &year, &month, &day))
+        throw LogicExceptionImpl("Date::GetDate", "Date is not initialized or out of range.");
+}
+//-----------------------------------------------------------------------//
+int IBPP::Date::Year() const
+{
+    int y, m, d;
+    GetDate(y, m, d);
+    return y;
+}
+//-----------------------------------------------------------------------//
+int IBPP::Date::Month() const
+{
+    int y, m, d;
+    GetDate(y, m, d);
+    return m;
+}
+//-----------------------------------------------------------------------//
+int IBPP::Date::Day() const
+{
+    int y, m, d;
+    GetDate(y, m, d);
+    return d;
+}
+//-----------------------------------------------------------------------//
+void IBPP::Date::Add(int days)
+{
+    const int dt = mDate + days;
+    if (!IBPP::dtoi(dt, 0, 0, 0))
+        throw LogicExceptionImpl("Date::Add", "Date would be out of range.");
+    mDate = dt;
+}
+//-----------------------------------------------------------------------//
+void IBPP::Date::StartOfMonth()
+{
+    int y, m, d;
+    GetDate(y, m, d);
+    SetDate(y, m, 1);
+}
+//-----------------------------------------------------------------------//
+void IBPP::Date::EndOfMonth()
+{
+    int y, m, d;
+    GetDate(y, m, d);
+    SetDate(y, m, qDaysInMonth(y, m));
+}
+//-----------------------------------------------------------------------//
+IBPP::Date::Date(int year, int month, int day)
+{
+    SetDate(year, month, day);
+}
+//-----------------------------------------------------------------------//
+IBPP::Date::Date(const Date &copied)
+    : mDate(copied.mDate)
+{
+}
+//-----------------------------------------------------------------------//
+IBPP::Date &IBPP::Date::operator=(const Timestamp &assigned)
+{
+    mDate = assigned.GetDate();
+    return *this;
+}
+//-----------------------------------------------------------------------//
+IBPP::Date &IBPP::Date::operator=(const Date &assigned)
+{
+    mDate = assigned.mDate;
+    return *this;
+}
+//-----------------------------------------------------------------------//
+void IBPP::Time::Now()
+{
+    const time_t now = time(0);
+    const struct tm *t = localtime(&now);
+    SetTime(t->tm_hour, t->tm_min, t->tm_sec);
+}
+//-----------------------------------------------------------------------//
+void IBPP::Time::SetTime(int hour, int minute, int second, int tenthousandths)
+{
+    if (hour < 0 || hour > 23 || minute < 0 || minute > 59 || second < 0 || second > 59 ||
+        tenthousandths < 0 || tenthousandths > 9999)
+        throw LogicExceptionImpl("Time::SetTime", "Invalid time.");
+    IBPP::itot(&mTime, hour, minute, second, tenthousandths);
+}
+//-----------------------------------------------------------------------//
+void IBPP::Time::SetTime(int tm)
+{
+    if (tm < 0 || tm >= ticksPerDay)
+        throw LogicExceptionImpl("Time::SetTime", "Invalid time.");
+    mTime = tm;
+}
+//-----------------------------------------------------------------------//
+void IBPP::Time::GetTime(int &hour, int &minute, int &second) const
+{
+    IBPP::ttoi(mTime, &hour, &minute, &second, 0);
+}
+//-----------------------------------------------------------------------//
+void IBPP::Time::GetTime(int &hour, int &minute, int &second, int &tenthousandths) const
+{
+    IBPP::ttoi(mTime, &hour, &minute, &second, &tenthousandths);
+}
+//-----------------------------------------------------------------------//
+int IBPP::Time::Hours() const
+{
+    return mTime / 36000000;
+}
+//-----------------------------------------------------------------------//
+int IBPP::Time::Minutes() const
+{
+    return mTime / 600000 % 60;
+}
+//-----------------------------------------------------------------------//
+int IBPP::Time::Seconds() const
+{
+    return mTime / 10000 % 60;
+}
+//-----------------------------------------------------------------------//
+int IBPP::Time::SubSeconds() const
+{
+    return mTime % 10000;
+}
+//-----------------------------------------------------------------------//
+IBPP::Time::Time(int hour, int minute, int second, int tenthousandths)
+{
+    SetTime(hour, minute, second, tenthousandths);
+}
+//-----------------------------------------------------------------------//
+IBPP::Time::Time(const Time &copied)
+    : mTime(copied.mTime)
+{
+}
+//-----------------------------------------------------------------------//
+IBPP::Time &IBPP::Time::operator=(const Timestamp &assigned)
+{
+    mTime = assigned.GetTime();
+    return *this;
+}
+//-----------------------------------------------------------------------//
+IBPP::Time &IBPP::Time::operator=(const Time &assigned)
+{
+    mTime = assigned.mTime;
+    return *this;
+}
+//-----------------------------------------------------------------------//
+IBPP::Timestamp::Timestamp(const Timestamp &copied)
+    : Date(copied), Time(copied)
+{
+}
+//-----------------------------------------------------------------------//
+// A date alone is at midnight, a time alone has no date
+IBPP::Timestamp::Timestamp(const Date &copied)
+    : Date(copied)
+{
+}
+//-----------------------------------------------------------------------//
+IBPP::Timestamp::Timestamp(const Time &copied)
+    : Time(copied)
+{
+}
+//-----------------------------------------------------------------------//
+IBPP::Timestamp &IBPP::Timestamp::operator=(const Timestamp &assigned)
+{
+    mDate = assigned.mDate;
+    mTime = assigned.mTime;
+    return *this;
+}
+//-----------------------------------------------------------------------//
+IBPP::Timestamp &IBPP::Timestamp::operator=(const Date &assigned)
+{
+    mDate = assigned.GetDate();
+    mTime = 0;
+    return *this;
+}
+//-----------------------------------------------------------------------//
+IBPP::Timestamp &IBPP::Timestamp::operator=(const Time &assigned)
+{
+    mDate = IBPP::MinDate - 1;
+    mTime = assigned.GetTime();
+    return *this;
+}
+//-----------------------------------------------------------------------//
+void IBPP::DBKey::Clear()
+{
+    mDBKey.erase();
+    mString.erase();
+}
+//-----------------------------------------------------------------------//
+void IBPP::DBKey::SetKey(const void *key, int size)
+{
+    if (key == 0 || size <= 0 || size % 8 != 0)
+        throw LogicExceptionImpl("DBKey::SetKey", "Invalid DB_KEY.");
+    mDBKey.assign(static_cast<const char *>(key), size);
+    mString.erase();
+}
+//-----------------------------------------------------------------------//
+void IBPP::DBKey::GetKey(void *key, int size) const
+{
+    if (mDBKey.empty())
+        throw LogicExceptionImpl("DBKey::GetKey", "DB_KEY not assigned.");
+    if (key == 0 || size != int(mDBKey.size()))
+        throw LogicExceptionImpl("DBKey::GetKey", "Incompatible DB_KEY size.");
+    memcpy(key, mDBKey.data(), size);
+}
+//-----------------------------------------------------------------------//
+// Groups of four bytes in hex, ':' inside each eight byte key, '-' between keys
+const char *IBPP::DBKey::AsString() const
+{
+    if (mDBKey.empty())
+        throw LogicExceptionImpl("DBKey::AsString", "DB_KEY not assigned.");
+
+    if (mString.empty())
+    {
+        for (std::string::size_type i = 0; i < mDBKey.size(); i += 4)
+        {
+            if (i > 0)
+                mString += i % 8 ? ':' : '-';
+            char group[9];
+            const unsigned char *p = reinterpret_cast<const unsigned char *>(mDBKey.data() + i);
+            sprintf(group, "%02x%02x%02x%02x", p[0], p[1], p[2], p[3]);
+            mString += group;
+        }
+    }
+    return mString.c_str();
+}
+//-----------------------------------------------------------------------//
+IBPP::DBKey &IBPP::DBKey::operator=(const DBKey &assigned)
+{
+    mDBKey = assigned.mDBKey;
+    mString = assigned.mString;
+    return *this;
+}
+//-----------------------------------------------------------------------//
+IBPP::DBKey::DBKey(const DBKey &copied)
+    : mDBKey(copied.mDBKey), mString(copied.mString)
+{
+}
+//-----------------------------------------------------------------------//
@@ -0,0 +1,2152 @@
+/*
+* This file is part of QtFirebirdIBPPSQLDriver - Qt SQL driver for Firebird with IBPP library
+* Copyright (C) 2006-2010 Alex Wencel
+*
+* Contact e-mail: Alex Wencel <alex.wencel@gmail.com>
+* Program URL   : http://code.google.com/p/qtfirebirdibppsqldriver
+*
+* GNU Lesser General Public License Usage
+* This file may be used under the terms of the GNU Lesser
+* General Public License version 2.1 as published by the Free Software
+* Foundation and appearing in the file LICENSE.LGPL included in the
+* packaging of this file.  Please review the following information to
+* ensure the GNU Lesser General Public License version 2.1 requirements
+* will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+*
+* GNU General Public License Usage
+* Alternatively, this file may be used under the terms of the GNU
+* General Public License version 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in the
+* packaging of this file.  Please review the following information to
+* ensure the GNU General Public License version 3.0 requirements will be
+* met: http://www.gnu.org/copyleft/gpl.html.
+*
+*/
+
+#include "fakeibpp.h"
+#include "_ibpp.h"
+
+#include <QtCore/qmutex.h>
+#include <QtCore/qwaitcondition.h>
+
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+#include <algorithm>
+
+using namespace ibpp_internals;
+
+// Firebird error codes the fake reports
+static const int isc_conversion_error = 335544334;
+static const int isc_no_meta_update = 335544351;
+static const int isc_bad_segstr_id = 335544329;
+static const int isc_arith_except = 335544321;
+static const int isc_obj_in_use = 335544453;
+static const int isc_dsql_error = 335544569;
+static const int isc_dsql_field_err = 335544578;
+static const int isc_dsql_relation_err = 335544580;
+static const int isc_cancelled = 335544794;
+static const int isc_bad_db_handle = 335544324;
+
+static const int maxSegment = 64 * 1024 - 1;
+static const int bytesPerChar = 4;      // UTF8
+//-----------------------------------------------------------------------//
+// Tables, attachments and counters shared by all threads
+struct FakeCatalog
+{
+    FakeCatalog() : nextHandle(0), callDelay(0), prepares(0), executes(0), fetches(0) {}
+
+    QMutex mutex;
+    std::map<std::string, FakeTable *> tables;
+    std::map<isc_db_handle, DatabaseImpl *> attachments;
+    isc_db_handle nextHandle;
+    int callDelay;
+    int prepares;
+    int executes;
+    int fetches;
+};
+
+static FakeCatalog fakeCatalog;
+//-----------------------------------------------------------------------//
+static void qFakeSleep(int msecs)
+{
+    QMutex mutex;
+    QWaitCondition never;
+    mutex.lock();
+    never.wait(&mutex, msecs);
+    mutex.unlock();
+}
+//-----------------------------------------------------------------------//
+static long long qPowerOf10(int n)
+{
+    long long p = 1;
+    while (n-- > 0)
+        p *= 10;
+    return p;
+}
+//-----------------------------------------------------------------------//
+static bool qIsInteger(IBPP::SDT type)
+{
+    return type == IBPP::sdSmallint || type == IBPP::sdInteger || type == IBPP::sdLargeint;
+}
+//-----------------------------------------------------------------------//
+static void qPad(const FakeColumnDef &def, std::string &s)
+{
+    if (def.padded && int(s.size()) < def.size)
+        s.append(def.size - s.size(), ' ');
+}
+//-----------------------------------------------------------------------//
+static void qSyntaxError(const std::string &token)
+{
+    throw SQLExceptionImpl("Statement::Prepare", -104, isc_dsql_error,
+                           "Dynamic SQL Error\nSQL error code = -104\nToken unknown - " +
+                           (token.empty() ? std::string("end of statement") : token));
+}
+//-----------------------------------------------------------------------//
+// Tokens of the SQL subset: names upper-cased unless quoted, numbers,
+// string literals and single character symbols
+struct FakeToken
+{
+    enum Kind { End, Name, Number, String, Symbol };
+
+    FakeToken() : kind(End) {}
+    FakeToken(Kind k, const std::string &t) : kind(k), text(t) {}
+
+    Kind kind;
+    std::string text;
+};
+//-----------------------------------------------------------------------//
+static std::vector<FakeToken> qTokenize(const std::string &sql)
+{
+    std::vector<FakeToken> tokens;
+    std::string::size_type i = 0;
+    const std::string::size_type n = sql.size();
+    while (i < n)
+    {
+        const unsigned char c = sql[i];
+        if (isspace(c))
+        {
+            ++i;
+        }
+        else if (sql.compare(i, 2, "--") == 0)
+        {
+            i = sql.find('\n', i);
+        }
+        else if (sql.compare(i, 2, "/*") == 0)
+        {
+            i = sql.find("*/", i);
+            if (i != std::string::npos)
+                i += 2;
+        }
+        else if (isalpha(c) || c == '_')
+        {
+            std::string name;
+            while (i < n && (isalnum((unsigned char)sql[i]) || sql[i] == '_' || sql[i] == '$'))
+                name += char(toupper((unsigned char)sql[i++]));
+            tokens.push_back(FakeToken(FakeToken::Name, name));
+        }
+        else if (isdigit(c) || (c == '.' && i + 1 < n && isdigit((unsigned char)sql[i + 1])))
+        {
+            const std::string::size_type start = i;
+            while (i < n && (isdigit((unsigned char)sql[i]) || sql[i] == '.'))
+                ++i;
+            tokens.push_back(FakeToken(FakeToken::Number, sql.substr(start, i - start)));
+        }
+        else if (c == '\'' || c == '"')
+        {
+            std::string text;
+            for (++i; i < n; ++i)
+            {
+                if (sql[i] == char(c))
+                {
+                    if (i + 1 < n && sql[i + 1] == char(c))
+                        ++i;
+                    else
+                        break;
+                }
+                text += sql[i];
+            }
+            if (i >= n)
+                qSyntaxError("unterminated literal");
+            ++i;
+            tokens.push_back(FakeToken(c == '"' ? FakeToken::Name : FakeToken::String, text));
+        }
+        else
+        {
+            tokens.push_back(FakeToken(FakeToken::Symbol, std::string(1, char(c))));
+            ++i;
+        }
+        if (i == std::string::npos)
+            break;
+    }
+    return tokens;
+}
+//-----------------------------------------------------------------------//
+class FakeParser
+{
+public:
+    explicit FakeParser(const std::string &sql) : tokens(qTokenize(sql)), pos(0) {}
+
+    const FakeToken &peek() const
+    {
+        static const FakeToken end;
+        return pos < tokens.size() ? tokens[pos] : end;
+    }
+
+    const FakeToken &next()
+    {
+        const FakeToken &t = peek();
+        if (pos < tokens.size())
+            ++pos;
+        return t;
+    }
+
+    // Keywords and symbols, not quoted names
+    bool accept(const char *word)
+    {
+        const FakeToken &t = peek();
+        if ((t.kind == FakeToken::Name || t.kind == FakeToken::Symbol) && t.text == word)
+        {
+            ++pos;
+            return true;
+        }
+        return false;
+    }
+
+    void expect(const char *word)
+    {
+        if (!accept(word))
+            qSyntaxError(peek().text);
+    }
+
+    std::string name()
+    {
+        if (peek().kind != FakeToken::Name)
+            qSyntaxError(peek().text);
+        return next().text;
+    }
+
+    int number()
+    {
+        if (peek().kind != FakeToken::Number)
+            qSyntaxError(peek().text);
+        return atoi(next().text.c_str());
+    }
+
+    void expectEnd()
+    {
+        accept(";");
+        if (peek().kind != FakeToken::End)
+            qSyntaxError(peek().text);
+    }
+
+private:
+    std::vector<FakeToken> tokens;
+    std::vector<FakeToken>::size_type pos;
+};
+//-----------------------------------------------------------------------//
+static FakeColumnDef qParseType(FakeParser &p)
+{
+    FakeColumnDef def;
+    if (p.accept("SMALLINT"))
+    {
+        def.type = IBPP::sdSmallint;
+        def.size = 2;
+    }
+    else if (p.accept("INTEGER") || p.accept("INT"))
+    {
+        def.type = IBPP::sdInteger;
+        def.size = 4;
+    }
+    else if (p.accept("BIGINT"))
+    {
+        def.type = IBPP::sdLargeint;
+        def.size = 8;
+    }
+    else if (p.accept("FLOAT"))
+    {
+        def.type = IBPP::sdFloat;
+        def.size = 4;
+    }
+    else if (p.accept("DOUBLE"))
+    {
+        p.expect("PRECISION");
+        def.type = IBPP::sdDouble;
+        def.size = 8;
+    }
+    else if (p.accept("NUMERIC") || p.accept("DECIMAL"))
+    {
+        int precision = 9;
+        if (p.accept("("))
+        {
+            precision = p.number();
+            if (p.accept(","))
+                def.scale = p.number();
+            p.expect(")");
+        }
+        if (precision < 1 || precision > 18 || def.scale < 0 || def.scale > precision)
+            qSyntaxError("precision");
+        def.type = precision <= 4 ? IBPP::sdSmallint :
+                   precision <= 9 ? IBPP::sdInteger : IBPP::sdLargeint;
+        def.size = precision <= 4 ? 2 : precision <= 9 ? 4 : 8;
+    }
+    else if (p.peek().kind == FakeToken::Name &&
+             (p.peek().text == "VARCHAR" || p.peek().text == "CHAR" || p.peek().text == "CHARACTER"))
+    {
+        def.padded = p.name() != "VARCHAR" && !p.accept("VARYING");
+        int length = 1;
+        if (p.accept("("))
+        {
+            length = p.number();
+            p.expect(")");
+        }
+        if (length < 1 || length > 8191)
+            qSyntaxError("length");
+        def.type = IBPP::sdString;
+        def.size = length * bytesPerChar;
+    }
+    else if (p.accept("DATE"))
+    {
+        def.type = IBPP::sdDate;
+        def.size = 4;
+    }
+    else if (p.accept("TIME"))
+    {
+        def.type = IBPP::sdTime;
+        def.size = 4;
+    }
+    else if (p.accept("TIMESTAMP"))
+    {
+        def.type = IBPP::sdTimestamp;
+        def.size = 8;
+    }
+    else if (p.accept("BLOB"))
+    {
+        def.type = IBPP::sdBlob;
+        def.size = 8;
+        if (p.accept("SUB_TYPE"))
+        {
+            if (p.accept("TEXT"))
+                def.subtype = 1;
+            else if (!p.accept("BINARY"))
+                def.subtype = p.number();
+        }
+    }
+    else
+        qSyntaxError(p.peek().text);
+
+    return def;
+}
+//-----------------------------------------------------------------------//
+// Skips constraints, defaults and character sets up to the next column
+static void qSkipToNextItem(FakeParser &p)
+{
+    int depth = 0;
+    for (;;)
+    {
+        const FakeToken &t = p.peek();
+        if (t.kind == FakeToken::End)
+            qSyntaxError(t.text);
+        if (t.kind == FakeToken::Symbol)
+        {
+            if (depth == 0 && (t.text == "," || t.text == ")"))
+                return;
+            if (t.text == "(")
+                ++depth;
+            else if (t.text == ")")
+                --depth;
+        }
+        p.next();
+    }
+}
+//-----------------------------------------------------------------------//
+// Plain decimal text like "12.345" as an integer scaled by 10^scale,
+// extra fraction digits are cut off
+static bool qParseDecimal(const std::string &text, int scale, long long &out)
+{
+    long long value = 0;
+    int fraction = -1;
+    for (std::string::size_type i = 0; i < text.size(); ++i)
+    {
+        const char c = text[i];
+        if (c == '.')
+        {
+            if (fraction >= 0)
+                return false;
+            fraction = 0;
+            continue;
+        }
+        if (fraction == scale)
+            continue;
+        if (fraction >= 0)
+            ++fraction;
+        value = value * 10 + (c - '0');
+    }
+    for (int f = fraction < 0 ? 0 : fraction; f < scale; ++f)
+        value *= 10;
+    out = value;
+    return true;
+}
+//-----------------------------------------------------------------------//
+static FakeCell qLiteral(FakeParser &p, const FakeColumnDef &def)
+{
+    FakeCell cell;
+    if (p.accept("NULL"))
+        return cell;
+
+    const bool negative = p.accept("-");
+    const FakeToken t = p.next();
+    bool ok = false;
+    if (t.kind == FakeToken::Number)
+    {
+        if (qIsInteger(def.type))
+            ok = qParseDecimal(t.text, def.scale, cell.i);
+        else if (def.type == IBPP::sdFloat || def.type == IBPP::sdDouble)
+        {
+            cell.d = atof(t.text.c_str());
+            ok = true;
+        }
+        if (negative)
+        {
+            cell.i = -cell.i;
+            cell.d = -cell.d;
+        }
+    }
+    else if (t.kind == FakeToken::String && !negative &&
+             (def.type == IBPP::sdString || def.type == IBPP::sdBlob))
+    {
+        cell.s = t.text;
+        ok = def.type == IBPP::sdBlob || int(cell.s.size()) <= def.size;
+        qPad(def, cell.s);
+    }
+    else if (t.kind == FakeToken::End || t.kind == FakeToken::Symbol)
+        qSyntaxError(t.text);
+
+    if (!ok)
+        throw SQLExceptionImpl("Statement::Prepare", -413, isc_conversion_error,
+                               "conversion error from string \"" + t.text + "\"");
+    cell.null = false;
+    return cell;
+}
+//-----------------------------------------------------------------------//
+// '?' or a literal for column of columns
+static FakeValueSource qParseValue(FakeParser &p, const std::vector<FakeColumnDef> &columns,
+                                   int column, std::vector<FakeColumnDef> &params)
+{
+    FakeValueSource source;
+    source.column = column;
+    if (p.accept("?"))
+    {
+        source.param = int(params.size());
+        params.push_back(columns[column]);
+    }
+    else
+        source.literal = qLiteral(p, columns[column]);
+    return source;
+}
+//-----------------------------------------------------------------------//
+static int qColumnIndex(const FakeTable *table, const std::string &name)
+{
+    for (std::vector<FakeColumnDef>::size_type c = 0; c < table->columns.size(); ++c)
+        if (table->columns[c].name == name)
+            return int(c);
+    throw SQLExceptionImpl("Statement::Prepare", -206, isc_dsql_field_err,
+                           "Dynamic SQL Error\nSQL error code = -206\nColumn unknown\n" + name);
+}
+//-----------------------------------------------------------------------//
+static FakeTable *qFindTable(const std::string &name)
+{
+    std::map<std::string, FakeTable *>::iterator it = fakeCatalog.tables.find(name);
+    if (it == fakeCatalog.tables.end())
+        throw SQLExceptionImpl("Statement::Prepare", -204, isc_dsql_relation_err,
+                               "Dynamic SQL Error\nSQL error code = -204\nTable unknown\n" + name);
+    return it->second;
+}
+//-----------------------------------------------------------------------//
+// Catches the end of a blocking call, see DatabaseImpl::BeginCall()
+class FakeCallGuard
+{
+public:
+    FakeCallGuard(IBPP::Database &db, const char *origin)
+        : mDb(static_cast<DatabaseImpl *>(db.intf()))
+    {
+        mDb->BeginCall(origin);
+    }
+
+    ~FakeCallGuard()
+    {
+        mDb->EndCall();
+    }
+
+private:
+    DatabaseImpl *mDb;
+};
+//-----------------------------------------------------------------------//
+ISC_STATUS fb_cancel_operation(ISC_STATUS *status, isc_db_handle *handle, ISC_USHORT option)
+{
+    status[0] = 1;
+    status[1] = 0;
+    status[2] = 0;
+
+    QMutexLocker locker(&fakeCatalog.mutex);
+    std::map<isc_db_handle, DatabaseImpl *>::iterator it = fakeCatalog.attachments.end();
+    if (handle)
+        it = fakeCatalog.attachments.find(*handle);
+    if (it == fakeCatalog.attachments.end())
+    {
+        status[1] = isc_bad_db_handle;
+        return status[1];
+    }
+
+    if (option == fb_cancel_raise)
+        it->second->RequestCancel();
+    return 0;
+}
+//-----------------------------------------------------------------------//
+DatabaseImpl::DatabaseImpl(const std::string &server, const std::string &database,
+                           const std::string &user, const std::string &password,
+                           const std::string &role, const std::string &charSet,
+                           const std::string &createParams)
+    : mRefCount(0), mHandle(0), mServerName(server), mDatabaseName(database),
+      mUserName(user), mUserPassword(password), mRoleName(role), mCharSet(charSet),
+      mCreateParams(createParams)
+{
+}
+//-----------------------------------------------------------------------//
+DatabaseImpl::~DatabaseImpl()
+{
+    Disconnect();
+}
+//-----------------------------------------------------------------------//
+void DatabaseImpl::Info(int *ODS, int *ODSMinor, int *PageSize, int *Pages,
+                        int *Buffers, int *Sweep, bool *Sync, bool *Reserve)
+{
+    if (ODS) *ODS = 11;
+    if (ODSMinor) *ODSMinor = 2;
+    if (PageSize) *PageSize = 4096;
+    if (Pages) *Pages = 0;
+    if (Buffers) *Buffers = 0;
+    if (Sweep) *Sweep = 0;
+    if (Sync) *Sync = false;
+    if (Reserve) *Reserve = true;
+}
+//-----------------------------------------------------------------------//
+void DatabaseImpl::Statistics(int *Fetches, int *Marks, int *Reads, int *Writes)
+{
+    if (Fetches) *Fetches = 0;
+    if (Marks) *Marks = 0;
+    if (Reads) *Reads = 0;
+    if (Writes) *Writes = 0;
+}
+//-----------------------------------------------------------------------//
+void DatabaseImpl::Counts(int *Insert, int *Update, int *Delete, int *ReadIdx, int *ReadSeq)
+{
+    if (Insert) *Insert = 0;
+    if (Update) *Update = 0;
+    if (Delete) *Delete = 0;
+    if (ReadIdx) *ReadIdx = 0;
+    if (ReadSeq) *ReadSeq = 0;
+}
+//-----------------------------------------------------------------------//
+void DatabaseImpl::Users(std::vector<std::string> &users)
+{
+    users.clear();
+    if (mHandle)
+        users.push_back(mUserName);
+}
+//-----------------------------------------------------------------------//
+// Nothing to create, all attachments share the one catalog
+void DatabaseImpl::Create(int dialect)
+{
+    if (mHandle)
+        throw LogicExceptionImpl("Database::Create", "Database is already connected.");
+    if (dialect != 1 && dialect != 3)
+        throw LogicExceptionImpl("Database::Create", "Only dialects 1 and 3 are supported.");
+}
+//-----------------------------------------------------------------------//
+void DatabaseImpl::Connect()
+{
+    if (mHandle)
+        return;
+
+    QMutexLocker locker(&fakeCatalog.mutex);
+    mHandle = ++fakeCatalog.nextHandle;
+    fakeCatalog.attachments[mHandle] = this;
+}
+//-----------------------------------------------------------------------//
+void DatabaseImpl::Disconnect()
+{
+    if (!mHandle)
+        return;
+
+    QMutexLocker locker(&fakeCatalog.mutex);
+    fakeCatalog.attachments.erase(mHandle);
+    mHandle = 0;
+}
+//-----------------------------------------------------------------------//
+void DatabaseImpl::Drop()
+{
+    if (!mHandle)
+        throw LogicExceptionImpl("Database::Drop", "Database must be connected.");
+
+    {
+        QMutexLocker locker(&fakeCatalog.mutex);
+        std::map<std::string, FakeTable *>::iterator it;
+        for (it = fakeCatalog.tables.begin(); it != fakeCatalog.tables.end(); ++it)
+            if (it->second->users > 0)
+                throw SQLExceptionImpl("Database::Drop", -901, isc_obj_in_use,
+                                       "object TABLE \"" + it->first + "\" is in use");
+        for (it = fakeCatalog.tables.begin(); it != fakeCatalog.tables.end(); ++it)
+            delete it->second;
+        fakeCatalog.tables.clear();
+    }
+    Disconnect();
+}
+//-----------------------------------------------------------------------//
+IBPP::IDatabase *DatabaseImpl::AddRef()
+{
+    ++mRefCount;
+    return this;
+}
+//-----------------------------------------------------------------------//
+void DatabaseImpl::Release()
+{
+    if (--mRefCount == 0)
+        delete this;
+}
+//-----------------------------------------------------------------------//
+// Waits out the call delay, then fails if fb_cancel_operation() came
+// meanwhile. A cancel between calls is ignored, as by the server.
+void DatabaseImpl::BeginCall(const char *origin)
+{
+    mBusy.ref();
+
+    int delay;
+    {
+        QMutexLocker locker(&fakeCatalog.mutex);
+        delay = fakeCatalog.callDelay;
+    }
+    const int step = 5;
+    for (int waited = 0; waited < delay && !mCancel.fetchAndAddOrdered(0); waited += step)
+        qFakeSleep(step);
+
+    CheckCancel(origin);
+}
+//-----------------------------------------------------------------------//
+void DatabaseImpl::EndCall()
+{
+    mBusy.deref();
+    mCancel.fetchAndStoreOrdered(0);
+}
+//-----------------------------------------------------------------------//
+bool DatabaseImpl::RequestCancel()
+{
+    if (mBusy.fetchAndAddOrdered(0) <= 0)
+        return false;
+    mCancel.fetchAndStoreOrdered(1);
+    return true;
+}
+//-----------------------------------------------------------------------//
+void DatabaseImpl::CheckCancel(const char *origin)
+{
+    if (mCancel.fetchAndStoreOrdered(0))
+    {
+        mBusy.deref();
+        throw SQLExceptionImpl(origin, -901, isc_cancelled, "operation was cancelled");
+    }
+}
+//-----------------------------------------------------------------------//
+TransactionImpl::TransactionImpl(IBPP::Database db, IBPP::TAM, IBPP::TIL, IBPP::TLR, IBPP::TFF)
+    : mRefCount(0), mStarted(false), mGeneration(0)
+{
+    if (db.intf() != 0)
+        mDatabases.push_back(db);
+}
+//-----------------------------------------------------------------------//
+TransactionImpl::~TransactionImpl()
+{
+}
+//-----------------------------------------------------------------------//
+void TransactionImpl::AttachDatabase(IBPP::Database db, IBPP::TAM, IBPP::TIL, IBPP::TLR, IBPP::TFF)
+{
+    if (db.intf() == 0)
+        throw LogicExceptionImpl("Transaction::AttachDatabase", "Can't attach an unbound Database.");
+    if (mStarted)
+        throw LogicExceptionImpl("Transaction::AttachDatabase",
+                                 "Can't attach a Database if Transaction started.");
+    mDatabases.push_back(db);
+}
+//-----------------------------------------------------------------------//
+void TransactionImpl::DetachDatabase(IBPP::Database db)
+{
+    if (mStarted)
+        throw LogicExceptionImpl("Transaction::DetachDatabase",
+                                 "Can't detach a Database if Transaction started.");
+    mDatabases.erase(std::remove(mDatabases.begin(), mDatabases.end(), db), mDatabases.end());
+}
+//-----------------------------------------------------------------------//
+void TransactionImpl::AddReservation(IBPP::Database, const std::string &, IBPP::TTR)
+{
+    if (mStarted)
+        throw LogicExceptionImpl("Transaction::AddReservation",
+                                 "Can't add table reservation if Transaction started.");
+}
+//-----------------------------------------------------------------------//
+void TransactionImpl::Start()
+{
+    if (mStarted)
+        return;
+    if (mDatabases.empty())
+        throw LogicExceptionImpl("Transaction::Start", "No Database is attached.");
+    for (std::vector<IBPP::Database>::size_type i = 0; i < mDatabases.size(); ++i)
+        if (!mDatabases[i]->Connected())
+            throw LogicExceptionImpl("Transaction::Start",
+                                     "All attached Database should have been connected.");
+    mStarted = true;
+    ++mGeneration;
+}
+//-----------------------------------------------------------------------//
+void TransactionImpl::Commit()
+{
+    if (!mStarted)
+        throw LogicExceptionImpl("Transaction::Commit", "Transaction is not started.");
+    mStarted = false;
+}
+//-----------------------------------------------------------------------//
+void TransactionImpl::Rollback()
+{
+    mStarted = false;
+}
+//-----------------------------------------------------------------------//
+void TransactionImpl::CommitRetain()
+{
+    if (!mStarted)
+        throw LogicExceptionImpl("Transaction::CommitRetain", "Transaction is not started.");
+}
+//-----------------------------------------------------------------------//
+void TransactionImpl::RollbackRetain()
+{
+    if (!mStarted)
+        throw LogicExceptionImpl("Transaction::RollbackRetain", "Transaction is not started.");
+}
+//-----------------------------------------------------------------------//
+IBPP::ITransaction *TransactionImpl::AddRef()
+{
+    ++mRefCount;
+    return this;
+}
+//-----------------------------------------------------------------------//
+void TransactionImpl::Release()
+{
+    if (--mRefCount == 0)
+        delete this;
+}
+//-----------------------------------------------------------------------//
+BlobImpl::BlobImpl(IBPP::Database db, IBPP::Transaction tr)
+    : mRefCount(0), mState(Empty), mPos(0), mIdGeneration(0), mDatabase(db), mTransaction(tr)
+{
+}
+//-----------------------------------------------------------------------//
+BlobImpl::~BlobImpl()
+{
+}
+//-----------------------------------------------------------------------//
+void BlobImpl::Create()
+{
+    if (mDatabase.intf() == 0 || !mDatabase->Connected())
+        throw LogicExceptionImpl("Blob::Create", "Database must be connected.");
+    if (mTransaction.intf() == 0 || !mTransaction->Started())
+        throw LogicExceptionImpl("Blob::Create", "Transaction must be started.");
+
+    mData.erase();
+    mIdTransaction.clear();
+    mState = Writing;
+}
+//-----------------------------------------------------------------------//
+void BlobImpl::Open()
+{
+    if (mState == Empty || mState == Writing)
+        throw LogicExceptionImpl("Blob::Open", "BLOB Id is not assigned.");
+    if (mIdTransaction.intf() != 0 &&
+        (!mIdTransaction->Started() ||
+         static_cast<TransactionImpl *>(mIdTransaction.intf())->Generation() != mIdGeneration))
+        throw SQLExceptionImpl("Blob::Open", -904, isc_bad_segstr_id, "invalid BLOB ID");
+
+    mPos = 0;
+    mState = Reading;
+}
+//-----------------------------------------------------------------------//
+void BlobImpl::Close()
+{
+    if (mState == Writing)
+        mState = Written;
+    else if (mState == Reading)
+        mState = Closed;
+    else
+        throw LogicExceptionImpl("Blob::Close", "BLOB is not open.");
+}
+//-----------------------------------------------------------------------//
+void BlobImpl::Cancel()
+{
+    mData.erase();
+    mIdTransaction.clear();
+    mState = Empty;
+}
+//-----------------------------------------------------------------------//
+int BlobImpl::Read(void *buffer, int size)
+{
+    if (mState != Reading)
+        throw LogicExceptionImpl("Blob::Read", "BLOB is not open.");
+    if (size < 1 || size > maxSegment)
+        throw LogicExceptionImpl("Blob::Read", "Invalid segment size (max 64Kb-1)");
+
+    const int n = int(std::min<std::string::size_type>(size, mData.size() - mPos));
+    memcpy(buffer, mData.data() + mPos, n);
+    mPos += n;
+    return n;
+}
+//-----------------------------------------------------------------------//
+void BlobImpl::Write(const void *buffer, int size)
+{
+    if (mState != Writing)
+        throw LogicExceptionImpl("Blob::Write", "BLOB is not created.");
+    if (size < 1 || size > maxSegment)
+        throw LogicExceptionImpl("Blob::Write", "Invalid segment size (max 64Kb-1)");
+
+    mData.append(static_cast<const char *>(buffer), size);
+}
+//-----------------------------------------------------------------------//
+void BlobImpl::Info(int *Size, int *Largest, int *Segments)
+{
+    const int size = int(mData.size());
+    if (Size)
+        *Size = size;
+    if (Largest)
+        *Largest = std::min(size, maxSegment);
+    if (Segments)
+        *Segments = (size + maxSegment - 1) / maxSegment;
+}
+//-----------------------------------------------------------------------//
+void BlobImpl::Save(const std::string &data)
+{
+    Create();
+    for (std::string::size_type offset = 0; offset < data.size(); offset += maxSegment)
+        Write(data.data() + offset, int(std::min<std::string::size_type>(maxSegment, data.size() - offset)));
+    Close();
+}
+//-----------------------------------------------------------------------//
+void BlobImpl::Load(std::string &data)
+{
+    Open();
+    data = mData;
+    Close();
+}
+//-----------------------------------------------------------------------//
+IBPP::IBlob *BlobImpl::AddRef()
+{
+    ++mRefCount;
+    return this;
+}
+//-----------------------------------------------------------------------//
+void BlobImpl::Release()
+{
+    if (--mRefCount == 0)
+        delete this;
+}
+//-----------------------------------------------------------------------//
+void BlobImpl::SetId(const std::string &data, IBPP::Transaction tr)
+{
+    mData = data;
+    mIdTransaction = tr;
+    mIdGeneration = static_cast<TransactionImpl *>(tr.intf())->Generation();
+    mState = Closed;
+}
+//-----------------------------------------------------------------------//
+const std::string &BlobImpl::Data(const char *origin) const
+{
+    if (mState != Written && mState != Closed)
+        throw LogicExceptionImpl(origin, "BLOB is not closed.");
+    return mData;
+}
+//-----------------------------------------------------------------------//
+ArrayImpl::ArrayImpl(IBPP::Database db, IBPP::Transaction tr)
+    : mRefCount(0), mDatabase(db), mTransaction(tr)
+{
+}
+//-----------------------------------------------------------------------//
+static void qNoArrays(const char *origin)
+{
+    throw LogicExceptionImpl(origin, "ARRAY columns are not supported by the fake IBPP.");
+}
+//-----------------------------------------------------------------------//
+void ArrayImpl::Describe(const std::string &, const std::string &) { qNoArrays("Array::Describe"); }
+void ArrayImpl::ReadTo(IBPP::ADT, void *, int) { qNoArrays("Array::ReadTo"); }
+void ArrayImpl::WriteFrom(IBPP::ADT, const void *, int) { qNoArrays("Array::WriteFrom"); }
+IBPP::SDT ArrayImpl::ElementType() { qNoArrays("Array::ElementType"); return IBPP::sdArray; }
+int ArrayImpl::ElementSize() { qNoArrays("Array::ElementSize"); return 0; }
+int ArrayImpl::ElementScale() { qNoArrays("Array::ElementScale"); return 0; }
+int ArrayImpl::Dimensions() { qNoArrays("Array::Dimensions"); return 0; }
+void ArrayImpl::Bounds(int, int *, int *) { qNoArrays("Array::Bounds"); }
+void ArrayImpl::SetBounds(int, int, int) { qNoArrays("Array::SetBounds"); }
+//-----------------------------------------------------------------------//
+IBPP::IArray *ArrayImpl::AddRef()
+{
+    ++mRefCount;
+    return this;
+}
+//-----------------------------------------------------------------------//
+void ArrayImpl::Release()
+{
+    if (--mRefCount == 0)
+        delete this;
+}
+//-----------------------------------------------------------------------//
+static bool qIsConstraint(const FakeToken &t)
+{
+    static const char *const words[] = { "CONSTRAINT", "PRIMARY", "UNIQUE", "FOREIGN", "CHECK" };
+    if (t.kind != FakeToken::Name)
+        return false;
+    for (size_t i = 0; i < sizeof(words) / sizeof(words[0]); ++i)
+        if (t.text == words[i])
+            return true;
+    return false;
+}
+//-----------------------------------------------------------------------//
+// A table no longer in the catalog is freed with its last statement
+static void qReleaseTable(FakeTable *table)
+{
+    if (--table->users > 0)
+        return;
+    std::map<std::string, FakeTable *>::iterator it = fakeCatalog.tables.find(table->name);
+    if (it == fakeCatalog.tables.end() || it->second != table)
+        delete table;
+}
+//-----------------------------------------------------------------------//
+static bool qSameValue(const FakeColumnDef &def, const FakeCell &a, const FakeCell &b)
+{
+    switch (def.type)
+    {
+    case IBPP::sdFloat:
+    case IBPP::sdDouble:
+        return a.d == b.d;
+    case IBPP::sdTime:
+        return a.t == b.t;
+    case IBPP::sdTimestamp:
+        return a.i == b.i && a.t == b.t;
+    case IBPP::sdString:
+        {
+            // trailing blanks do not count, as for CHAR on the server
+            std::string::size_type na = a.s.find_last_not_of(' ') + 1;
+            std::string::size_type nb = b.s.find_last_not_of(' ') + 1;
+            return a.s.compare(0, na, b.s, 0, nb) == 0;
+        }
+    case IBPP::sdBlob:
+        return a.s == b.s;
+    default:
+        return a.i == b.i;
+    }
+}
+//-----------------------------------------------------------------------//
+StatementImpl::StatementImpl(IBPP::Database db, IBPP::Transaction tr)
+    : mRefCount(0), mDatabase(db), mTransaction(tr), mKind(Unprepared), mTable(0),
+      mHasWhere(false), mCursorOpen(false), mPos(0), mEnd(0), mCursorGeneration(0),
+      mCount(0), mHasRow(false), mAffected(0)
+{
+}
+//-----------------------------------------------------------------------//
+StatementImpl::~StatementImpl()
+{
+    Close();
+}
+//-----------------------------------------------------------------------//
+void StatementImpl::Prepare(const std::string &sql)
+{
+    if (mDatabase.intf() == 0 || !mDatabase->Connected())
+        throw LogicExceptionImpl("Statement::Prepare", "An IDatabase must be attached and connected.");
+    if (mTransaction.intf() == 0 || !mTransaction->Started())
+        throw LogicExceptionImpl("Statement::Prepare", "An ITransaction must be attached and started.");
+    if (sql.empty())
+        throw LogicExceptionImpl("Statement::Prepare", "Can not prepare an empty statement.");
+
+    Close();
+    mSql = sql;
+
+    QMutexLocker locker(&fakeCatalog.mutex);
+    ++fakeCatalog.prepares;
+    try
+    {
+        prepareLocked(sql);
+    }
+    catch (...)
+    {
+        releaseLocked();
+        throw;
+    }
+}
+//-----------------------------------------------------------------------//
+// Fills the statement in, sets mKind and takes the table reference last
+void StatementImpl::prepareLocked(const std::string &sql)
+{
+    FakeParser p(sql);
+    Kind kind;
+    FakeTable *table = 0;
+
+    if (p.accept("SELECT"))
+    {
+        bool all = false;
+        std::vector<std::string> names;
+        if (p.accept("COUNT"))
+        {
+            p.expect("(");
+            p.expect("*");
+            p.expect(")");
+            kind = Count;
+        }
+        else
+        {
+            kind = Select;
+            if (p.accept("*"))
+                all = true;
+            else
+                do
+                    names.push_back(p.name());
+                while (p.accept(","));
+        }
+
+        p.expect("FROM");
+        table = qFindTable(p.name());
+
+        if (kind == Count)
+        {
+            FakeColumnDef def;
+            def.name = "COUNT";
+            def.type = IBPP::sdLargeint;
+            def.size = 8;
+            mColumns.push_back(def);
+        }
+        else if (all)
+        {
+            for (std::vector<FakeColumnDef>::size_type c = 0; c < table->columns.size(); ++c)
+                mSelected.push_back(int(c));
+        }
+        else
+        {
+            for (std::vector<std::string>::size_type n = 0; n < names.size(); ++n)
+                mSelected.push_back(qColumnIndex(table, names[n]));
+        }
+        for (std::vector<int>::size_type c = 0; c < mSelected.size(); ++c)
+            mColumns.push_back(table->columns[mSelected[c]]);
+    }
+    else if (p.accept("INSERT"))
+    {
+        kind = Insert;
+        p.expect("INTO");
+        table = qFindTable(p.name());
+
+        std::vector<int> targets;
+        if (p.accept("("))
+        {
+            do
+                targets.push_back(qColumnIndex(table, p.name()));
+            while (p.accept(","));
+            p.expect(")");
+        }
+        else
+        {
+            for (std::vector<FakeColumnDef>::size_type c = 0; c < table->columns.size(); ++c)
+                targets.push_back(int(c));
+        }
+
+        p.expect("VALUES");
+        p.expect("(");
+        std::vector<int>::size_type n = 0;
+        do
+        {
+            if (n == targets.size())
+                throw SQLExceptionImpl("Statement::Prepare", -804, isc_dsql_error,
+                                       "Dynamic SQL Error\nSQL error code = -804\n"
+                                       "Count of column list and variable list do not match");
+            mValues.push_back(qParseValue(p, table->columns, targets[n++], mParamDefs));
+        }
+        while (p.accept(","));
+        p.expect(")");
+        if (n != targets.size())
+            throw SQLExceptionImpl("Statement::Prepare", -804, isc_dsql_error,
+                                   "Dynamic SQL Error\nSQL error code = -804\n"
+                                   "Count of column list and variable list do not match");
+    }
+    else if (p.accept("DELETE"))
+    {
+        kind = Delete;
+        p.expect("FROM");
+        table = qFindTable(p.name());
+    }
+    else if (p.accept("CREATE"))
+    {
+        kind = CreateTable;
+        p.expect("TABLE");
+        mTableName = p.name();
+        p.expect("(");
+        do
+        {
+            if (qIsConstraint(p.peek()))
+            {
+                qSkipToNextItem(p);
+                continue;
+            }
+            const std::string name = p.name();
+            FakeColumnDef def = qParseType(p);
+            def.name = name;
+            mNewColumns.push_back(def);
+            qSkipToNextItem(p);
+        }
+        while (p.accept(","));
+        p.expect(")");
+    }
+    else if (p.accept("DROP"))
+    {
+        kind = DropTable;
+        p.expect("TABLE");
+        mTableName = p.name();
+    }
+    else
+    {
+        qSyntaxError(p.peek().text);
+        return;
+    }
+
+    if (table && (kind == Select || kind == Count || kind == Delete) && p.accept("WHERE"))
+    {
+        const int c = qColumnIndex(table, p.name());
+        p.expect("=");
+        mWhere = qParseValue(p, table->columns, c, mParamDefs);
+        mHasWhere = true;
+    }
+    p.expectEnd();
+
+    mParams.assign(mParamDefs.size(), FakeCell());
+    mParamSet.assign(mParamDefs.size(), false);
+    if (table)
+    {
+        mTableName = table->name;
+        mTable = table;
+        ++mTable->users;
+    }
+    mKind = kind;
+}
+//-----------------------------------------------------------------------//
+void StatementImpl::Execute(const std::string &sql)
+{
+    Prepare(sql);
+    Execute();
+}
+//-----------------------------------------------------------------------//
+void StatementImpl::Execute()
+{
+    checkReady("Statement::Execute");
+    for (std::vector<bool>::size_type i = 0; i < mParamSet.size(); ++i)
+        if (!mParamSet[i])
+            throw LogicExceptionImpl("Statement::Execute", "All parameters must be specified.");
+
+    FakeCallGuard guard(mDatabase, "Statement::Execute");
+    QMutexLocker locker(&fakeCatalog.mutex);
+    ++fakeCatalog.executes;
+    executeLocked();
+}
+//-----------------------------------------------------------------------//
+void StatementImpl::executeLocked()
+{
+    mCursorOpen = false;
+    mHasRow = false;
+    mAffected = 0;
+
+    if (mTable)
+    {
+        std::map<std::string, FakeTable *>::iterator it = fakeCatalog.tables.find(mTableName);
+        if (it == fakeCatalog.tables.end() || it->second != mTable)
+            throw SQLExceptionImpl("Statement::Execute", -204, isc_dsql_relation_err,
+                                   "Dynamic SQL Error\nSQL error code = -204\nTable unknown\n" + mTableName);
+    }
+
+    switch (mKind)
+    {
+    case Select:
+        mCursorOpen = true;
+        mPos = 0;
+        mEnd = mTable->rows.size();
+        mCursorGeneration = mTable->generation;
+        break;
+    case Count:
+        mCount = 0;
+        for (std::vector<std::vector<FakeCell> >::size_type r = 0; r < mTable->rows.size(); ++r)
+            if (matches(mTable->rows[r]))
+                ++mCount;
+        mCursorOpen = true;
+        mPos = 0;
+        mEnd = 1;
+        break;
+    case Insert:
+        {
+            std::vector<FakeCell> row(mTable->columns.size());
+            for (std::vector<FakeValueSource>::size_type v = 0; v < mValues.size(); ++v)
+                row[mValues[v].column] = sourceValue(mValues[v]);
+            mTable->rows.push_back(row);
+            mAffected = 1;
+            break;
+        }
+    case Delete:
+        {
+            std::vector<std::vector<FakeCell> > &rows = mTable->rows;
+            std::vector<std::vector<FakeCell> >::size_type kept = 0;
+            for (std::vector<std::vector<FakeCell> >::size_type r = 0; r < rows.size(); ++r)
+                if (!matches(rows[r]))
+                    rows[kept++].swap(rows[r]);
+            mAffected = int(rows.size() - kept);
+            rows.resize(kept);
+            ++mTable->generation;
+            break;
+        }
+    case CreateTable:
+        {
+            if (fakeCatalog.tables.count(mTableName))
+                throw SQLExceptionImpl("Statement::Execute", -607, isc_no_meta_update,
+                                       "unsuccessful metadata update\nTable " + mTableName +
+                                       " already exists");
+            FakeTable *table = new FakeTable;
+            table->name = mTableName;
+            table->columns = mNewColumns;
+            fakeCatalog.tables[mTableName] = table;
+            break;
+        }
+    case DropTable:
+        {
+            std::map<std::string, FakeTable *>::iterator it = fakeCatalog.tables.find(mTableName);
+            if (it == fakeCatalog.tables.end())
+                throw SQLExceptionImpl("Statement::Execute", -607, isc_no_meta_update,
+                                       "unsuccessful metadata update\nTable " + mTableName +
+                                       " does not exist");
+            if (it->second->users > 0)
+                throw SQLExceptionImpl("Statement::Execute", -901, isc_obj_in_use,
+                                       "unsuccessful metadata update\nobject TABLE \"" +
+                                       mTableName + "\" is in use");
+            delete it->second;
+            fakeCatalog.tables.erase(it);
+            break;
+        }
+    case Unprepared:
+        break;
+    }
+}
+//-----------------------------------------------------------------------//
+void StatementImpl::ExecuteImmediate(const std::string &sql)
+{
+    Prepare(sql);
+    Execute();
+    Close();
+}
+//-----------------------------------------------------------------------//
+void StatementImpl::CursorExecute(const std::string &, const std::string &)
+{
+    throw LogicExceptionImpl("Statement::CursorExecute", "Named cursors are not supported by the fake IBPP.");
+}
+//-----------------------------------------------------------------------//
+void StatementImpl::CursorExecute(const std::string &)
+{
+    throw LogicExceptionImpl("Statement::CursorExecute", "Named cursors are not supported by the fake IBPP.");
+}
+//-----------------------------------------------------------------------//
+bool StatementImpl::Fetch()
+{
+    if (!mCursorOpen)
+        throw LogicExceptionImpl("Statement::Fetch",
+                                 "No statement has been executed or no result set available.");
+
+    FakeCallGuard guard(mDatabase, "Statement::Fetch");
+    QMutexLocker locker(&fakeCatalog.mutex);
+    ++fakeCatalog.fetches;
+
+    if (mKind == Count)
+    {
+        if (mPos < mEnd)
+        {
+            mRow.assign(1, FakeCell());
+            mRow[0].null = false;
+            mRow[0].i = mCount;
+            mPos = mEnd;
+            mHasRow = true;
+            return true;
+        }
+    }
+    else if (mTable->generation == mCursorGeneration)
+    {
+        const std::vector<std::vector<FakeCell> > &rows = mTable->rows;
+        while (mPos < mEnd)
+        {
+            const std::vector<FakeCell> &row = rows[mPos++];
+            if (!matches(row))
+                continue;
+            mRow.resize(mSelected.size());
+            for (std::vector<int>::size_type c = 0; c < mSelected.size(); ++c)
+                mRow[c] = row[mSelected[c]];
+            mHasRow = true;
+            return true;
+        }
+    }
+
+    mCursorOpen = false;
+    mHasRow = false;
+    return false;
+}
+//-----------------------------------------------------------------------//
+bool StatementImpl::Fetch(IBPP::Row &)
+{
+    throw LogicExceptionImpl("Statement::Fetch(Row&)", "Rows are not supported by the fake IBPP.");
+}
+//-----------------------------------------------------------------------//
+int StatementImpl::AffectedRows()
+{
+    if (mKind == Unprepared)
+        throw LogicExceptionImpl("Statement::AffectedRows", "No statement has been prepared.");
+    return mAffected;
+}
+//-----------------------------------------------------------------------//
+void StatementImpl::Close()
+{
+    QMutexLocker locker(&fakeCatalog.mutex);
+    releaseLocked();
+}
+//-----------------------------------------------------------------------//
+void StatementImpl::releaseLocked()
+{
+    if (mKind != Unprepared && mTable)
+        qReleaseTable(mTable);
+
+    mKind = Unprepared;
+    mTable = 0;
+    mTableName.erase();
+    mNewColumns.clear();
+    mSelected.clear();
+    mColumns.clear();
+    mParamDefs.clear();
+    mParams.clear();
+    mParamSet.clear();
+    mValues.clear();
+    mHasWhere = false;
+    mWhere = FakeValueSource();
+    mCursorOpen = false;
+    mCount = 0;
+    mHasRow = false;
+    mRow.clear();
+    mAffected = 0;
+}
+//-----------------------------------------------------------------------//
+IBPP::STT StatementImpl::Type()
+{
+    switch (mKind)
+    {
+    case Select:
+    case Count:
+        return IBPP::stSelect;
+    case Insert:
+        return IBPP::stInsert;
+    case Delete:
+        return IBPP::stDelete;
+    case CreateTable:
+    case DropTable:
+        return IBPP::stDDL;
+    default:
+        return IBPP::stUnknown;
+    }
+}
+//-----------------------------------------------------------------------//
+void StatementImpl::checkReady(const char *origin)
+{
+    if (mKind == Unprepared)
+        throw LogicExceptionImpl(origin, "No statement has been prepared.");
+    if (mDatabase.intf() == 0 || !mDatabase->Connected())
+        throw LogicExceptionImpl(origin, "An IDatabase must be attached and connected.");
+    if (mTransaction.intf() == 0 || !mTransaction->Started())
+        throw LogicExceptionImpl(origin, "An ITransaction must be attached and started.");
+}
+//-----------------------------------------------------------------------//
+const FakeColumnDef &StatementImpl::paramDef(int param, const char *origin)
+{
+    if (mKind == Unprepared)
+        throw LogicExceptionImpl(origin, "No statement has been prepared.");
+    if (param < 1 || param > int(mParamDefs.size()))
+        throw LogicExceptionImpl(origin, "Variable index out of range.");
+    return mParamDefs[param - 1];
+}
+//-----------------------------------------------------------------------//
+void StatementImpl::store(int param, const FakeCell &cell)
+{
+    mParams[param - 1] = cell;
+    mParamSet[param - 1] = true;
+}
+//-----------------------------------------------------------------------//
+const FakeColumnDef &StatementImpl::column(int column, const char *origin)
+{
+    if (mKind == Unprepared)
+        throw LogicExceptionImpl(origin, "No statement has been prepared.");
+    if (column < 1 || column > int(mColumns.size()))
+        throw LogicExceptionImpl(origin, "Variable index out of range.");
+    return mColumns[column - 1];
+}
+//-----------------------------------------------------------------------//
+const FakeCell &StatementImpl::value(int column, const char *origin)
+{
+    this->column(column, origin);
+    if (!mHasRow)
+        throw LogicExceptionImpl(origin, "No row has been fetched.");
+    return mRow[column - 1];
+}
+//-----------------------------------------------------------------------//
+// Integers are stored unscaled, as given
+void StatementImpl::setInteger(int param, long long value)
+{
+    const FakeColumnDef &def = paramDef(param, "Statement::Set[Integer]");
+    FakeCell cell;
+    cell.null = false;
+    if (qIsInteger(def.type))
+    {
+        const long long limit = def.type == IBPP::sdSmallint ? 32767LL :
+                                def.type == IBPP::sdInteger ? 2147483647LL : 0;
+        if (limit && (value > limit || value < -limit - 1))
+            throw SQLExceptionImpl("Statement::Set[Integer]", -802, isc_arith_except,
+                                   "arithmetic exception, numeric overflow, or string truncation");
+        cell.i = value;
+    }
+    else if (def.type == IBPP::sdFloat || def.type == IBPP::sdDouble)
+        cell.d = double(value);
+    else
+        throw WrongTypeImpl("Statement::Set[Integer]", "Incompatible types.");
+    store(param, cell);
+}
+//-----------------------------------------------------------------------//
+// Floating point values are scaled into NUMERIC and DECIMAL parameters
+void StatementImpl::setDouble(int param, double value)
+{
+    const FakeColumnDef &def = paramDef(param, "Statement::Set[Double]");
+    FakeCell cell;
+    cell.null = false;
+    if (qIsInteger(def.type))
+    {
+        const double scaled = floor(value * double(qPowerOf10(def.scale)) + 0.5);
+        if (scaled > 9.2e18 || scaled < -9.2e18)
+            throw SQLExceptionImpl("Statement::Set[Double]", -802, isc_arith_except,
+                                   "arithmetic exception, numeric overflow, or string truncation");
+        cell.i = (long long)scaled;
+    }
+    else if (def.type == IBPP::sdFloat)
+        cell.d = float(value);
+    else if (def.type == IBPP::sdDouble)
+        cell.d = value;
+    else
+        throw WrongTypeImpl("Statement::Set[Double]", "Incompatible types.");
+    store(param, cell);
+}
+//-----------------------------------------------------------------------//
+void StatementImpl::setBytes(int param, const char *value, int size)
+{
+    const FakeColumnDef &def = paramDef(param, "Statement::Set[String]");
+    if (def.type != IBPP::sdString && def.type != IBPP::sdBlob)
+        throw WrongTypeImpl("Statement::Set[String]", "Incompatible types.");
+    if (def.type == IBPP::sdString && size > def.size)
+        throw SQLExceptionImpl("Statement::Set[String]", -802, isc_arith_except,
+                               "arithmetic exception, numeric overflow, or string truncation\n"
+                               "string right truncation");
+
+    FakeCell cell;
+    cell.null = false;
+    cell.s.assign(value, size);
+    qPad(def, cell.s);
+    store(param, cell);
+}
+//-----------------------------------------------------------------------//
+const FakeCell &StatementImpl::sourceValue(const FakeValueSource &source) const
+{
+    return source.param >= 0 ? mParams[source.param] : source.literal;
+}
+//-----------------------------------------------------------------------//
+bool StatementImpl::matches(const std::vector<FakeCell> &row) const
+{
+    if (!mHasWhere)
+        return true;
+    const FakeCell &wanted = sourceValue(mWhere);
+    const FakeCell &cell = row[mWhere.column];
+    return !wanted.null && !cell.null &&
+           qSameValue(mTable->columns[mWhere.column], cell, wanted);
+}
+//-----------------------------------------------------------------------//
+void StatementImpl::SetNull(int param)
+{
+    paramDef(param, "Statement::SetNull");
+    store(param, FakeCell());
+}
+//-----------------------------------------------------------------------//
+void StatementImpl::Set(int param, bool value)
+{
+    setInteger(param, value ? 1 : 0);
+}
+//-----------------------------------------------------------------------//
+void StatementImpl::Set(int param, const void *value, int size)
+{
+    if (value == 0 || size < 0)
+        throw LogicExceptionImpl("Statement::Set[void*]", "Null pointer detected.");
+    setBytes(param, static_cast<const char *>(value), size);
+}
+//-----------------------------------------------------------------------//
+void StatementImpl::Set(int param, const char *value)
+{
+    if (value == 0)
+        throw LogicExceptionImpl("Statement::Set[char*]", "Null pointer detected.");
+    setBytes(param, value, int(strlen(value)));
+}
+//-----------------------------------------------------------------------//
+void StatementImpl::Set(int param, const std::string &value)
+{
+    setBytes(param, value.data(), int(value.size()));
+}
+//-----------------------------------------------------------------------//
+void StatementImpl::Set(int param, int16_t value)
+{
+    setInteger(param, value);
+}
+//-----------------------------------------------------------------------//
+void StatementImpl::Set(int param, int32_t value)
+{
+    setInteger(param, value);
+}
+//-----------------------------------------------------------------------//
+void StatementImpl::Set(int param, int64_t value)
+{
+    setInteger(param, value);
+}
+//-----------------------------------------------------------------------//
+void StatementImpl::Set(int param, float value)
+{
+    setDouble(param, value);
+}
+//-----------------------------------------------------------------------//
+void StatementImpl::Set(int param, double value)
+{
+    setDouble(param, value);
+}
+//-----------------------------------------------------------------------//
+void StatementImpl::Set(int param, const IBPP::Timestamp &value)
+{
+    const FakeColumnDef &def = paramDef(param, "Statement::Set[Timestamp]");
+    FakeCell cell;
+    cell.null = false;
+    if (def.type == IBPP::sdTimestamp || def.type == IBPP::sdDate)
+        cell.i = value.GetDate();
+    if (def.type == IBPP::sdTimestamp || def.type == IBPP::sdTime)
+        cell.t = value.GetTime();
+    else if (def.type != IBPP::sdDate)
+        throw WrongTypeImpl("Statement::Set[Timestamp]", "Incompatible types.");
+    store(param, cell);
+}
+//-----------------------------------------------------------------------//
+void StatementImpl::Set(int param, const IBPP::Date &value)
+{
+    const FakeColumnDef &def = paramDef(param, "Statement::Set[Date]");
+    if (def.type != IBPP::sdDate && def.type != IBPP::sdTimestamp)
+        throw WrongTypeImpl("Statement::Set[Date]", "Incompatible types.");
+    FakeCell cell;
+    cell.null = false;
+    cell.i = value.GetDate();
+    store(param, cell);
+}
+//-----------------------------------------------------------------------//
+void StatementImpl::Set(int param, const IBPP::Time &value)
+{
+    const FakeColumnDef &def = paramDef(param, "Statement::Set[Time]");
+    if (def.type != IBPP::sdTime)
+        throw WrongTypeImpl("Statement::Set[Time]", "Incompatible types.");
+    FakeCell cell;
+    cell.null = false;
+    cell.t = value.GetTime();
+    store(param, cell);
+}
+//-----------------------------------------------------------------------//
+void StatementImpl::Set(int, const IBPP::DBKey &)
+{
+    throw LogicExceptionImpl("Statement::Set[DBKey]", "DB_KEYs are not supported by the fake IBPP.");
+}
+//-----------------------------------------------------------------------//
+void StatementImpl::Set(int param, const IBPP::Blob &value)
+{
+    const FakeColumnDef &def = paramDef(param, "Statement::Set[Blob]");
+    if (def.type != IBPP::sdBlob)
+        throw WrongTypeImpl("Statement::Set[Blob]", "Incompatible types.");
+    if (value.intf() == 0)
+        throw LogicExceptionImpl("Statement::Set[Blob]", "Blob object not set.");
+    FakeCell cell;
+    cell.null = false;
+    cell.s = static_cast<const BlobImpl *>(value.intf())->Data("Statement::Set[Blob]");
+    store(param, cell);
+}
+//-----------------------------------------------------------------------//
+void StatementImpl::Set(int, const IBPP::Array &)
+{
+    throw LogicExceptionImpl("Statement::Set[Array]", "ARRAY columns are not supported by the fake IBPP.");
+}
+//-----------------------------------------------------------------------//
+bool StatementImpl::IsNull(int column)
+{
+    return value(column, "Statement::IsNull").null;
+}
+//-----------------------------------------------------------------------//
+// Like IBPP, the Get()s return true for NULL and leave the value alone
+bool StatementImpl::Get(int column, bool &value)
+{
+    const FakeCell &cell = this->value(column, "Statement::Get[bool]");
+    if (cell.null)
+        return true;
+    if (!qIsInteger(this->column(column, "Statement::Get[bool]").type))
+        throw WrongTypeImpl("Statement::Get[bool]", "Incompatible types.");
+    value = cell.i != 0;
+    return false;
+}
+//-----------------------------------------------------------------------//
+bool StatementImpl::Get(int column, char *value)
+{
+    const FakeCell &cell = this->value(column, "Statement::Get[char*]");
+    if (cell.null)
+        return true;
+    if (this->column(column, "Statement::Get[char*]").type != IBPP::sdString)
+        throw WrongTypeImpl("Statement::Get[char*]", "Incompatible types.");
+    if (value == 0)
+        throw LogicExceptionImpl("Statement::Get[char*]", "Null pointer detected.");
+    memcpy(value, cell.s.c_str(), cell.s.size() + 1);
+    return false;
+}
+//-----------------------------------------------------------------------//
+bool StatementImpl::Get(int column, char *value, int size)
+{
+    const FakeCell &cell = this->value(column, "Statement::Get[char*, int]");
+    if (cell.null)
+        return true;
+    if (this->column(column, "Statement::Get[char*, int]").type != IBPP::sdString)
+        throw WrongTypeImpl("Statement::Get[char*, int]", "Incompatible types.");
+    if (value == 0 || size < 1)
+        throw LogicExceptionImpl("Statement::Get[char*, int]", "Null pointer detected.");
+    const int n = std::min(size - 1, int(cell.s.size()));
+    memcpy(value, cell.s.data(), n);
+    value[n] = '\0';
+    return false;
+}
+//-----------------------------------------------------------------------//
+bool StatementImpl::Get(int column, void *value, int &size)
+{
+    const FakeCell &cell = this->value(column, "Statement::Get[void*, int]");
+    if (cell.null)
+        return true;
+    if (this->column(column, "Statement::Get[void*, int]").type != IBPP::sdString)
+        throw WrongTypeImpl("Statement::Get[void*, int]", "Incompatible types.");
+    if (value == 0 || size < 0)
+        throw LogicExceptionImpl("Statement::Get[void*, int]", "Null pointer detected.");
+    size = std::min(size, int(cell.s.size()));
+    memcpy(value, cell.s.data(), size);
+    return false;
+}
+//-----------------------------------------------------------------------//
+bool StatementImpl::Get(int column, std::string &value)
+{
+    const FakeCell &cell = this->value(column, "Statement::Get[string]");
+    if (cell.null)
+        return true;
+    const IBPP::SDT type = this->column(column, "Statement::Get[string]").type;
+    if (type != IBPP::sdString && type != IBPP::sdBlob)
+        throw WrongTypeImpl("Statement::Get[string]", "Incompatible types.");
+    value = cell.s;
+    return false;
+}
+//-----------------------------------------------------------------------//
+// Integer columns come back unscaled, as the driver expects
+bool StatementImpl::Get(int column, int16_t &value)
+{
+    const FakeCell &cell = this->value(column, "Statement::Get[int16_t]");
+    if (cell.null)
+        return true;
+    if (!qIsInteger(this->column(column, "Statement::Get[int16_t]").type))
+        throw WrongTypeImpl("Statement::Get[int16_t]", "Incompatible types.");
+    value = int16_t(cell.i);
+    return false;
+}
+//-----------------------------------------------------------------------//
+bool StatementImpl::Get(int column, int32_t &value)
+{
+    const FakeCell &cell = this->value(column, "Statement::Get[int32_t]");
+    if (cell.null)
+        return true;
+    if (!qIsInteger(this->column(column, "Statement::Get[int32_t]").type))
+        throw WrongTypeImpl("Statement::Get[int32_t]", "Incompatible types.");
+    value = int32_t(cell.i);
+    return false;
+}
+//-----------------------------------------------------------------------//
+bool StatementImpl::Get(int column, int64_t &value)
+{
+    const FakeCell &cell = this->value(column, "Statement::Get[int64_t]");
+    if (cell.null)
+        return true;
+    if (!qIsInteger(this->column(column, "Statement::Get[int64_t]").type))
+        throw WrongTypeImpl("Statement::Get[int64_t]", "Incompatible types.");
+    value = cell.i;
+    return false;
+}
+//-----------------------------------------------------------------------//
+bool StatementImpl::Get(int column, float &value)
+{
+    double d;
+    const bool null = Get(column, d);
+    if (!null)
+        value = float(d);
+    return null;
+}
+//-----------------------------------------------------------------------//
+bool StatementImpl::Get(int column, double &value)
+{
+    const FakeCell &cell = this->value(column, "Statement::Get[double]");
+    if (cell.null)
+        return true;
+    const FakeColumnDef &def = this->column(column, "Statement::Get[double]");
+    if (qIsInteger(def.type))
+        value = double(cell.i) / double(qPowerOf10(def.scale));
+    else if (def.type == IBPP::sdFloat || def.type == IBPP::sdDouble)
+        value = cell.d;
+    else
+        throw WrongTypeImpl("Statement::Get[double]", "Incompatible types.");
+    return false;
+}
+//-----------------------------------------------------------------------//
+bool StatementImpl::Get(int column, IBPP::Timestamp &value)
+{
+    const FakeCell &cell = this->value(column, "Statement::Get[Timestamp]");
+    if (cell.null)
+        return true;
+    const IBPP::SDT type = this->column(column, "Statement::Get[Timestamp]").type;
+    if (type != IBPP::sdTimestamp && type != IBPP::sdDate && type != IBPP::sdTime)
+        throw WrongTypeImpl("Statement::Get[Timestamp]", "Incompatible types.");
+    value.Clear();
+    if (type != IBPP::sdTime)
+        value.SetDate(int(cell.i));
+    if (type != IBPP::sdDate)
+        value.SetTime(cell.t);
+    return false;
+}
+//-----------------------------------------------------------------------//
+bool StatementImpl::Get(int column, IBPP::Date &value)
+{
+    const FakeCell &cell = this->value(column, "Statement::Get[Date]");
+    if (cell.null)
+        return true;
+    const IBPP::SDT type = this->column(column, "Statement::Get[Date]").type;
+    if (type != IBPP::sdDate && type != IBPP::sdTimestamp)
+        throw WrongTypeImpl("Statement::Get[Date]", "Incompatible types.");
+    value.SetDate(int(cell.i));
+    return false;
+}
+//-----------------------------------------------------------------------//
+bool StatementImpl::Get(int column, IBPP::Time &value)
+{
+    const FakeCell &cell = this->value(column, "Statement::Get[Time]");
+    if (cell.null)
+        return true;
+    const IBPP::SDT type = this->column(column, "Statement::Get[Time]").type;
+    if (type != IBPP::sdTime && type != IBPP::sdTimestamp)
+        throw WrongTypeImpl("Statement::Get[Time]", "Incompatible types.");
+    value.SetTime(cell.t);
+    return false;
+}
+//-----------------------------------------------------------------------//
+bool StatementImpl::Get(int, IBPP::DBKey &)
+{
+    throw LogicExceptionImpl("Statement::Get[DBKey]", "DB_KEYs are not supported by the fake IBPP.");
+}
+//-----------------------------------------------------------------------//
+// The BLOB id stays valid until the transaction ends
+bool StatementImpl::Get(int column, IBPP::Blob &value)
+{
+    const FakeCell &cell = this->value(column, "Statement::Get[Blob]");
+    if (cell.null)
+        return true;
+    if (this->column(column, "Statement::Get[Blob]").type != IBPP::sdBlob)
+        throw WrongTypeImpl("Statement::Get[Blob]", "Incompatible types.");
+    if (value.intf() == 0)
+        value = IBPP::BlobFactory(mDatabase, mTransaction);
+    static_cast<BlobImpl *>(value.intf())->SetId(cell.s, mTransaction);
+    return false;
+}
+//-----------------------------------------------------------------------//
+bool StatementImpl::Get(int, IBPP::Array &)
+{
+    throw LogicExceptionImpl("Statement::Get[Array]", "ARRAY columns are not supported by the fake IBPP.");
+}
+//-----------------------------------------------------------------------//
+int StatementImpl::ColumnNum(const std::string &name)
+{
+    if (mKind == Unprepared)
+        throw LogicExceptionImpl("Statement::ColumnNum", "No statement has been prepared.");
+
+    std::string upper(name);
+    for (std::string::size_type i = 0; i < upper.size(); ++i)
+        upper[i] = char(toupper((unsigned char)upper[i]));
+    for (std::vector<FakeColumnDef>::size_type c = 0; c < mColumns.size(); ++c)
+        if (mColumns[c].name == name || mColumns[c].name == upper)
+            return int(c) + 1;
+    throw LogicExceptionImpl("Statement::ColumnNum", "Could not find matching column.");
+}
+//-----------------------------------------------------------------------//
+const char *StatementImpl::ColumnName(int column)
+{
+    return this->column(column, "Statement::ColumnName").name.c_str();
+}
+//-----------------------------------------------------------------------//
+const char *StatementImpl::ColumnAlias(int column)
+{
+    return this->column(column, "Statement::ColumnAlias").name.c_str();
+}
+//-----------------------------------------------------------------------//
+const char *StatementImpl::ColumnTable(int column)
+{
+    this->column(column, "Statement::ColumnTable");
+    return mKind == Count ? "" : mTableName.c_str();
+}
+//-----------------------------------------------------------------------//
+IBPP::SDT StatementImpl::ColumnType(int column)
+{
+    return this->column(column, "Statement::ColumnType").type;
+}
+//-----------------------------------------------------------------------//
+int StatementImpl::ColumnSubtype(int column)
+{
+    return this->column(column, "Statement::ColumnSubtype").subtype;
+}
+//-----------------------------------------------------------------------//
+int StatementImpl::ColumnSize(int column)
+{
+    return this->column(column, "Statement::ColumnSize").size;
+}
+//-----------------------------------------------------------------------//
+int StatementImpl::ColumnScale(int column)
+{
+    return this->column(column, "Statement::ColumnScale").scale;
+}
+//-----------------------------------------------------------------------//
+int StatementImpl::Columns()
+{
+    if (mKind == Unprepared)
+        throw LogicExceptionImpl("Statement::Columns", "No statement has been prepared.");
+    return int(mColumns.size());
+}
+//-----------------------------------------------------------------------//
+IBPP::SDT StatementImpl::ParameterType(int param)
+{
+    return paramDef(param, "Statement::ParameterType").type;
+}
+//-----------------------------------------------------------------------//
+int StatementImpl::ParameterSubtype(int param)
+{
+    return paramDef(param, "Statement::ParameterSubtype").subtype;
+}
+//-----------------------------------------------------------------------//
+int StatementImpl::ParameterSize(int param)
+{
+    return paramDef(param, "Statement::ParameterSize").size;
+}
+//-----------------------------------------------------------------------//
+int StatementImpl::ParameterScale(int param)
+{
+    return paramDef(param, "Statement::ParameterScale").scale;
+}
+//-----------------------------------------------------------------------//
+int StatementImpl::Parameters()
+{
+    if (mKind == Unprepared)
+        throw LogicExceptionImpl("Statement::Parameters", "No statement has been prepared.");
+    return int(mParamDefs.size());
+}
+//-----------------------------------------------------------------------//
+void StatementImpl::Plan(std::string &plan)
+{
+    if (mKind == Unprepared)
+        throw LogicExceptionImpl("Statement::Plan", "No statement has been prepared.");
+    if (mKind == Select || mKind == Count || mKind == Delete)
+        plan = "\nPLAN (" + mTableName + " NATURAL)";
+    else
+        plan.erase();
+}
+//-----------------------------------------------------------------------//
+IBPP::IStatement *StatementImpl::AddRef()
+{
+    ++mRefCount;
+    return this;
+}
+//-----------------------------------------------------------------------//
+void StatementImpl::Release()
+{
+    if (--mRefCount == 0)
+        delete this;
+}
+//-----------------------------------------------------------------------//
+EventsImpl::EventsImpl(IBPP::Database db)
+    : mRefCount(0), mDatabase(db)
+{
+}
+//-----------------------------------------------------------------------//
+// Handlers are kept, but no event is ever posted
+void EventsImpl::Add(const std::string &name, IBPP::EventInterface *handler)
+{
+    if (name.empty() || handler == 0)
+        throw LogicExceptionImpl("Events::Add", "Zero length event names or null handlers not permitted.");
+    mHandlers[name] = handler;
+}
+//-----------------------------------------------------------------------//
+void EventsImpl::Drop(const std::string &name)
+{
+    mHandlers.erase(name);
+}
+//-----------------------------------------------------------------------//
+void EventsImpl::List(std::vector<std::string> &names)
+{
+    names.clear();
+    std::map<std::string, IBPP::EventInterface *>::const_iterator it;
+    for (it = mHandlers.begin(); it != mHandlers.end(); ++it)
+        names.push_back(it->first);
+}
+//-----------------------------------------------------------------------//
+void EventsImpl::Clear()
+{
+    mHandlers.clear();
+}
+//-----------------------------------------------------------------------//
+IBPP::IEvents *EventsImpl::AddRef()
+{
+    ++mRefCount;
+    return this;
+}
+//-----------------------------------------------------------------------//
+void EventsImpl::Release()
+{
+    if (--mRefCount == 0)
+        delete this;
+}
+//-----------------------------------------------------------------------//
+bool IBPP::CheckVersion(uint32_t appVersion)
+{
+    return appVersion == IBPP::Version;
+}
+//-----------------------------------------------------------------------//
+int IBPP::GDSVersion()
+{
+    return 25;
+}
+//-----------------------------------------------------------------------//
+IBPP::Database IBPP::DatabaseFactory(const std::string &ServerName,
+                                     const std::string &DatabaseName, const std::string &UserName,
+                                     const std::string &UserPassword, const std::string &RoleName,
+                                     const std::string &CharSet, const std::string &CreateParams)
+{
+    return new DatabaseImpl(ServerName, DatabaseName, UserName, UserPassword,
+                            RoleName, CharSet, CreateParams);
+}
+//-----------------------------------------------------------------------//
+IBPP::Transaction IBPP::TransactionFactory(Database db, TAM am, TIL il, TLR lr, TFF flags)
+{
+    return new TransactionImpl(db, am, il, lr, flags);
+}
+//-----------------------------------------------------------------------//
+IBPP::Statement IBPP::StatementFactory(Database db, Transaction tr, const std::string &sql)
+{
+    IBPP::Statement st = new StatementImpl(db, tr);
+    if (!sql.empty())
+        st->Prepare(sql);
+    return st;
+}
+//-----------------------------------------------------------------------//
+IBPP::Blob IBPP::BlobFactory(Database db, Transaction tr)
+{
+    return new BlobImpl(db, tr);
+}
+//-----------------------------------------------------------------------//
+IBPP::Array IBPP::ArrayFactory(Database db, Transaction tr)
+{
+    return new ArrayImpl(db, tr);
+}
+//-----------------------------------------------------------------------//
+IBPP::Events IBPP::EventsFactory(Database db)
+{
+    return new EventsImpl(db);
+}
+//-----------------------------------------------------------------------//
+FakeIBPP::Column::Column(const std::string &name, IBPP::SDT type, int width, int scale,
+                         double nullRatio)
+    : name(name), type(type), width(width), scale(scale), nullRatio(nullRatio)
+{
+}
+//-----------------------------------------------------------------------//
+bool FakeIBPP::IsSyntheticNull(int row, int column, double nullRatio)
+{
+    if (nullRatio <= 0.0)
+        return false;
+    unsigned int h = unsigned(row) * 2654435761u + unsigned(column) * 40503u;
+    h ^= h >> 15;
+    return h % 10000 < unsigned(nullRatio * 10000);
+}
+//-----------------------------------------------------------------------//
+static FakeColumnDef qSyntheticDef(const FakeIBPP::Column &column)
+{
+    FakeColumnDef def;
+    def.name = column.name;
+    def.type = column.type;
+    def.scale = column.scale;
+    switch (column.type)
+    {
+    case IBPP::sdSmallint:
+        def.size = 2;
+        break;
+    case IBPP::sdInteger:
+    case IBPP::sdFloat:
+    case IBPP::sdDate:
+    case IBPP::sdTime:
+        def.size = 4;
+        break;
+    case IBPP::sdString:
+        def.size = column.width * bytesPerChar;
+        break;
+    case IBPP::sdArray:
+        throw LogicExceptionImpl("FakeIBPP::AddTable", "ARRAY columns are not supported by the fake IBPP.");
+    default:
+        def.size = 8;
+        break;
+    }
+    return def;
+}
+//-----------------------------------------------------------------------//
+static FakeCell qSyntheticCell(const FakeIBPP::Column &column, int r)
+{
+    FakeCell cell;
+    cell.null = false;
+    switch (column.type)
+    {
+    case IBPP::sdSmallint:
+        cell.i = r % 32768;
+        break;
+    case IBPP::sdInteger:
+    case IBPP::sdLargeint:
+        cell.i = r;
+        break;
+    case IBPP::sdFloat:
+    case IBPP::sdDouble:
+        cell.d = r + 0.5;
+        break;
+    case IBPP::sdDate:
+        cell.i = 40000 + r % 3650;
+        break;
+    case IBPP::sdTime:
+        cell.t = (r % 86400) * 10000;
+        break;
+    case IBPP::sdTimestamp:
+        cell.i = 40000 + r % 3650;
+        cell.t = (r % 86400) * 10000;
+        break;
+    case IBPP::sdString:
+        {
+            char text[16];
+            sprintf(text, "R%d", r);
+            cell.s = text;
+            if (int(cell.s.size()) < column.width)
+                cell.s.append(column.width - cell.s.size(), 'x');
+            break;
+        }
+    case IBPP::sdBlob:
+        cell.s.assign(column.width, char('a' + r % 26));
+        break;
+    default:
+        break;
+    }
+    return cell;
+}
+//-----------------------------------------------------------------------//
+void FakeIBPP::AddTable(const std::string &name, const std::vector<Column> &columns, int rows)
+{
+    FakeTable *table = new FakeTable;
+    table->name = name;
+    try
+    {
+        for (std::vector<Column>::size_type c = 0; c < columns.size(); ++c)
+            table->columns.push_back(qSyntheticDef(columns[c]));
+    }
+    catch (...)
+    {
+        delete table;
+        throw;
+    }
+
+    table->rows.resize(rows);
+    for (int r = 0; r < rows; ++r)
+    {
+        std::vector<FakeCell> &row = table->rows[r];
+        row.resize(columns.size());
+        for (std::vector<Column>::size_type c = 0; c < columns.size(); ++c)
+            if (!IsSyntheticNull(r, int(c), columns[c].nullRatio))
+                row[c] = qSyntheticCell(columns[c], r);
+    }
+
+    // statements still prepared on a replaced table free it when closed
+    QMutexLocker locker(&fakeCatalog.mutex);
+    FakeTable *&slot = fakeCatalog.tables[name];
+    if (slot && slot->users == 0)
+        delete slot;
+    slot = table;
+}
+//-----------------------------------------------------------------------//
+int FakeIBPP::RowCount(const std::string &table)
+{
+    QMutexLocker locker(&fakeCatalog.mutex);
+    std::map<std::string, FakeTable *>::const_iterator it = fakeCatalog.tables.find(table);
+    return it == fakeCatalog.tables.end() ? -1 : int(it->second->rows.size());
+}
+//-----------------------------------------------------------------------//
+void FakeIBPP::SetCallDelay(int msecs)
+{
+    QMutexLocker locker(&fakeCatalog.mutex);
+    fakeCatalog.callDelay = msecs;
+}
+//-----------------------------------------------------------------------//
+int FakeIBPP::Prepares()
+{
+    QMutexLocker locker(&fakeCatalog.mutex);
+    return fakeCatalog.prepares;
+}
+//-----------------------------------------------------------------------//
+int FakeIBPP::Executes()
+{
+    QMutexLocker locker(&fakeCatalog.mutex);
+    return fakeCatalog.executes;
+}
+//-----------------------------------------------------------------------//
+int FakeIBPP::Fetches()
+{
+    QMutexLocker locker(&fakeCatalog.mutex);
+    return fakeCatalog.fetches;
+}
+//-----------------------------------------------------------------------//
+void FakeIBPP::Reset()
+{
+    QMutexLocker locker(&fakeCatalog.mutex);
+    std::map<std::string, FakeTable *>::iterator it;
+    for (it = fakeCatalog.tables.begin(); it != fakeCatalog.tables.end(); ++it)
+        if (it->second->users == 0)
+            delete it->second;
+    fakeCatalog.tables.clear();
+    fakeCatalog.callDelay = 0;
+    fakeCatalog.prepares = 0;
+    fakeCatalog.executes = 0;
+    fakeCatalog.fetches = 0;
+}
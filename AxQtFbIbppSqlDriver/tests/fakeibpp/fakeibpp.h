@@ -0,0 +1,108 @@
+/*
+* This file is part of QtFirebirdIBPPSQLDriver - Qt SQL driver for Firebird with IBPP library
+* Copyright (C) 2006-2010 Alex Wencel
+*
+* Contact e-mail: Alex Wencel <alex.wencel@gmail.com>
+* Program URL   : http://code.google.com/p/qtfirebirdibppsqldriver
+*
+* GNU Lesser General Public License Usage
+* This file may be used under the terms of the GNU Lesser
+* General Public License version 2.1 as published by the Free Software
+* Foundation and appearing in the file LICENSE.LGPL included in the
+* packaging of this file.  Please review the following information to
+* ensure the GNU Lesser General Public License version 2.1 requirements
+* will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+*
+* GNU General Public License Usage
+* Alternatively, this file may be used under the terms of the GNU
+* General Public License version 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in the
+* packaging of this file.  Please review the following information to
+* ensure the GNU General Public License version 3.0 requirements will be
+* met: http://www.gnu.org/copyleft/gpl.html.
+*
+*/
+
+#ifndef FAKEIBPP_H
+#define FAKEIBPP_H
+
+#include "ibpp.h"
+
+#include <string>
+#include <vector>
+
+// In-memory stand-in for IBPP and the Firebird server, for tests and
+// benchmarks of the driver without network or server noise. Link
+// fakeibpp.pri instead of IBPP's core and fbclient.
+//
+// All attachments share one catalog. Statements understand a small subset
+// of SQL, keywords and names are case insensitive:
+//
+//  CREATE TABLE t (c type [constraints], ...)
+//      SMALLINT, INTEGER, BIGINT, FLOAT, DOUBLE PRECISION,
+//      NUMERIC(p[,s]), DECIMAL(p[,s]), CHAR(n), VARCHAR(n), DATE, TIME,
+//      TIMESTAMP and BLOB [SUB_TYPE n]; constraints are ignored
+//  DROP TABLE t
+//  INSERT INTO t [(c, ...)] VALUES (v, ...)
+//  SELECT * | c, ... | COUNT(*) FROM t [WHERE c = v]
+//  DELETE FROM t [WHERE c = v]
+//
+// where v is '?', NULL, a number or a quoted string. Anything else, the
+// system tables included, fails to prepare with SQL code -104.
+//
+// Like the server, DROP TABLE fails with "object in use" (engine code
+// 335544453) while another prepared statement refers to the table, BLOB
+// ids are only valid in the transaction they were fetched in, and
+// fb_cancel_operation() makes a running Execute() or Fetch() fail with
+// isc_cancelled (335544794). Unlike the server, changes are not
+// transactional: they are visible at once and a rollback keeps them.
+// String columns are sized as in a UTF8 connection, four bytes per
+// character, and CHAR values are padded to that size. ARRAY columns,
+// DB_KEYs and events are not supported.
+namespace FakeIBPP
+{
+    // Column of a synthetic table. width is the length in characters of a
+    // string column and the size in bytes of a BLOB value.
+    struct Column
+    {
+        Column(const std::string &name, IBPP::SDT type, int width = 0, int scale = 0,
+               double nullRatio = 0.0);
+
+        std::string name;
+        IBPP::SDT type;
+        int width;
+        int scale;
+        double nullRatio;   // share of NULLs, 0 to 1
+    };
+
+    // Adds a table of rows generated from the row number r, replacing a
+    // table of that name. Row r holds in
+    //
+    //  integer columns   r, SMALLINT r % 32768, unscaled for NUMERIC
+    //  FLOAT, DOUBLE     r + 0.5
+    //  DATE              IBPP day 40000 + r % 3650, TIMESTAMP at r % 86400 seconds
+    //  TIME              r % 86400 seconds
+    //  string columns    "R<r>" padded with 'x' to width characters
+    //  BLOB columns      width bytes of 'a' + r % 26
+    //
+    // and NULL where IsSyntheticNull(r, c, nullRatio), c counting from 0.
+    void AddTable(const std::string &name, const std::vector<Column> &columns, int rows);
+    bool IsSyntheticNull(int row, int column, double nullRatio);
+
+    // Rows of table, -1 if there is no such table
+    int RowCount(const std::string &table);
+
+    // Every Execute() and Fetch() takes msecs longer, in steps that
+    // fb_cancel_operation() may interrupt
+    void SetCallDelay(int msecs);
+
+    // Calls since the last Reset()
+    int Prepares();
+    int Executes();
+    int Fetches();
+
+    // Drops all tables, clears the counters and the call delay
+    void Reset();
+}
+
+#endif // FAKEIBPP_H
@@ -0,0 +1,20 @@
+# In-memory stand-in for IBPP's core and fbclient, see fakeibpp.h. The
+# fake's directory comes first, so "_ibpp.h" is the fake one while ibpp.h
+# is still IBPP's own.
+
+DEPENDPATH += $$PWD
+INCLUDEPATH += $$PWD \
+    $$PWD/../../ibpp2531/core
+HEADERS		+= $$PWD/../../ibpp2531/core/ibpp.h \
+    $$PWD/_ibpp.h \
+    $$PWD/fakeibpp.h
+SOURCES		+= $$PWD/fakeibpp.cpp \
+    $$PWD/fakecore.cpp
+
+unix{
+  DEFINES += IBPP_LINUX \
+  IBPP_GCC
+}
+win32{
+  DEFINES += IBPP_WINDOWS
+}
@@ -0,0 +1,23 @@
+# Tests of the driver against the in-memory IBPP of fakeibpp/, no server
+# needed:
+#
+#   qmake && make && ./tst_qfbdriver
+CONFIG += qtestlib \
+    console
+CONFIG -= app_bundle
+QT += core \
+    sql
+QT -= gui
+TEMPLATE = app
+TARGET = tst_qfbdriver
+
+DEFINES += QT_NO_CAST_TO_ASCII \
+    QT_NO_CAST_FROM_ASCII
+INCLUDEPATH += ../src
+HEADERS += ../src/qsql_ibpp.h \
+    ../src/qsqlcachedresult_p.h \
+    ../src/qfbrowblock.h \
+    ../src/qfbbulkinsert.h
+SOURCES += ../src/qsql_ibpp.cpp \
+    tst_qfbdriver.cpp
+include(fakeibpp/fakeibpp.pri) # +=   fake IBPP
@@ -0,0 +1,364 @@
+/*
+* This file is part of QtFirebirdIBPPSQLDriver - Qt SQL driver for Firebird with IBPP library
+* Copyright (C) 2006-2010 Alex Wencel
+*
+* Contact e-mail: Alex Wencel <alex.wencel@gmail.com>
+* Program URL   : http://code.google.com/p/qtfirebirdibppsqldriver
+*
+* GNU Lesser General Public License Usage
+* This file may be used under the terms of the GNU Lesser
+* General Public License version 2.1 as published by the Free Software
+* Foundation and appearing in the file LICENSE.LGPL included in the
+* packaging of this file.  Please review the following information to
+* ensure the GNU Lesser General Public License version 2.1 requirements
+* will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+*
+* GNU General Public License Usage
+* Alternatively, this file may be used under the terms of the GNU
+* General Public License version 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in the
+* packaging of this file.  Please review the following information to
+* ensure the GNU General Public License version 3.0 requirements will be
+* met: http://www.gnu.org/copyleft/gpl.html.
+*
+*/
+
+#include <QtTest/QtTest>
+#include <QtCore/QBuffer>
+#include <QtSql/QSqlDatabase>
+#include <QtSql/QSqlDriver>
+#include <QtSql/QSqlQuery>
+#include <QtSql/QSqlError>
+#include <QtSql/QSqlRecord>
+
+#include "qsql_ibpp.h"
+#include "qfbrowblock.h"
+#include "fakeibpp.h"
+
+// Tests of the driver against the in-memory IBPP of fakeibpp/. Every test
+// starts on an empty catalog; see fakeibpp.h for the SQL it understands.
+
+static const char connectionName[] = "qfbtest";
+static const char lazyConnectionName[] = "qfbtest_lazy";
+static const int fakeCancelledCode = 335544794;     // isc_cancelled
+
+#define QFB_VERIFY_QUERY(q, statement) \
+    QVERIFY2(statement, (q).lastError().text().toLocal8Bit().constData())
+
+class tst_QFBDriver : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+    void init();
+
+    void roundTrip_data();
+    void roundTrip();
+    void scaled();
+    void syntheticRows();
+    void namedPlaceholders();
+    void rowBlock();
+    void statementTimeout();
+    void lazyBlobAfterCommit();
+    void execBatchSetterFailure_data();
+    void execBatchSetterFailure();
+    void dropAfterCachedSelect();
+
+private:
+    QSqlDatabase open(const char *name, const QString &options);
+    void addSyntheticTable(int rows);
+
+    QSqlDatabase db;
+};
+
+//-----------------------------------------------------------------------//
+QSqlDatabase tst_QFBDriver::open(const char *name, const QString &options)
+{
+    QSqlDatabase d = QSqlDatabase::addDatabase(new QFBDriver(), QLatin1String(name));
+    d.setDatabaseName(QLatin1String("fake.fdb"));
+    d.setUserName(QLatin1String("SYSDBA"));
+    d.setPassword(QLatin1String("masterkey"));
+    d.setConnectOptions(options);
+    d.open();
+    return d;
+}
+//-----------------------------------------------------------------------//
+// ID INTEGER, S VARCHAR(10), D DOUBLE, DT DATE with a quarter NULL
+void tst_QFBDriver::addSyntheticTable(int rows)
+{
+    std::vector<FakeIBPP::Column> columns;
+    columns.push_back(FakeIBPP::Column("ID", IBPP::sdInteger));
+    columns.push_back(FakeIBPP::Column("S", IBPP::sdString, 10));
+    columns.push_back(FakeIBPP::Column("D", IBPP::sdDouble));
+    columns.push_back(FakeIBPP::Column("DT", IBPP::sdDate, 0, 0, 0.25));
+    FakeIBPP::AddTable("SYNTH", columns, rows);
+}
+//-----------------------------------------------------------------------//
+void tst_QFBDriver::initTestCase()
+{
+    db = open(connectionName, QLatin1String("CHARSET=UTF8;STMT_CACHE_SIZE=16"));
+    QVERIFY2(db.isOpen(), db.lastError().text().toLocal8Bit().constData());
+}
+//-----------------------------------------------------------------------//
+void tst_QFBDriver::cleanupTestCase()
+{
+    db.close();
+    db = QSqlDatabase();
+    QSqlDatabase::removeDatabase(QLatin1String(connectionName));
+    FakeIBPP::Reset();
+}
+//-----------------------------------------------------------------------//
+void tst_QFBDriver::init()
+{
+    FakeIBPP::Reset();
+}
+//-----------------------------------------------------------------------//
+void tst_QFBDriver::roundTrip_data()
+{
+    QTest::addColumn<QString>("type");
+    QTest::addColumn<QVariant>("value");
+
+    const QDate date(2010, 6, 15);
+    const QTime time(12, 34, 56, 789);
+    QTest::newRow("smallint") << QString::fromLatin1("SMALLINT") << QVariant(-1234);
+    QTest::newRow("integer") << QString::fromLatin1("INTEGER") << QVariant(123456789);
+    QTest::newRow("bigint") << QString::fromLatin1("BIGINT") << QVariant(Q_INT64_C(-1234567890123));
+    QTest::newRow("double") << QString::fromLatin1("DOUBLE PRECISION") << QVariant(3.25);
+    QTest::newRow("varchar") << QString::fromLatin1("VARCHAR(20)")
+                             << QVariant(QString(QChar(ushort(0x00e4))) + QLatin1String("bc"));
+    QTest::newRow("date") << QString::fromLatin1("DATE") << QVariant(date);
+    QTest::newRow("old date") << QString::fromLatin1("DATE") << QVariant(QDate(1, 1, 1));
+    QTest::newRow("time") << QString::fromLatin1("TIME") << QVariant(time);
+    QTest::newRow("timestamp") << QString::fromLatin1("TIMESTAMP") << QVariant(QDateTime(date, time));
+    QTest::newRow("blob") << QString::fromLatin1("BLOB SUB_TYPE 0")
+                          << QVariant(QByteArray(100000, 'b'));
+}
+//-----------------------------------------------------------------------//
+void tst_QFBDriver::roundTrip()
+{
+    QFETCH(QString, type);
+    QFETCH(QVariant, value);
+
+    QSqlQuery q(db);
+    QFB_VERIFY_QUERY(q, q.exec(QLatin1String("CREATE TABLE T (V ") + type + QLatin1Char(')')));
+    QFB_VERIFY_QUERY(q, q.prepare(QLatin1String("INSERT INTO T (V) VALUES (?)")));
+    q.addBindValue(value);
+    QFB_VERIFY_QUERY(q, q.exec());
+    q.addBindValue(QVariant(value.type()));
+    QFB_VERIFY_QUERY(q, q.exec());
+
+    QFB_VERIFY_QUERY(q, q.exec(QLatin1String("SELECT V FROM T")));
+    QVERIFY(q.next());
+    QCOMPARE(q.value(0), value);
+    QVERIFY(q.next());
+    QVERIFY(q.isNull(0));
+    QVERIFY(!q.next());
+}
+//-----------------------------------------------------------------------//
+void tst_QFBDriver::scaled()
+{
+    QSqlQuery q(db);
+    QFB_VERIFY_QUERY(q, q.exec(QLatin1String("CREATE TABLE T (V NUMERIC(18,4))")));
+    QFB_VERIFY_QUERY(q, q.prepare(QLatin1String("INSERT INTO T (V) VALUES (?)")));
+    q.addBindValue(QString::fromLatin1("-12345678.9012"));
+    QFB_VERIFY_QUERY(q, q.exec());
+
+    q.setNumericalPrecisionPolicy(QSql::HighPrecision);
+    QFB_VERIFY_QUERY(q, q.exec(QLatin1String("SELECT V FROM T")));
+    QVERIFY(q.next());
+    QCOMPARE(q.value(0).toString(), QString::fromLatin1("-12345678.9012"));
+}
+//-----------------------------------------------------------------------//
+void tst_QFBDriver::syntheticRows()
+{
+    const int rows = 1000;
+    addSyntheticTable(rows);
+
+    QSqlQuery q(db);
+    q.setForwardOnly(true);
+    QFB_VERIFY_QUERY(q, q.exec(QLatin1String("SELECT ID, S, D, DT FROM SYNTH")));
+    int r = 0;
+    int nulls = 0;
+    for (; q.next(); ++r)
+    {
+        QCOMPARE(q.value(0).toInt(), r);
+        QCOMPARE(q.value(1).toString(),
+                 (QLatin1Char('R') + QString::number(r)).leftJustified(10, QLatin1Char('x')));
+        QCOMPARE(q.value(2).toDouble(), r + 0.5);
+        if (FakeIBPP::IsSyntheticNull(r, 3, 0.25))
+        {
+            QVERIFY(q.isNull(3));
+            ++nulls;
+        }
+        else
+            QCOMPARE(q.value(3).toDate(), QDate::fromJulianDay(2415020 + 40000 + r % 3650));
+    }
+    QCOMPARE(r, rows);
+    QVERIFY(nulls > 0 && nulls < rows / 2);
+}
+//-----------------------------------------------------------------------//
+void tst_QFBDriver::namedPlaceholders()
+{
+    QVERIFY(db.driver()->hasFeature(QSqlDriver::NamedPlaceholders));
+
+    QSqlQuery q(db);
+    QFB_VERIFY_QUERY(q, q.exec(QLatin1String("CREATE TABLE T (A INTEGER, B VARCHAR(10))")));
+    QFB_VERIFY_QUERY(q, q.prepare(QLatin1String("INSERT INTO T (A, B) VALUES (:a, :b)")));
+    for (int i = 0; i < 3; ++i)
+    {
+        q.bindValue(QLatin1String(":b"), QString::number(i * 10));
+        q.bindValue(QLatin1String(":a"), i);
+        QFB_VERIFY_QUERY(q, q.exec());
+    }
+
+    QFB_VERIFY_QUERY(q, q.prepare(QLatin1String("SELECT B FROM T WHERE A = :a")));
+    q.bindValue(QLatin1String(":a"), 2);
+    QFB_VERIFY_QUERY(q, q.exec());
+    QVERIFY(q.next());
+    QCOMPARE(q.value(0).toString(), QString::fromLatin1("20"));
+    QVERIFY(!q.next());
+}
+//-----------------------------------------------------------------------//
+void tst_QFBDriver::rowBlock()
+{
+    const int rows = 2500;
+    addSyntheticTable(rows);
+
+    QSqlQuery q(db);
+    q.setForwardOnly(true);
+    QFB_VERIFY_QUERY(q, q.exec(QLatin1String("SELECT ID, S, D, DT FROM SYNTH")));
+
+    QFBRowBlock block;
+    int total = 0;
+    int n;
+    while ((n = qFBFetchRowBlock(q, block, 1000)) > 0)
+    {
+        QCOMPARE(block.rowCount, n);
+        QCOMPARE(block.columns.count(), 4);
+        QCOMPARE(block.columns.at(0).kind, QFBRowBlock::Int32);
+        QCOMPARE(block.columns.at(3).kind, QFBRowBlock::Date);
+        for (int i = 0; i < n; ++i)
+        {
+            const int r = total + i;
+            QCOMPARE(int(block.columns.at(0).int32s.at(i)), r);
+            QCOMPARE(block.columns.at(2).doubles.at(i), r + 0.5);
+            QCOMPARE(block.columns.at(3).nulls.testBit(i), FakeIBPP::IsSyntheticNull(r, 3, 0.25));
+        }
+        total += n;
+    }
+    QCOMPARE(n, 0);
+    QCOMPARE(total, rows);
+}
+//-----------------------------------------------------------------------//
+// A statement slower than the "StatementTimeout" property is cancelled
+void tst_QFBDriver::statementTimeout()
+{
+    addSyntheticTable(10);
+    FakeIBPP::SetCallDelay(5000);
+
+    QSqlQuery q(db);
+    db.driver()->setProperty("StatementTimeout", 50);
+    QTime clock;
+    clock.start();
+    QVERIFY(!q.exec(QLatin1String("SELECT ID FROM SYNTH")));
+    QVERIFY(clock.elapsed() < 4000);
+    QCOMPARE(q.lastError().driverText(), QString::fromLatin1("Statement timeout expired"));
+    QCOMPARE(q.lastError().number(), fakeCancelledCode);
+
+    // the property covers one statement only
+    FakeIBPP::SetCallDelay(0);
+    QFB_VERIFY_QUERY(q, q.exec(QLatin1String("SELECT ID FROM SYNTH")));
+}
+//-----------------------------------------------------------------------//
+// BLOB ids die with their transaction, so a lazy BLOB not read yet must
+// be read before the commit
+void tst_QFBDriver::lazyBlobAfterCommit()
+{
+    std::vector<FakeIBPP::Column> columns;
+    columns.push_back(FakeIBPP::Column("V", IBPP::sdBlob, 100000));
+    FakeIBPP::AddTable("BLOBS", columns, 3);
+
+    {
+        QSqlDatabase lazy = open(lazyConnectionName, QLatin1String("CHARSET=UTF8;BLOB_MODE=LAZY"));
+        QVERIFY2(lazy.isOpen(), lazy.lastError().text().toLocal8Bit().constData());
+
+        QSqlQuery q(lazy);
+        QVERIFY(lazy.transaction());
+        QFB_VERIFY_QUERY(q, q.exec(QLatin1String("SELECT V FROM BLOBS")));
+        QVERIFY(q.next());
+        QVERIFY(q.next());
+        QVERIFY(lazy.commit());
+
+        QCOMPARE(q.value(0).toByteArray(), QByteArray(100000, 'b'));
+        QVERIFY(q.previous());
+        QCOMPARE(q.value(0).toByteArray(), QByteArray(100000, 'a'));
+        lazy.close();
+    }
+    QSqlDatabase::removeDatabase(QLatin1String(lazyConnectionName));
+}
+//-----------------------------------------------------------------------//
+void tst_QFBDriver::execBatchSetterFailure_data()
+{
+    QTest::addColumn<QString>("type");
+    QTest::addColumn<QString>("error");
+
+    // qSetBlob() refuses a device not open for reading, IBPP refuses a
+    // string longer than the column
+    QTest::newRow("refused value") << QString::fromLatin1("BLOB SUB_TYPE 0")
+                                   << QString::fromLatin1("Unable to set parameter 2 in batch row 1");
+    QTest::newRow("setter exception") << QString::fromLatin1("VARCHAR(1)")
+                                      << QString::fromLatin1("Unable to set parameter in batch row 1");
+}
+//-----------------------------------------------------------------------//
+// A row whose value cannot be bound fails the whole batch with an error
+void tst_QFBDriver::execBatchSetterFailure()
+{
+    QFETCH(QString, type);
+    QFETCH(QString, error);
+
+    QSqlQuery q(db);
+    QFB_VERIFY_QUERY(q, q.exec(QLatin1String("CREATE TABLE T (ID INTEGER, V ") + type + QLatin1Char(')')));
+    QFB_VERIFY_QUERY(q, q.prepare(QLatin1String("INSERT INTO T (ID, V) VALUES (?, ?)")));
+
+    QBuffer closed;
+    QVariant bad = QString::fromLatin1("too long");
+    if (type.startsWith(QLatin1String("BLOB")))
+        bad = QVariant::fromValue<QObject*>(&closed);
+    q.addBindValue(QVariantList() << 1 << 2 << 3);
+    q.addBindValue(QVariantList() << QVariant(QString::fromLatin1("a")) << bad
+                                  << QVariant(QString::fromLatin1("c")));
+
+    QVERIFY(!q.execBatch());
+    QCOMPARE(q.lastError().type(), QSqlError::StatementError);
+    QCOMPARE(q.lastError().driverText(), error);
+    // the fake keeps the first row through the rollback, the third never ran
+    QCOMPARE(FakeIBPP::RowCount("T"), 1);
+}
+//-----------------------------------------------------------------------//
+// A statement kept in the statement cache holds its table in use, so the
+// cache must let go of it before DROP TABLE runs
+void tst_QFBDriver::dropAfterCachedSelect()
+{
+    QSqlQuery q(db);
+    QFB_VERIFY_QUERY(q, q.exec(QLatin1String("CREATE TABLE T (V INTEGER)")));
+    QFB_VERIFY_QUERY(q, q.exec(QLatin1String("INSERT INTO T (V) VALUES (1)")));
+
+    const QLatin1String hits("hits");
+    const int before = db.driver()->property("StatementCache").toMap().value(hits).toInt();
+    for (int i = 0; i < 2; ++i)
+    {
+        QFB_VERIFY_QUERY(q, q.exec(QLatin1String("SELECT V FROM T")));
+        QVERIFY(q.next());
+        q.clear();
+    }
+    QVERIFY(db.driver()->property("StatementCache").toMap().value(hits).toInt() > before);
+
+    QSqlQuery ddl(db);
+    QFB_VERIFY_QUERY(ddl, ddl.exec(QLatin1String("DROP TABLE T")));
+    QCOMPARE(FakeIBPP::RowCount("T"), -1);
+}
+//-----------------------------------------------------------------------//
+QTEST_MAIN(tst_QFBDriver)
+#include "tst_qfbdriver.moc"